@@ -0,0 +1,226 @@
+#include "agents.h"
+#include "hal_internal.h"
+#include "init_once.h"
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t cpu_share_permille;
+  uint32_t throttled;
+  uint32_t throttle_count;
+  uint64_t cpu_window;
+  uint64_t window_start;
+  uint64_t window_used;
+  uint64_t total_used;
+  uint64_t memory_quota;
+  uint64_t memory_used;
+  uint64_t memory_peak;
+  uint32_t memory_denials;
+} AgentRecord;
+
+static AgentRecord agent_table[AGENT_MAX_AGENTS];
+static int initialized = 0;
+// Schedulers on every CPU charge and test agents, and IPC charges memory
+// from interrupt context, so records change only under this lock
+static int agent_lock = 0;
+
+static bool lock_agents(void) {
+  bool irq = hal_internal_irq_save();
+  while (__atomic_test_and_set(&agent_lock, __ATOMIC_ACQUIRE))
+    hal_internal_cpu_relax();
+  return irq;
+}
+
+static void unlock_agents(bool irq) {
+  __atomic_clear(&agent_lock, __ATOMIC_RELEASE);
+  hal_internal_irq_restore(irq);
+}
+
+static void ensure_initialized() {
+  if (init_once_begin(&initialized)) {
+    memset(agent_table, 0, sizeof(agent_table));
+    for (uint32_t i = 0; i < AGENT_MAX_AGENTS; i++) {
+      agent_table[i].cpu_share_permille = AGENT_CPU_SHARE_UNLIMITED;
+      agent_table[i].cpu_window = AGENT_DEFAULT_CPU_WINDOW;
+    }
+    init_once_end(&initialized);
+  }
+}
+
+static AgentRecord *lookup_agent(uint32_t agent_id) {
+  if (agent_id >= AGENT_MAX_AGENTS)
+    return NULL;
+  return &agent_table[agent_id];
+}
+
+/**
+ * @brief Starts a new accounting window once the current one has elapsed.
+ *
+ * Windows stay aligned to multiples of cpu_window from the first charge,
+ * so an agent cannot shift its budget by timing its bursts.
+ * @param agent Agent record to update.
+ * @param now Current monotonic time.
+ */
+static void roll_window(AgentRecord *agent, uint64_t now) {
+  uint64_t elapsed = now - agent->window_start;
+  if (elapsed < agent->cpu_window)
+    return;
+  agent->window_start = now - (elapsed % agent->cpu_window);
+  agent->window_used = 0;
+  agent->throttled = 0;
+}
+
+static uint64_t window_budget(AgentRecord *agent) {
+  // Multiply first so short windows keep their precision; only windows
+  // too long for the product (about 213 days) divide first
+  if (agent->cpu_window > UINT64_MAX / AGENT_CPU_SHARE_UNLIMITED)
+    return agent->cpu_window / AGENT_CPU_SHARE_UNLIMITED *
+           agent->cpu_share_permille;
+  return agent->cpu_window * agent->cpu_share_permille /
+         AGENT_CPU_SHARE_UNLIMITED;
+}
+
+void agent_charge_cpu_time(uint32_t agent_id, uint64_t run_time,
+                           uint64_t now) {
+  ensure_initialized();
+  AgentRecord *agent = lookup_agent(agent_id);
+  if (!agent)
+    return;
+
+  bool irq = lock_agents();
+  roll_window(agent, now);
+  agent->window_used += run_time;
+  agent->total_used += run_time;
+
+  if (agent->cpu_share_permille < AGENT_CPU_SHARE_UNLIMITED &&
+      !agent->throttled && agent->window_used >= window_budget(agent)) {
+    agent->throttled = 1;
+    agent->throttle_count++;
+  }
+  unlock_agents(irq);
+}
+
+int agent_is_throttled(uint32_t agent_id, uint64_t now) {
+  ensure_initialized();
+  AgentRecord *agent = lookup_agent(agent_id);
+  if (!agent)
+    return 0;
+
+  bool irq = lock_agents();
+  roll_window(agent, now);
+  int throttled = agent->throttled;
+  unlock_agents(irq);
+  return throttled;
+}
+
+int agent_charge_memory(uint32_t agent_id, uint64_t bytes) {
+  ensure_initialized();
+  AgentRecord *agent = lookup_agent(agent_id);
+  if (!agent)
+    return AGENT_SUCCESS; // Kernel-owned allocations are not metered
+
+  int res = AGENT_SUCCESS;
+  bool irq = lock_agents();
+  if (agent->memory_quota != AGENT_MEMORY_UNLIMITED &&
+      (agent->memory_used > agent->memory_quota ||
+       bytes > agent->memory_quota - agent->memory_used)) {
+    agent->memory_denials++;
+    res = AGENT_ERR_OUT_OF_MEMORY;
+  } else {
+    agent->memory_used += bytes;
+    if (agent->memory_used > agent->memory_peak)
+      agent->memory_peak = agent->memory_used;
+  }
+  unlock_agents(irq);
+  return res;
+}
+
+void agent_release_memory(uint32_t agent_id, uint64_t bytes) {
+  ensure_initialized();
+  AgentRecord *agent = lookup_agent(agent_id);
+  if (!agent)
+    return;
+  bool irq = lock_agents();
+  agent->memory_used =
+      bytes < agent->memory_used ? agent->memory_used - bytes : 0;
+  unlock_agents(irq);
+}
+
+int agent_configure(AgentDescriptor *ctx, AgentTransaction *txn) {
+  ensure_initialized();
+  if (!ctx || ctx->agent_id >= AGENT_MAX_AGENTS)
+    return AGENT_ERR_INVALID_PARAM;
+  if (ctx->cpu_share_permille == 0 ||
+      ctx->cpu_share_permille > AGENT_CPU_SHARE_UNLIMITED)
+    return AGENT_ERR_INVALID_PARAM;
+
+  AgentRecord *agent = lookup_agent(ctx->agent_id);
+  if (!agent)
+    return AGENT_ERR_NOT_FOUND;
+
+  bool irq = lock_agents();
+  agent->cpu_share_permille = ctx->cpu_share_permille;
+  agent->cpu_window = ctx->cpu_window ? ctx->cpu_window
+                                      : AGENT_DEFAULT_CPU_WINDOW;
+  // A quota below current usage refuses new charges until usage drops
+  agent->memory_quota = ctx->memory_quota;
+  // New limits take effect from the next window
+  agent->throttled = 0;
+  unlock_agents(irq);
+
+  if (txn)
+    txn->result_code = AGENT_SUCCESS;
+  return AGENT_SUCCESS;
+}
+
+int agent_export_config(AgentDescriptor *out, uint32_t max_count,
+                        uint32_t *count) {
+  ensure_initialized();
+  if (!count || (!out && max_count))
+    return AGENT_ERR_INVALID_PARAM;
+
+  uint32_t n = 0;
+  bool irq = lock_agents();
+  for (uint32_t i = 0; i < AGENT_MAX_AGENTS; i++) {
+    AgentRecord *agent = &agent_table[i];
+    if (agent->cpu_share_permille == AGENT_CPU_SHARE_UNLIMITED &&
+        agent->cpu_window == AGENT_DEFAULT_CPU_WINDOW &&
+        agent->memory_quota == AGENT_MEMORY_UNLIMITED)
+      continue;
+    if (n < max_count) {
+      out[n].agent_id = i;
+      out[n].cpu_share_permille = agent->cpu_share_permille;
+      out[n].cpu_window = agent->cpu_window;
+      out[n].memory_quota = agent->memory_quota;
+    }
+    n++;
+  }
+  unlock_agents(irq);
+  *count = n;
+  return AGENT_SUCCESS;
+}
+
+int agent_query_usage(AgentDescriptor *ctx, AgentTransaction *txn) {
+  ensure_initialized();
+  if (!ctx || !txn)
+    return AGENT_ERR_INVALID_PARAM;
+
+  AgentRecord *agent = lookup_agent(ctx->agent_id);
+  if (!agent)
+    return AGENT_ERR_NOT_FOUND;
+
+  bool irq = lock_agents();
+  ctx->cpu_share_permille = agent->cpu_share_permille;
+  ctx->cpu_window = agent->cpu_window;
+  ctx->memory_quota = agent->memory_quota;
+  txn->throttled = agent->throttled;
+  txn->throttle_count = agent->throttle_count;
+  txn->cpu_time_total = agent->total_used;
+  txn->cpu_time_window = agent->window_used;
+  txn->memory_used = agent->memory_used;
+  txn->memory_peak = agent->memory_peak;
+  txn->memory_denials = agent->memory_denials;
+  unlock_agents(irq);
+  txn->result_code = AGENT_SUCCESS;
+  return AGENT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#ifndef AGENTS_H
+#define AGENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define AGENT_SUCCESS 0
+#define AGENT_ERR_INVALID_PARAM -1
+#define AGENT_ERR_OUT_OF_MEMORY -2
+#define AGENT_ERR_PERMISSION_DENIED -3
+#define AGENT_ERR_NOT_FOUND -5
+
+// Limits
+#define AGENT_MAX_AGENTS 64
+#define AGENT_CPU_SHARE_UNLIMITED 1000        // Permille of one CPU
+#define AGENT_DEFAULT_CPU_WINDOW 10000000ULL  // 10 ms in nanoseconds
+#define AGENT_MEMORY_UNLIMITED 0
+
+// Agent Descriptor (Contextual Data)
+typedef struct {
+  uint32_t agent_id;           // Agent being configured or queried
+  uint32_t cpu_share_permille; // CPU share allowed per window
+  uint64_t cpu_window;         // Accounting window (0 = default)
+  uint64_t memory_quota;       // Kernel memory bytes allowed (0 = unlimited)
+} AgentDescriptor;
+
+// Agent Transaction (Transactional Data)
+typedef struct {
+  uint32_t requester_agent_id; // Requesting agent
+  uint32_t throttled;          // Filled by kernel: 1 while throttled
+  uint32_t throttle_count;     // Filled by kernel: windows cut short
+  uint32_t memory_denials;     // Filled by kernel: allocations refused
+  uint64_t cpu_time_total;     // Filled by kernel: lifetime run time
+  uint64_t cpu_time_window;    // Filled by kernel: run time this window
+  uint64_t memory_used;        // Filled by kernel: kernel bytes charged now
+  uint64_t memory_peak;        // Filled by kernel: highest memory_used
+  int32_t result_code;         // Result filled by kernel
+} AgentTransaction;
+
+int agent_configure(AgentDescriptor *ctx, AgentTransaction *txn);
+int agent_query_usage(AgentDescriptor *ctx, AgentTransaction *txn);
+// Copies out the configuration of agents not on defaults, in the form
+// agent_configure takes. *count may exceed max_count.
+int agent_export_config(AgentDescriptor *out, uint32_t max_count,
+                        uint32_t *count);
+
+// Scheduler hooks; times are hal_read_monotonic_time values
+void agent_charge_cpu_time(uint32_t agent_id, uint64_t run_time,
+                           uint64_t now);
+int agent_is_throttled(uint32_t agent_id, uint64_t now);
+
+// Allocation hooks: kernel memory held on behalf of an agent (queued
+// payloads, thread stacks) is charged before allocating and released
+// after freeing. Both are O(1); charging fails only for that agent.
+int agent_charge_memory(uint32_t agent_id, uint64_t bytes);
+void agent_release_memory(uint32_t agent_id, uint64_t bytes);
+
+#endif // AGENTS_H
@@ -0,0 +1,202 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static BenchOptions options;
+static FILE *json = NULL;
+static int json_results = 0; // Results written so far
+static double *samples = NULL;
+
+uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double *sorted, uint32_t count,
+                         uint32_t percent) {
+  uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+  return sorted[rank ? rank - 1 : 0];
+}
+
+static void json_number(const char *key, double value) {
+  if (value < 0)
+    fprintf(json, ",\"%s\":null", key);
+  else
+    fprintf(json, ",\"%s\":%.3f", key, value);
+}
+
+static void report(const BenchResult *r) {
+  if (r->p50 < 0)
+    printf("%-32s %12.1f %10s %10s %10s %12.1f %14.0f\n", r->name,
+           r->ns_per_op, "-", "-", "-", r->max, r->ops_per_sec);
+  else
+    printf("%-32s %12.1f %10.1f %10.1f %10.1f %12.1f %14.0f\n", r->name,
+           r->ns_per_op, r->p50, r->p90, r->p99, r->max, r->ops_per_sec);
+  fflush(stdout);
+
+  if (!json)
+    return;
+  fprintf(json, "%s\n    {\"name\":\"%s\",\"ops\":%llu,\"samples\":%u",
+          json_results++ ? "," : "", r->name, (unsigned long long)r->ops,
+          r->samples);
+  json_number("ns_per_op", r->ns_per_op);
+  json_number("p50_ns", r->p50);
+  json_number("p90_ns", r->p90);
+  json_number("p99_ns", r->p99);
+  json_number("max_ns", r->max);
+  json_number("ops_per_sec", r->ops_per_sec);
+  fputc('}', json);
+}
+
+int bench_begin(const BenchOptions *opts) {
+  options = *opts;
+  if (options.samples == 0)
+    options.samples = BENCH_DEFAULT_SAMPLES;
+  if (options.samples > BENCH_MAX_SAMPLES)
+    options.samples = BENCH_MAX_SAMPLES;
+  if (options.batch_ns == 0)
+    options.batch_ns = BENCH_DEFAULT_BATCH_NS;
+
+  samples = malloc(sizeof(double) * options.samples);
+  if (!samples)
+    return -1;
+
+  if (options.json_path) {
+    json = fopen(options.json_path, "w");
+    if (!json)
+      return -1;
+    fprintf(json, "{\n  \"suite\":\"simpleos-kernel\",\n");
+    fprintf(json, "  \"revision\":\"%s\",\n",
+            options.revision ? options.revision : "unknown");
+    fprintf(json, "  \"config\":{\"samples\":%u,\"batch_ns\":%llu",
+            options.samples, (unsigned long long)options.batch_ns);
+  }
+
+  printf("%-32s %12s %10s %10s %10s %12s %14s\n", "benchmark", "ns/op",
+         "p50", "p90", "p99", "max", "ops/s");
+  return 0;
+}
+
+void bench_note_config(const char *key, long long value) {
+  if (json)
+    fprintf(json, ",\"%s\":%lld", key, value);
+}
+
+void bench_end(void) {
+  if (json) {
+    // Config is closed lazily so callers can add to it before results
+    if (json_results == 0)
+      fprintf(json, "},\n  \"results\":[");
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+    json = NULL;
+  }
+  free(samples);
+  samples = NULL;
+}
+
+int bench_enabled(const char *name) {
+  return !options.filter || strstr(name, options.filter) != NULL;
+}
+
+uint32_t bench_samples(void) { return options.samples; }
+
+static void begin_results(void) {
+  if (json && json_results == 0)
+    fprintf(json, "},\n  \"results\":[");
+}
+
+void bench_run(const char *name, BenchOpFn op, void *state,
+               uint32_t ops_per_call) {
+  if (!bench_enabled(name))
+    return;
+
+  // Grow the batch until one takes batch_ns; this doubles as warm-up
+  uint32_t batch = 1;
+  for (;;) {
+    uint64_t start = bench_now_ns();
+    op(state, batch);
+    if (bench_now_ns() - start >= options.batch_ns || batch >= (1u << 24))
+      break;
+    batch *= 2;
+  }
+
+  uint64_t total_ns = 0;
+  for (uint32_t i = 0; i < options.samples; i++) {
+    uint64_t start = bench_now_ns();
+    op(state, batch);
+    uint64_t elapsed = bench_now_ns() - start;
+    total_ns += elapsed;
+    samples[i] = (double)elapsed / ((double)batch * ops_per_call);
+  }
+
+  BenchResult r;
+  memset(&r, 0, sizeof(r));
+  r.name = name;
+  r.ops = (uint64_t)options.samples * batch * ops_per_call;
+  r.samples = options.samples;
+  r.ns_per_op = (double)total_ns / (double)r.ops;
+  qsort(samples, options.samples, sizeof(double), compare_doubles);
+  r.p50 = percentile(samples, options.samples, 50);
+  r.p90 = percentile(samples, options.samples, 90);
+  r.p99 = percentile(samples, options.samples, 99);
+  r.max = samples[options.samples - 1];
+  r.ops_per_sec = r.ns_per_op > 0 ? 1e9 / r.ns_per_op : 0;
+  begin_results();
+  report(&r);
+}
+
+void bench_record(const char *name, const uint64_t *sample_ns,
+                  uint32_t sample_count, uint32_t ops_per_sample) {
+  if (!bench_enabled(name) || sample_count == 0)
+    return;
+  if (sample_count > options.samples)
+    sample_count = options.samples;
+
+  uint64_t total_ns = 0;
+  for (uint32_t i = 0; i < sample_count; i++) {
+    total_ns += sample_ns[i];
+    samples[i] = (double)sample_ns[i] / ops_per_sample;
+  }
+
+  BenchResult r;
+  memset(&r, 0, sizeof(r));
+  r.name = name;
+  r.ops = (uint64_t)sample_count * ops_per_sample;
+  r.samples = sample_count;
+  r.ns_per_op = (double)total_ns / (double)r.ops;
+  qsort(samples, sample_count, sizeof(double), compare_doubles);
+  r.p50 = percentile(samples, sample_count, 50);
+  r.p90 = percentile(samples, sample_count, 90);
+  r.p99 = percentile(samples, sample_count, 99);
+  r.max = samples[sample_count - 1];
+  r.ops_per_sec = r.ns_per_op > 0 ? 1e9 / r.ns_per_op : 0;
+  begin_results();
+  report(&r);
+}
+
+void bench_record_summary(const char *name, uint64_t ops, double mean_ns,
+                          double max_ns) {
+  if (!bench_enabled(name) || ops == 0)
+    return;
+
+  BenchResult r;
+  memset(&r, 0, sizeof(r));
+  r.name = name;
+  r.ops = ops;
+  r.ns_per_op = mean_ns;
+  r.p50 = r.p90 = r.p99 = -1;
+  r.max = max_ns;
+  r.ops_per_sec = mean_ns > 0 ? 1e9 / mean_ns : 0;
+  begin_results();
+  report(&r);
+}
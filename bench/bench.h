@@ -0,0 +1,54 @@
+#ifndef SIMPLEOS_BENCH_H
+#define SIMPLEOS_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define BENCH_DEFAULT_SAMPLES 1000
+#define BENCH_MAX_SAMPLES 100000
+#define BENCH_DEFAULT_BATCH_NS 20000 // Target length of one timed batch
+
+// Runs the measured operation count times. Each call performs
+// ops_per_call operations as given to bench_run.
+typedef void (*BenchOpFn)(void *state, uint32_t count);
+
+typedef struct {
+  uint32_t samples;      // Timed batches per case
+  uint64_t batch_ns;     // Batch length the calibration aims for
+  const char *filter;    // Substring a case name must contain, NULL for all
+  const char *json_path; // Machine-readable results, NULL for none
+  const char *revision;  // Recorded with the results
+} BenchOptions;
+
+typedef struct {
+  const char *name;
+  uint64_t ops;     // Operations measured
+  uint32_t samples; // Batches, each yielding one ns/op sample
+  double ns_per_op; // Mean over all operations
+  double p50;       // Percentiles of the per-batch ns/op samples;
+  double p90;       // negative when only a mean and max are known
+  double p99;
+  double max;
+  double ops_per_sec;
+} BenchResult;
+
+uint64_t bench_now_ns(void);
+int bench_begin(const BenchOptions *options);
+void bench_end(void);
+// Adds a configuration key/value to the report header
+void bench_note_config(const char *key, long long value);
+int bench_enabled(const char *name);
+uint32_t bench_samples(void);
+
+// Calibrates a batch size, then times bench_samples() batches
+void bench_run(const char *name, BenchOpFn op, void *state,
+               uint32_t ops_per_call);
+// Reports samples measured by the caller, each covering ops_per_sample
+// operations
+void bench_record(const char *name, const uint64_t *sample_ns,
+                  uint32_t sample_count, uint32_t ops_per_sample);
+// Reports a result known only as a mean and maximum
+void bench_record_summary(const char *name, uint64_t ops, double mean_ns,
+                          double max_ns);
+
+#endif // SIMPLEOS_BENCH_H
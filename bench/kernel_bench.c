@@ -0,0 +1,528 @@
+#include "bench.h"
+#include "agents.h"
+#include "frames.h"
+#include "hal_clock.h"
+#include "hal_internal.h"
+#include "hal_sim.h"
+#include "integrator.h"
+#include "ipc.h"
+#include "pagetable.h"
+#include "percpu.h"
+#include "slab.h"
+#include "snapshot.h"
+#include "syscall_ring.h"
+#include "syscalls.h"
+#include "threads.h"
+#include "timepage.h"
+#include "traps.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef SIMPLEOS_BENCH_REVISION
+#define SIMPLEOS_BENCH_REVISION "unknown"
+#endif
+
+#define KERNEL_MEMORY_SIZE (64u << 20)
+#define BENCH_AGENT_ID 1
+#define BENCH_CHANNEL_ID 7
+#define BENCH_THREAD_ID_BASE 16
+#define BENCH_PAYLOAD_SIZE 64
+#define BENCH_VIRT_BASE 0x0000004000000000ULL // Clear of kernel mappings
+#define BENCH_BOOT_SAMPLES 20
+#define BENCH_IRQ_LINE 100
+#define BENCH_IRQ_PERIOD_NS 50000
+#define BENCH_IRQ_RUN_NS 200000000ULL
+
+// State a service would rebuild after a cold boot, and a warm boot restores
+#define BOOT_WORKLOAD_AGENTS 4
+#define BOOT_WORKLOAD_CHANNELS 32
+#define BOOT_WORKLOAD_THREADS 8
+
+static uint32_t bench_cpus = 1;
+
+static void *allocate_kernel_memory(void) {
+  // Buddy blocks and 2 MB mappings want the range aligned
+  return aligned_alloc(HAL_BLOCK_SIZE, KERNEL_MEMORY_SIZE);
+}
+
+static int boot_kernel(void *memory, void *snapshot_region,
+                       IntegratorTransaction *txn) {
+  IntegratorContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.cpu_count = bench_cpus;
+  ctx.kernel_memory_base = (uint64_t)(uintptr_t)memory;
+  ctx.kernel_memory_limit = ctx.kernel_memory_base + KERNEL_MEMORY_SIZE;
+  ctx.initial_agent_id = BENCH_AGENT_ID;
+  ctx.initial_thread_id = 1;
+  if (snapshot_region) {
+    ctx.snapshot_region_base = (uint64_t)(uintptr_t)snapshot_region;
+    ctx.snapshot_region_size = SNAPSHOT_REGION_SIZE;
+  }
+  memset(txn, 0, sizeof(*txn));
+  integrator_boot(&ctx, txn);
+  return txn->status_code == INTEGRATOR_STATUS_OK ? 0 : -1;
+}
+
+static void thread_entry(void) {}
+
+static void build_boot_workload(void) {
+  for (uint32_t i = 0; i < BOOT_WORKLOAD_AGENTS; i++) {
+    AgentDescriptor agent;
+    memset(&agent, 0, sizeof(agent));
+    agent.agent_id = 2 + i;
+    agent.cpu_share_permille = 250;
+    agent.memory_quota = 1u << 20;
+    agent_configure(&agent, NULL);
+  }
+  for (uint32_t i = 0; i < BOOT_WORKLOAD_CHANNELS; i++) {
+    ChannelDescriptor channel;
+    memset(&channel, 0, sizeof(channel));
+    channel.channel_id = 100 + i;
+    channel.owner_agent_id = 2 + i % BOOT_WORKLOAD_AGENTS;
+    channel.max_messages = 16;
+    channel.max_message_size = BENCH_PAYLOAD_SIZE;
+    ipc_channel_create(&channel, NULL);
+  }
+  for (uint32_t i = 0; i < BOOT_WORKLOAD_THREADS; i++) {
+    ThreadDescriptor thread;
+    memset(&thread, 0, sizeof(thread));
+    thread.thread_id = BENCH_THREAD_ID_BASE + 64 + i;
+    thread.owner_agent_id = 2 + i % BOOT_WORKLOAD_AGENTS;
+    thread.entry_point = (void *)thread_entry;
+    create_thread(&thread, NULL);
+  }
+}
+
+/**
+ * @brief Boots a fresh kernel in a child process.
+ *
+ * Kernel state is global, so every boot needs a pristine copy of it.
+ * Both kinds run every integrator phase. Cold boots rebuild the workload
+ * through the public calls afterwards; warm boots replay it from the
+ * snapshot in the restore phase.
+ * @param mode 0 cold, 1 warm, 2 cold and save a snapshot.
+ * @return Nanoseconds until the workload was in place, 0 on failure.
+ */
+static uint64_t boot_in_child(int mode, void *snapshot_region) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return 0;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    uint64_t elapsed = 0;
+    void *memory = allocate_kernel_memory();
+    IntegratorTransaction txn;
+    uint64_t start = bench_now_ns();
+    if (memory &&
+        boot_kernel(memory, mode == 1 ? snapshot_region : NULL, &txn) == 0 &&
+        txn.warm_boot == (mode == 1)) {
+      if (mode != 1)
+        build_boot_workload();
+      elapsed = bench_now_ns() - start;
+      if (mode == 2) {
+        IntegratorContext ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.snapshot_region_base = (uint64_t)(uintptr_t)snapshot_region;
+        ctx.snapshot_region_size = SNAPSHOT_REGION_SIZE;
+        if (integrator_checkpoint(&ctx) != SNAPSHOT_SUCCESS)
+          elapsed = 0;
+      }
+    }
+    if (write(fds[1], &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+      _exit(1);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  uint64_t elapsed = 0;
+  if (pid < 0 || read(fds[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+    elapsed = 0;
+  close(fds[0]);
+  if (pid > 0)
+    waitpid(pid, NULL, 0);
+  return elapsed;
+}
+
+static void bench_boot(void) {
+  if (!bench_enabled("boot."))
+    return;
+
+  // Anonymous shared memory stands in for the retained region
+  void *region = mmap(NULL, SNAPSHOT_REGION_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)
+    return;
+
+  // Calibrate the counter once, before forking: every child starts with
+  // the frequency known, so neither kind of boot times the calibration
+  hal_clock_init();
+
+  uint64_t cold[BENCH_BOOT_SAMPLES];
+  uint64_t warm[BENCH_BOOT_SAMPLES];
+  uint32_t cold_count = 0;
+  uint32_t warm_count = 0;
+  int have_snapshot = boot_in_child(2, region) != 0;
+  for (uint32_t i = 0; i < BENCH_BOOT_SAMPLES; i++) {
+    uint64_t ns = boot_in_child(0, region);
+    if (ns)
+      cold[cold_count++] = ns;
+    ns = have_snapshot ? boot_in_child(1, region) : 0;
+    if (ns)
+      warm[warm_count++] = ns;
+  }
+  bench_record("boot.cold", cold, cold_count, 1);
+  bench_record("boot.warm", warm, warm_count, 1);
+  munmap(region, SNAPSHOT_REGION_SIZE);
+}
+
+// Syscall dispatch
+
+static SyscallContext user_context(uint32_t number, uint32_t abi) {
+  SyscallContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.syscall_number = number;
+  ctx.caller_agent_id = BENCH_AGENT_ID;
+  ctx.caller_thread_id = 1;
+  ctx.abi_version = abi;
+  ctx.privilege_level = PRIVILEGE_USER;
+  return ctx;
+}
+
+static void op_syscall_block(void *state, uint32_t count) {
+  uint64_t value;
+  for (uint32_t i = 0; i < count; i++) {
+    SyscallContext ctx = user_context(SYSCALL_TIME_READ, SYSCALL_ABI_BLOCK);
+    SyscallTransaction txn;
+    memset(&txn, 0, sizeof(txn));
+    txn.argument_block_address = &value;
+    txn.argument_block_size = sizeof(value);
+    handle_syscall(&ctx, &txn);
+  }
+}
+
+static void op_syscall_register(void *state, uint32_t count) {
+  uint64_t args[SYSCALL_REGISTER_ARGS] = {0};
+  uint64_t value;
+  for (uint32_t i = 0; i < count; i++) {
+    SyscallContext ctx =
+        user_context(SYSCALL_TIME_READ, SYSCALL_ABI_REGISTER);
+    handle_fast_syscall(&ctx, args, &value);
+  }
+}
+
+// Full trap path: frame capture, vector dispatch, frame release
+
+static void trap_syscall(uint32_t abi, uint64_t *value) {
+  TrapContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.trap_type = TRAP_TYPE_SYSCALL;
+  ctx.current_agent_id = BENCH_AGENT_ID;
+  ctx.current_thread_id = 1;
+  ctx.privilege_level = PRIVILEGE_USER;
+
+  TrapTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  if (capture_trap_state(&ctx, &txn) != TRAP_SUCCESS)
+    return;
+  TrapFrame *frame = (TrapFrame *)txn.trap_frame_address;
+  frame->x[0] = ((uint64_t)abi << 32) | SYSCALL_TIME_READ;
+  frame->x[1] = (uint64_t)(uintptr_t)value;
+  frame->x[2] = sizeof(*value);
+  dispatch_trap(&ctx, &txn);
+  restore_trap_state_and_return(&ctx, &txn);
+}
+
+static void op_trap_block(void *state, uint32_t count) {
+  uint64_t value;
+  for (uint32_t i = 0; i < count; i++)
+    trap_syscall(SYSCALL_ABI_BLOCK, &value);
+}
+
+static void op_trap_register(void *state, uint32_t count) {
+  uint64_t value;
+  for (uint32_t i = 0; i < count; i++)
+    trap_syscall(SYSCALL_ABI_REGISTER, &value);
+}
+
+// One ring entry per syscall, a whole submission queue per enter
+
+static void op_ring_batch(void *state, uint32_t count) {
+  SyscallRing *ring = (SyscallRing *)state;
+  static uint64_t values[SYSCALL_RING_SQ_ENTRIES];
+  for (uint32_t n = 0; n < count; n++) {
+    for (uint32_t i = 0; i < SYSCALL_RING_SQ_ENTRIES; i++) {
+      SyscallRingSubmission *sqe =
+          &ring->sq[(ring->sq_tail + i) % SYSCALL_RING_SQ_ENTRIES];
+      sqe->syscall_number = SYSCALL_TIME_READ;
+      sqe->argument_block_address = &values[i];
+      sqe->argument_block_size = sizeof(values[i]);
+      sqe->user_data = i;
+    }
+    __atomic_store_n(&ring->sq_tail, ring->sq_tail + SYSCALL_RING_SQ_ENTRIES,
+                     __ATOMIC_RELEASE);
+    uint32_t submitted;
+    syscall_ring_enter(BENCH_AGENT_ID, 0, &submitted);
+    __atomic_store_n(&ring->cq_head,
+                     __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+  }
+}
+
+// Time sources
+
+static void op_time_page(void *state, uint32_t count) {
+  const TimePage *page = timepage_user_page();
+  volatile uint64_t sink;
+  for (uint32_t i = 0; i < count; i++)
+    sink = timepage_read_ns(page);
+  (void)sink;
+}
+
+// Page tables, on a private table so kernel mappings are untouched
+
+typedef struct {
+  PageTable table;
+  uint64_t phys;
+} PageTableBench;
+
+static void op_pagetable_map_unmap(void *state, uint32_t count) {
+  PageTableBench *b = (PageTableBench *)state;
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t virt = BENCH_VIRT_BASE + (uint64_t)(i % 64) * HAL_PAGE_SIZE;
+    pagetable_map_page(&b->table, virt, b->phys,
+                       HAL_PAGE_FLAG_READ | HAL_PAGE_FLAG_WRITE);
+    pagetable_unmap(&b->table, virt, HAL_PAGE_SIZE);
+  }
+}
+
+static void op_pagetable_lookup(void *state, uint32_t count) {
+  PageTableBench *b = (PageTableBench *)state;
+  uint64_t phys;
+  uint32_t flags;
+  for (uint32_t i = 0; i < count; i++)
+    pagetable_lookup(&b->table,
+                     BENCH_VIRT_BASE + (uint64_t)(i % 64) * HAL_PAGE_SIZE,
+                     &phys, &flags);
+}
+
+// IPC
+
+static void op_ipc_send_recv(void *state, uint32_t count) {
+  static uint8_t payload[BENCH_PAYLOAD_SIZE];
+  ChannelDescriptor *channel = (ChannelDescriptor *)state;
+  for (uint32_t i = 0; i < count; i++) {
+    MessageEnvelope msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.dst_agent_id = BENCH_AGENT_ID;
+    msg.flags = IPC_MSG_FLAG_NON_BLOCKING;
+    msg.payload = payload;
+    msg.payload_len = sizeof(payload);
+    ipc_send(channel, &msg);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.dst_agent_id = BENCH_AGENT_ID;
+    msg.flags = IPC_MSG_FLAG_NON_BLOCKING;
+    msg.payload = payload;
+    msg.payload_len = sizeof(payload);
+    ipc_recv(channel, &msg);
+  }
+}
+
+// Threads
+
+static void op_thread_create_exit(void *state, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    ThreadDescriptor thread;
+    memset(&thread, 0, sizeof(thread));
+    thread.thread_id = BENCH_THREAD_ID_BASE;
+    thread.owner_agent_id = BENCH_AGENT_ID;
+    thread.entry_point = (void *)thread_entry;
+    create_thread(&thread, NULL);
+    exit_thread(&thread, NULL);
+  }
+}
+
+static void op_thread_yield(void *state, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    ThreadDescriptor thread;
+    memset(&thread, 0, sizeof(thread));
+    thread.thread_id = thread_current_id();
+    yield_thread(&thread, NULL);
+  }
+}
+
+// Memory
+
+static void op_frames_buddy(void *state, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t addr;
+    if (frames_alloc(0, &addr) == FRAMES_SUCCESS)
+      frames_free(addr);
+  }
+}
+
+static void op_frames_cached(void *state, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t addr;
+    if (frames_alloc_page(0, &addr) == FRAMES_SUCCESS)
+      frames_free_page(0, addr);
+  }
+}
+
+static void op_slab(void *state, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    void *object;
+    if (slab_alloc_bytes(BENCH_PAYLOAD_SIZE, &object) == SLAB_SUCCESS)
+      slab_free_bytes(object, BENCH_PAYLOAD_SIZE);
+  }
+}
+
+/**
+ * @brief Interrupt delivery latency under the simulated HAL.
+ *
+ * A periodic source interrupts this thread, which acts as the CPU; the
+ * simulator measures from raise to entry into dispatch_trap.
+ */
+static void bench_irq_latency(void) {
+  if (!bench_enabled("hal_sim.irq_latency"))
+    return;
+  if (hal_sim_start(HAL_SIM_MODE_SIGNAL) != HAL_SIM_SUCCESS)
+    return;
+
+  HalSimSource source;
+  memset(&source, 0, sizeof(source));
+  source.line = BENCH_IRQ_LINE;
+  source.pattern = HAL_SIM_PATTERN_PERIODIC;
+  source.period_ns = BENCH_IRQ_PERIOD_NS;
+  int id = hal_sim_add_source(&source);
+
+  uint64_t end = bench_now_ns() + BENCH_IRQ_RUN_NS;
+  while (bench_now_ns() < end)
+    ;
+  if (id >= 0)
+    hal_sim_remove_source(id);
+  hal_sim_stop();
+
+  HalSimStats stats;
+  hal_sim_query_stats(&stats);
+  if (stats.delivered)
+    bench_record_summary("hal_sim.irq_latency", stats.delivered,
+                         (double)stats.latency_total / stats.delivered,
+                         (double)stats.latency_max);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--samples N] [--batch-ns N] [--filter STR]"
+          " [--json FILE] [--cpus N]\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options;
+  memset(&options, 0, sizeof(options));
+  options.revision = SIMPLEOS_BENCH_REVISION;
+  for (int i = 1; i < argc; i++) {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!strcmp(argv[i], "--samples") && value)
+      options.samples = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--batch-ns") && value)
+      options.batch_ns = strtoull(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--filter") && value)
+      options.filter = argv[++i];
+    else if (!strcmp(argv[i], "--json") && value)
+      options.json_path = argv[++i];
+    else if (!strcmp(argv[i], "--cpus") && value)
+      bench_cpus = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (bench_begin(&options) != 0) {
+    fprintf(stderr, "bench: cannot set up results\n");
+    return 1;
+  }
+  bench_note_config("cpus", bench_cpus);
+  bench_note_config("syscall_profile", SIMPLEOS_SYSCALL_PROFILE);
+  bench_note_config("sched_trace", SIMPLEOS_SCHED_TRACE);
+
+  // Boots run in children before this process has any kernel state
+  bench_boot();
+
+  void *memory = allocate_kernel_memory();
+  IntegratorTransaction boot;
+  if (!memory || boot_kernel(memory, NULL, &boot) != 0) {
+    fprintf(stderr, "bench: kernel boot failed in phase %u (reason %u)\n",
+            boot.current_phase, boot.failure_reason_code);
+    bench_end();
+    return 1;
+  }
+
+  bench_run("syscall.block.time_read", op_syscall_block, NULL, 1);
+  bench_run("syscall.register.time_read", op_syscall_register, NULL, 1);
+  bench_run("trap.syscall.block", op_trap_block, NULL, 1);
+  bench_run("trap.syscall.register", op_trap_register, NULL, 1);
+
+  static SyscallRing ring __attribute__((aligned(64)));
+  SyscallContext owner = user_context(SYSCALL_RING_SETUP, SYSCALL_ABI_BLOCK);
+  if (syscall_ring_setup(&owner, &ring, sizeof(ring), 0) ==
+      SYSCALL_RING_SUCCESS) {
+    bench_run("ring.batch.time_read", op_ring_batch, &ring,
+              SYSCALL_RING_SQ_ENTRIES);
+    syscall_ring_teardown(BENCH_AGENT_ID);
+  }
+
+  bench_run("time.page_read", op_time_page, NULL, 1);
+
+  static PageTableBench pt;
+  void *pool = aligned_alloc(HAL_PAGE_SIZE, 16 * HAL_PAGE_SIZE);
+  if (pool && pagetable_init(&pt.table, pool, 16 * HAL_PAGE_SIZE) ==
+                  PAGETABLE_SUCCESS) {
+    pt.phys = (uint64_t)(uintptr_t)pool;
+    bench_run("pagetable.map_unmap", op_pagetable_map_unmap, &pt, 1);
+    for (uint32_t i = 0; i < 64; i++)
+      pagetable_map_page(&pt.table, BENCH_VIRT_BASE + i * HAL_PAGE_SIZE,
+                         pt.phys, HAL_PAGE_FLAG_READ);
+    bench_run("pagetable.lookup", op_pagetable_lookup, &pt, 1);
+  }
+
+  ChannelDescriptor channel;
+  memset(&channel, 0, sizeof(channel));
+  channel.channel_id = BENCH_CHANNEL_ID;
+  channel.owner_agent_id = BENCH_AGENT_ID;
+  channel.max_messages = 16;
+  channel.max_message_size = BENCH_PAYLOAD_SIZE;
+  if (ipc_channel_create(&channel, NULL) == IPC_SUCCESS)
+    bench_run("ipc.send_recv.64B", op_ipc_send_recv, &channel, 1);
+
+  bench_run("thread.create_exit", op_thread_create_exit, NULL, 1);
+  // Two runnable threads besides the ones boot made, one of them current
+  for (uint32_t i = 1; i <= 2; i++) {
+    ThreadDescriptor thread;
+    memset(&thread, 0, sizeof(thread));
+    thread.thread_id = BENCH_THREAD_ID_BASE + i;
+    thread.owner_agent_id = BENCH_AGENT_ID;
+    thread.entry_point = (void *)thread_entry;
+    create_thread(&thread, NULL);
+  }
+  thread_schedule();
+  if (thread_current_id() != PERCPU_NO_THREAD)
+    bench_run("thread.yield", op_thread_yield, NULL, 1);
+
+  bench_run("frames.buddy.order0", op_frames_buddy, NULL, 1);
+  bench_run("frames.percpu_cache.page", op_frames_cached, NULL, 1);
+  bench_run("slab.bytes.64B", op_slab, NULL, 1);
+
+  bench_irq_latency();
+
+  bench_end();
+  return 0;
+}
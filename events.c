@@ -0,0 +1,228 @@
+#include "events.h"
+#include "agents.h"
+#include "hal.h"
+#include "hal_internal.h"
+#include "init_once.h"
+#include "percpu.h"
+#include <string.h>
+
+typedef struct {
+  EventHandlerDescriptor descriptor;
+  int is_active;
+} EventSlot;
+
+typedef struct {
+  uint8_t stack[EVENT_SHARED_STACK_SIZE] __attribute__((aligned(16)));
+  uint8_t payload[EVENT_MAX_PAYLOAD_SIZE];
+  int dispatching;
+} EventCpuArea;
+
+typedef struct {
+  EventSlot *slot;
+  EventCpuArea *area;
+  uint32_t budget;     // Messages this pass may still dispatch (0 = all)
+  uint32_t dispatched; // Messages dispatched by this pass
+  int drained;         // Channel ran empty
+} EventDrainRequest;
+
+#define PENDING_WORDS (EVENT_MAX_HANDLERS / 32)
+
+static EventSlot handler_table[EVENT_MAX_HANDLERS];
+static uint32_t pending_mask[PENDING_WORDS];
+// channel_id -> handler_id + 1, 0 when the channel has no handler bound
+static uint16_t channel_binding[IPC_MAX_CHANNELS];
+static EventCpuArea cpu_areas[HAL_MAX_CPUS];
+static int initialized = 0;
+
+static void ensure_initialized() {
+  if (init_once_begin(&initialized)) {
+    memset(handler_table, 0, sizeof(handler_table));
+    memset(pending_mask, 0, sizeof(pending_mask));
+    memset(channel_binding, 0, sizeof(channel_binding));
+    init_once_end(&initialized);
+  }
+}
+
+// Senders on any CPU mark handlers pending; the boot CPU dispatches, so
+// it is asked to schedule rather than finish the interrupted thread.
+static void set_pending(uint32_t handler_id) {
+  __atomic_fetch_or(&pending_mask[handler_id / 32],
+                    1u << (handler_id % 32), __ATOMIC_RELEASE);
+  percpu_request_resched(0);
+}
+
+static void clear_pending(uint32_t handler_id) {
+  __atomic_fetch_and(&pending_mask[handler_id / 32],
+                     ~(1u << (handler_id % 32)), __ATOMIC_ACQ_REL);
+}
+
+static uint64_t read_event_clock() {
+  HardwareTransaction txn;
+  txn.operation_code = HAL_OP_READ_TIME;
+  txn.input_address = 0;
+  txn.input_value = 0;
+  txn.output_address = 0;
+  txn.output_value = 0;
+  txn.status_code = HAL_STATUS_OK;
+  hal_read_monotonic_time(&percpu_this()->hw_context, &txn);
+  return txn.output_value;
+}
+
+static EventSlot *lookup_handler(uint32_t handler_id) {
+  if (handler_id >= EVENT_MAX_HANDLERS)
+    return NULL;
+  if (!handler_table[handler_id].is_active)
+    return NULL;
+  return &handler_table[handler_id];
+}
+
+/**
+ * @brief Delivers queued messages of one channel to its handler.
+ *
+ * Runs on the shared per-CPU stack. Each message is received into the
+ * per-CPU payload buffer and handed to the handler, which runs to
+ * completion before the next message is received.
+ * @param arg Pointer to an EventDrainRequest.
+ */
+static void drain_handler_messages(void *arg) {
+  EventDrainRequest *req = (EventDrainRequest *)arg;
+  ChannelDescriptor chan;
+  memset(&chan, 0, sizeof(chan));
+  chan.channel_id = req->slot->descriptor.channel_id;
+
+  while (req->budget == 0 || req->dispatched < req->budget) {
+    if (!req->slot->is_active)
+      return; // Handler unregistered itself
+    MessageEnvelope msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.flags = IPC_MSG_FLAG_NON_BLOCKING;
+    msg.payload = req->area->payload;
+    msg.payload_len = EVENT_MAX_PAYLOAD_SIZE;
+    if (ipc_recv(&chan, &msg) != IPC_SUCCESS) {
+      req->drained = 1;
+      return;
+    }
+    req->slot->descriptor.handler(&msg, req->slot->descriptor.agent_state);
+    req->dispatched++;
+  }
+}
+
+void event_notify_channel(uint32_t channel_id) {
+  if (!init_once_done(&initialized) || channel_id >= IPC_MAX_CHANNELS)
+    return;
+  uint16_t binding = channel_binding[channel_id];
+  if (binding)
+    set_pending(binding - 1);
+}
+
+int event_handler_register(EventHandlerDescriptor *ctx,
+                           EventTransaction *txn) {
+  ensure_initialized();
+  if (!ctx || !ctx->handler)
+    return EVENT_ERR_INVALID_PARAM;
+  if (ctx->handler_id >= EVENT_MAX_HANDLERS ||
+      ctx->channel_id >= IPC_MAX_CHANNELS)
+    return EVENT_ERR_INVALID_PARAM;
+  // The handler consumes every message on the channel, so only its owner
+  // may bind one
+  int res = ipc_channel_check_owner(ctx->channel_id, ctx->owner_agent_id);
+  if (res == IPC_ERR_CHANNEL_NOT_FOUND)
+    return EVENT_ERR_NOT_FOUND;
+  if (res != IPC_SUCCESS)
+    return EVENT_ERR_PERMISSION_DENIED;
+
+  EventSlot *slot = &handler_table[ctx->handler_id];
+  if (slot->is_active)
+    return EVENT_ERR_PERMISSION_DENIED; // Slot already occupied
+  if (channel_binding[ctx->channel_id])
+    return EVENT_ERR_INVALID_STATE; // Channel already has a handler
+
+  slot->descriptor = *ctx;
+  slot->is_active = 1;
+  channel_binding[ctx->channel_id] = (uint16_t)(ctx->handler_id + 1);
+
+  // Messages queued before registration are delivered on the next pass
+  set_pending(ctx->handler_id);
+
+  if (txn)
+    txn->result_code = EVENT_SUCCESS;
+  return EVENT_SUCCESS;
+}
+
+int event_handler_unregister(EventHandlerDescriptor *ctx,
+                             EventTransaction *txn) {
+  ensure_initialized();
+  if (!ctx || !txn)
+    return EVENT_ERR_INVALID_PARAM;
+
+  EventSlot *slot = lookup_handler(ctx->handler_id);
+  if (!slot)
+    return EVENT_ERR_NOT_FOUND;
+  if (slot->descriptor.owner_agent_id != txn->requester_agent_id)
+    return EVENT_ERR_PERMISSION_DENIED;
+
+  channel_binding[slot->descriptor.channel_id] = 0;
+  clear_pending(ctx->handler_id);
+  slot->is_active = 0;
+
+  txn->result_code = EVENT_SUCCESS;
+  return EVENT_SUCCESS;
+}
+
+int event_dispatch_pending(EventTransaction *txn) {
+  ensure_initialized();
+  if (!txn || txn->cpu_id >= HAL_MAX_CPUS)
+    return EVENT_ERR_INVALID_PARAM;
+
+  EventCpuArea *area = &cpu_areas[txn->cpu_id];
+  txn->messages_dispatched = 0;
+
+  // Handlers that send to other event channels only mark them pending;
+  // they are picked up by this same pass, never by a nested one.
+  if (area->dispatching)
+    return EVENT_ERR_INVALID_STATE;
+  area->dispatching = 1;
+
+  uint64_t stack_top =
+      (uint64_t)(uintptr_t)(area->stack + EVENT_SHARED_STACK_SIZE);
+
+  for (uint32_t word = 0; word < PENDING_WORDS; word++) {
+    uint32_t bits;
+    while ((bits = __atomic_load_n(&pending_mask[word], __ATOMIC_ACQUIRE))) {
+      uint32_t handler_id = word * 32 + (uint32_t)__builtin_ctz(bits);
+      clear_pending(handler_id);
+
+      EventDrainRequest req;
+      req.slot = &handler_table[handler_id];
+      req.area = area;
+      req.budget = 0;
+      req.dispatched = 0;
+      req.drained = 0;
+      if (txn->message_budget) {
+        req.budget = txn->message_budget - txn->messages_dispatched;
+      }
+
+      if (req.slot->is_active) {
+        // Handler time counts against its agent's CPU share
+        uint32_t owner = req.slot->descriptor.owner_agent_id;
+        uint64_t start = read_event_clock();
+        hal_internal_call_on_stack(drain_handler_messages, &req, stack_top);
+        uint64_t end = read_event_clock();
+        agent_charge_cpu_time(owner, end - start, end);
+      }
+
+      txn->messages_dispatched += req.dispatched;
+      if (req.slot->is_active && !req.drained) {
+        // Budget exhausted with messages left: resume on the next pass
+        set_pending(handler_id);
+        area->dispatching = 0;
+        txn->result_code = EVENT_SUCCESS;
+        return EVENT_SUCCESS;
+      }
+    }
+  }
+
+  area->dispatching = 0;
+  txn->result_code = EVENT_SUCCESS;
+  return EVENT_SUCCESS;
+}
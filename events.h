@@ -0,0 +1,52 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "ipc.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define EVENT_SUCCESS 0
+#define EVENT_ERR_INVALID_PARAM -1
+#define EVENT_ERR_OUT_OF_MEMORY -2
+#define EVENT_ERR_PERMISSION_DENIED -3
+#define EVENT_ERR_INVALID_STATE -4
+#define EVENT_ERR_NOT_FOUND -5
+
+// Limits
+#define EVENT_MAX_HANDLERS 256
+#define EVENT_SHARED_STACK_SIZE 4096 // Per-CPU stack shared by all handlers
+#define EVENT_MAX_PAYLOAD_SIZE 256   // Largest payload delivered to a handler
+
+// Event-handler agents have no thread and no stack of their own. The kernel
+// calls the handler once per message on the bound channel, on the shared
+// stack of the dispatching CPU, and the handler runs to completion.
+// msg->payload is only valid for the duration of the call.
+typedef void (*EventHandlerFn)(const MessageEnvelope *msg, void *agent_state);
+
+// Event Handler Descriptor (Contextual Data)
+typedef struct {
+  uint32_t handler_id;       // Handler slot
+  uint32_t owner_agent_id;   // Owner agent
+  uint32_t channel_id;       // Channel whose messages trigger the handler
+  uint32_t agent_state_size; // Size of the persistent state block
+  EventHandlerFn handler;    // Invoked once per message
+  void *agent_state;         // Persistent state handed to every invocation
+} EventHandlerDescriptor;
+
+// Event Transaction (Transactional Data)
+typedef struct {
+  uint32_t requester_agent_id;  // Requesting agent
+  uint32_t cpu_id;              // CPU whose shared stack runs the handlers
+  uint32_t message_budget;      // Max messages to dispatch (0 = drain all)
+  uint32_t messages_dispatched; // Filled by kernel
+  int32_t result_code;          // Result filled by kernel
+} EventTransaction;
+
+int event_handler_register(EventHandlerDescriptor *ctx, EventTransaction *txn);
+int event_handler_unregister(EventHandlerDescriptor *ctx,
+                             EventTransaction *txn);
+int event_dispatch_pending(EventTransaction *txn);
+void event_notify_channel(uint32_t channel_id);
+
+#endif // EVENTS_H
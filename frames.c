@@ -0,0 +1,342 @@
+#include "frames.h"
+#include <string.h>
+
+#define NO_FRAME 0xFFFFFFFFu
+
+// Per-frame state. Only the head frame of a block is meaningful.
+#define FRAME_INSIDE 0    // Part of a larger block
+#define FRAME_FREE 1      // Head of a free block, on free_lists[order]
+#define FRAME_ALLOCATED 2 // Head of an allocated block
+#define FRAME_CACHED 3    // Single page held by a per-CPU cache
+
+typedef struct {
+  uint32_t next;
+  uint32_t prev;
+  uint8_t order;
+  uint8_t state;
+  uint16_t reserved;
+} FrameInfo;
+
+// Each CPU owns its cache; only refills and drains take the buddy lock
+typedef struct {
+  uint32_t count;
+  uint32_t frames[FRAMES_CPU_CACHE_SIZE];
+} __attribute__((aligned(64))) FrameCpuCache;
+
+static FrameInfo *frame_table = NULL;
+static uint64_t frames_base = 0; // Address of frame 0
+static uint32_t frame_count = 0;
+static uint32_t free_lists[FRAMES_MAX_ORDER + 1];
+static uint64_t free_blocks[FRAMES_MAX_ORDER + 1];
+static uint64_t free_pages = 0;
+static uint64_t alloc_failures = 0;
+static FrameCpuCache cpu_caches[HAL_MAX_CPUS];
+static int buddy_lock = 0;
+
+static void lock_buddy(void) {
+  while (__atomic_test_and_set(&buddy_lock, __ATOMIC_ACQUIRE))
+    ;
+}
+
+static void unlock_buddy(void) {
+  __atomic_clear(&buddy_lock, __ATOMIC_RELEASE);
+}
+
+static uint64_t frame_address(uint32_t index) {
+  return frames_base + (uint64_t)index * HAL_PAGE_SIZE;
+}
+
+static int frame_index(uint64_t addr, uint32_t *index) {
+  if (addr < frames_base || (addr - frames_base) % HAL_PAGE_SIZE != 0)
+    return 0;
+  uint64_t i = (addr - frames_base) / HAL_PAGE_SIZE;
+  if (i >= frame_count)
+    return 0;
+  *index = (uint32_t)i;
+  return 1;
+}
+
+static void push_free(uint32_t index, uint32_t order) {
+  FrameInfo *f = &frame_table[index];
+  f->state = FRAME_FREE;
+  f->order = (uint8_t)order;
+  f->prev = NO_FRAME;
+  f->next = free_lists[order];
+  if (f->next != NO_FRAME)
+    frame_table[f->next].prev = index;
+  free_lists[order] = index;
+  free_blocks[order]++;
+  free_pages += 1ull << order;
+}
+
+static void remove_free(uint32_t index) {
+  FrameInfo *f = &frame_table[index];
+  if (f->prev != NO_FRAME)
+    frame_table[f->prev].next = f->next;
+  else
+    free_lists[f->order] = f->next;
+  if (f->next != NO_FRAME)
+    frame_table[f->next].prev = f->prev;
+  f->state = FRAME_INSIDE;
+  free_blocks[f->order]--;
+  free_pages -= 1ull << f->order;
+}
+
+/**
+ * @brief Returns a block to the free lists, merging with free buddies.
+ *
+ * Buddies are found by flipping bit `order` of the frame index, so the
+ * loop runs at most FRAMES_MAX_ORDER times. Caller holds the lock.
+ */
+static void free_block(uint32_t index, uint32_t order) {
+  // If the block merges down into its buddy, push_free never reaches this
+  // head; mark it now so a second free fails the state check
+  frame_table[index].state = FRAME_INSIDE;
+  while (order < FRAMES_MAX_ORDER) {
+    uint32_t buddy = index ^ (1u << order);
+    if (buddy >= frame_count || frame_table[buddy].state != FRAME_FREE ||
+        frame_table[buddy].order != order)
+      break;
+    remove_free(buddy);
+    index &= ~(1u << order);
+    order++;
+  }
+  push_free(index, order);
+}
+
+// Caller holds the lock
+static int alloc_block(uint32_t order, uint32_t *index) {
+  uint32_t k = order;
+  while (k <= FRAMES_MAX_ORDER && free_lists[k] == NO_FRAME)
+    k++;
+  if (k > FRAMES_MAX_ORDER) {
+    alloc_failures++;
+    return 0;
+  }
+
+  uint32_t i = free_lists[k];
+  remove_free(i);
+  // Split down, returning the upper halves
+  while (k > order) {
+    k--;
+    push_free(i + (1u << k), k);
+  }
+  frame_table[i].state = FRAME_ALLOCATED;
+  frame_table[i].order = (uint8_t)order;
+  *index = i;
+  return 1;
+}
+
+// Largest aligned power-of-two block starting at index that fits in end
+static uint32_t fitting_order(uint32_t index, uint32_t end) {
+  uint32_t order = 0;
+  while (order < FRAMES_MAX_ORDER && (index & (1u << order)) == 0 &&
+         index + (2u << order) <= end)
+    order++;
+  return order;
+}
+
+// Frees [index, end) as a run of maximal aligned blocks. Caller holds lock.
+static void free_run(uint32_t index, uint32_t end) {
+  while (index < end) {
+    uint32_t order = fitting_order(index, end);
+    free_block(index, order);
+    index += 1u << order;
+  }
+}
+
+uint32_t frames_order_for_size(uint64_t size) {
+  uint64_t pages = (size + HAL_PAGE_SIZE - 1) / HAL_PAGE_SIZE;
+  uint32_t order = 0;
+  while ((1ull << order) < pages)
+    order++;
+  return order;
+}
+
+int frames_init(uint64_t base, uint64_t limit) {
+  base = (base + HAL_PAGE_SIZE - 1) & ~(uint64_t)(HAL_PAGE_SIZE - 1);
+  limit &= ~(uint64_t)(HAL_PAGE_SIZE - 1);
+  if (base == 0 || limit <= base)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  // Metadata for every page of the range lives in its first pages
+  uint64_t pages = (limit - base) / HAL_PAGE_SIZE;
+  uint64_t meta_pages =
+      (pages * sizeof(FrameInfo) + HAL_PAGE_SIZE - 1) / HAL_PAGE_SIZE;
+  if (meta_pages >= pages || pages - meta_pages > NO_FRAME)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  frame_table = (FrameInfo *)(uintptr_t)base;
+  frames_base = base + meta_pages * HAL_PAGE_SIZE;
+  frame_count = (uint32_t)(pages - meta_pages);
+  memset(frame_table, 0, (size_t)frame_count * sizeof(FrameInfo));
+
+  for (uint32_t k = 0; k <= FRAMES_MAX_ORDER; k++) {
+    free_lists[k] = NO_FRAME;
+    free_blocks[k] = 0;
+  }
+  free_pages = 0;
+  alloc_failures = 0;
+  memset(cpu_caches, 0, sizeof(cpu_caches));
+
+  lock_buddy();
+  free_run(0, frame_count);
+  unlock_buddy();
+  return FRAMES_SUCCESS;
+}
+
+int frames_alloc(uint32_t order, uint64_t *addr) {
+  if (!addr || order > FRAMES_MAX_ORDER || !frame_table)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  uint32_t index;
+  lock_buddy();
+  int ok = alloc_block(order, &index);
+  unlock_buddy();
+  if (!ok)
+    return FRAMES_ERR_OUT_OF_MEMORY;
+  *addr = frame_address(index);
+  return FRAMES_SUCCESS;
+}
+
+int frames_alloc_exact(uint64_t size, uint64_t *addr) {
+  uint32_t order = frames_order_for_size(size);
+  if (!addr || size == 0 || order > FRAMES_MAX_ORDER || !frame_table)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  uint32_t pages = (uint32_t)((size + HAL_PAGE_SIZE - 1) / HAL_PAGE_SIZE);
+  uint32_t index;
+  lock_buddy();
+  int ok = alloc_block(order, &index);
+  if (ok) {
+    // Keep the used pages as a run of allocated blocks, free the tail
+    uint32_t end = index + pages;
+    for (uint32_t i = index; i < end;) {
+      uint32_t k = fitting_order(i - index, pages);
+      frame_table[i].state = FRAME_ALLOCATED;
+      frame_table[i].order = (uint8_t)k;
+      i += 1u << k;
+    }
+    free_run(end, index + (1u << order));
+  }
+  unlock_buddy();
+  if (!ok)
+    return FRAMES_ERR_OUT_OF_MEMORY;
+  *addr = frame_address(index);
+  return FRAMES_SUCCESS;
+}
+
+int frames_free(uint64_t addr) {
+  uint32_t index;
+  if (!frame_table || !frame_index(addr, &index))
+    return FRAMES_ERR_INVALID_PARAM;
+
+  lock_buddy();
+  if (frame_table[index].state != FRAME_ALLOCATED) {
+    unlock_buddy();
+    return FRAMES_ERR_NOT_FOUND;
+  }
+  free_block(index, frame_table[index].order);
+  unlock_buddy();
+  return FRAMES_SUCCESS;
+}
+
+int frames_free_exact(uint64_t addr, uint64_t size) {
+  uint32_t index;
+  if (!frame_table || size == 0 || !frame_index(addr, &index))
+    return FRAMES_ERR_INVALID_PARAM;
+
+  uint64_t pages = (size + HAL_PAGE_SIZE - 1) / HAL_PAGE_SIZE;
+  if (pages > frame_count - index)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  lock_buddy();
+  // Walk the run of blocks laid down by frames_alloc_exact
+  uint32_t end = index + (uint32_t)pages;
+  for (uint32_t i = index; i < end;) {
+    if (frame_table[i].state != FRAME_ALLOCATED) {
+      unlock_buddy();
+      return FRAMES_ERR_NOT_FOUND;
+    }
+    uint32_t order = frame_table[i].order;
+    free_block(i, order);
+    i += 1u << order;
+  }
+  unlock_buddy();
+  return FRAMES_SUCCESS;
+}
+
+int frames_alloc_page(uint32_t cpu_id, uint64_t *addr) {
+  if (cpu_id >= HAL_MAX_CPUS || !addr || !frame_table)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  FrameCpuCache *cache = &cpu_caches[cpu_id];
+  if (cache->count == 0) {
+    lock_buddy();
+    uint32_t index;
+    while (cache->count < FRAMES_CPU_CACHE_BATCH && alloc_block(0, &index)) {
+      frame_table[index].state = FRAME_CACHED;
+      cache->frames[cache->count++] = index;
+    }
+    unlock_buddy();
+    if (cache->count == 0)
+      return FRAMES_ERR_OUT_OF_MEMORY;
+  }
+
+  uint32_t index = cache->frames[--cache->count];
+  frame_table[index].state = FRAME_ALLOCATED;
+  *addr = frame_address(index);
+  return FRAMES_SUCCESS;
+}
+
+int frames_free_page(uint32_t cpu_id, uint64_t addr) {
+  uint32_t index;
+  if (cpu_id >= HAL_MAX_CPUS || !frame_table || !frame_index(addr, &index))
+    return FRAMES_ERR_INVALID_PARAM;
+  if (frame_table[index].state != FRAME_ALLOCATED ||
+      frame_table[index].order != 0)
+    return FRAMES_ERR_NOT_FOUND;
+
+  FrameCpuCache *cache = &cpu_caches[cpu_id];
+  if (cache->count == FRAMES_CPU_CACHE_SIZE) {
+    // Drain the older half back so neighbouring pages can merge again
+    lock_buddy();
+    for (uint32_t i = 0; i < FRAMES_CPU_CACHE_BATCH; i++)
+      free_block(cache->frames[i], 0);
+    unlock_buddy();
+    cache->count -= FRAMES_CPU_CACHE_BATCH;
+    memmove(cache->frames, cache->frames + FRAMES_CPU_CACHE_BATCH,
+            cache->count * sizeof(cache->frames[0]));
+  }
+
+  frame_table[index].state = FRAME_CACHED;
+  cache->frames[cache->count++] = index;
+  return FRAMES_SUCCESS;
+}
+
+int frames_query_stats(FrameStats *stats) {
+  if (!stats)
+    return FRAMES_ERR_INVALID_PARAM;
+
+  memset(stats, 0, sizeof(*stats));
+  lock_buddy();
+  stats->total_pages = frame_count;
+  stats->free_pages = free_pages;
+  stats->alloc_failures = alloc_failures;
+  for (uint32_t k = 0; k <= FRAMES_MAX_ORDER; k++) {
+    stats->free_blocks[k] = free_blocks[k];
+    if (free_blocks[k])
+      stats->largest_free_order = k;
+  }
+  unlock_buddy();
+
+  for (uint32_t cpu = 0; cpu < HAL_MAX_CPUS; cpu++)
+    stats->cached_pages += cpu_caches[cpu].count;
+  if (stats->free_pages) {
+    uint32_t top = stats->largest_free_order;
+    uint64_t top_pages = stats->free_blocks[top] << top;
+    stats->fragmentation_permille =
+        (uint32_t)(1000 - 1000 * top_pages / stats->free_pages);
+  }
+  return FRAMES_SUCCESS;
+}
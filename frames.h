@@ -0,0 +1,46 @@
+#ifndef SIMPLEOS_FRAMES_H
+#define SIMPLEOS_FRAMES_H
+
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define FRAMES_SUCCESS 0
+#define FRAMES_ERR_INVALID_PARAM -1
+#define FRAMES_ERR_OUT_OF_MEMORY -2
+#define FRAMES_ERR_NOT_FOUND -5
+
+#define FRAMES_MAX_ORDER 10       // Largest block: 2^10 pages (4 MB)
+#define FRAMES_CPU_CACHE_SIZE 32  // Single pages cached per CPU
+#define FRAMES_CPU_CACHE_BATCH 16 // Pages moved per refill or drain
+
+typedef struct {
+  uint64_t total_pages;      // Pages managed, metadata excluded
+  uint64_t free_pages;       // In the buddy free lists
+  uint64_t cached_pages;     // In per-CPU caches
+  uint64_t free_blocks[FRAMES_MAX_ORDER + 1]; // Free blocks per order
+  uint32_t largest_free_order;
+  // 0 when all free memory sits in blocks of the largest free order,
+  // toward 1000 as it splinters into smaller blocks
+  uint32_t fragmentation_permille;
+  uint64_t alloc_failures;
+} FrameStats;
+
+// Buddy allocator over the kernel memory range. Per-frame metadata is
+// carved from the start of the range, so the range must be mapped.
+int frames_init(uint64_t base, uint64_t limit);
+uint32_t frames_order_for_size(uint64_t size);
+// 2^order physically contiguous pages
+int frames_alloc(uint32_t order, uint64_t *addr);
+// Exactly size bytes rounded up to pages; the unused tail of the buddy
+// block goes straight back to the free lists
+int frames_alloc_exact(uint64_t size, uint64_t *addr);
+int frames_free(uint64_t addr);
+int frames_free_exact(uint64_t addr, uint64_t size);
+// Single pages through the per-CPU cache of cpu_id
+int frames_alloc_page(uint32_t cpu_id, uint64_t *addr);
+int frames_free_page(uint32_t cpu_id, uint64_t addr);
+int frames_query_stats(FrameStats *stats);
+
+#endif // SIMPLEOS_FRAMES_H
@@ -1,194 +1,607 @@
-#include "hal.h"
-#include "hal_internal.h"
-#include <stddef.h>
-
-static HardwareContext g_hw_context;
-
-/**
- * @brief Validates HAL function parameters and sets error status if invalid.
- * @param context Pointer to HardwareContext.
- * @param transaction Pointer to HardwareTransaction.
- * @return 0 if valid, 1 if invalid (status_code set to HAL_STATUS_INVALID).
- */
-static int validate_hal_params(HardwareContext *context,
-                               HardwareTransaction *transaction) {
-  if (!context || !transaction) {
-    if (transaction)
-      transaction->status_code = HAL_STATUS_INVALID;
-    return 1; // Invalid
-  }
-  return 0; // Valid
-}
-
-void hal_initialize_hardware(HardwareContext *context,
-                             HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-  g_hw_context = *context;
-
-  hal_internal_program_interrupt_controller();
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_enable_interrupts(HardwareContext *context,
-                           HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_disable_interrupts(HardwareContext *context,
-                            HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_configure_timer_tick(HardwareContext *context,
-                              HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  uint64_t freq = transaction->input_value;
-  hal_internal_program_timer_hardware(freq);
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_read_monotonic_time(HardwareContext *context,
-                             HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  uint64_t time = hal_internal_read_timer_hardware_counter();
-
-  if (transaction->output_address != 0) {
-    // Validate output address is within kernel memory bounds
-    if (transaction->output_address >= context->kernel_memory_base &&
-        transaction->output_address + sizeof(uint64_t) <=
-            context->kernel_memory_limit) {
-      *(uint64_t *)(transaction->output_address) = time;
-    } else {
-      transaction->status_code = HAL_STATUS_INVALID;
-      return;
-    }
-  }
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_save_cpu_context(HardwareContext *context,
-                          HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  TrapFrame *tf = (TrapFrame *)(transaction->output_address);
-  if (tf) {
-    tf->elr = 0xDEADBEEF; // Dummy
-  }
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_restore_cpu_context(HardwareContext *context,
-                             HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  TrapFrame *tf = (TrapFrame *)(transaction->input_address);
-  if (tf) {
-    hal_internal_set_stack_pointer(tf->sp);
-  }
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_acknowledge_interrupt(HardwareContext *context,
-                               HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  uint32_t vector = (uint32_t)transaction->input_value;
-  hal_internal_send_end_of_interrupt(vector);
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_map_memory_page(HardwareContext *context,
-                         HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  hal_internal_write_page_table_entry(transaction->output_address,
-                                      transaction->input_address,
-                                      (uint32_t)transaction->input_value);
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_unmap_memory_page(HardwareContext *context,
-                           HardwareTransaction *transaction) {
-  if (validate_hal_params(context, transaction))
-    return;
-
-  hal_internal_invalidate_tlb_entry(transaction->input_address);
-
-  transaction->status_code = HAL_STATUS_OK;
-}
-
-void hal_internal_set_stack_pointer(uint64_t sp) { (void)sp; }
-
-void hal_internal_set_cpu_mode(uint32_t mode) { (void)mode; }
-
-uint64_t hal_internal_read_cpu_flags(void) {
-  uint64_t flags = 0;
-  return flags;
-}
-
-void hal_internal_write_cpu_flags(uint64_t flags) { (void)flags; }
-
-void hal_internal_program_timer_hardware(uint64_t ticks) {
-#ifdef __aarch64__
-  // Write Time Value
-  __asm__ volatile("msr cntp_tval_el0, %0" : : "r"(ticks));
-  // Enable EL0 physical timer (bit 0 = enable, bit 1 = imask)
-  uint64_t ctl = 1;
-  __asm__ volatile("msr cntp_ctl_el0, %0" : : "r"(ctl));
-#else
-  (void)ticks;
-#endif
-}
-
-uint64_t hal_internal_read_timer_hardware_counter(void) {
-  uint64_t cnt = 0;
-#ifdef __aarch64__
-  __asm__ volatile("mrs %0, cntpct_el0" : "=r"(cnt));
-#else
-  static uint64_t host_counter = 0;
-  cnt = host_counter++;
-#endif
-  return cnt;
-}
-
-void hal_internal_program_interrupt_controller(void) {
-  // Skeleton for GIC initialization
-  // In a real implementation, we would use g_hw_context.mmio_base
-  // to configure the GIC Distributor and CPU Interface.
-}
-
-void hal_internal_send_end_of_interrupt(uint32_t vector) {
-  // Skeleton for GIC EOI
-  // Would write 'vector' to the GIC CPU Interface EOI register (GICC_EOIR)
-}
-
-void hal_internal_write_page_table_entry(uint64_t virt, uint64_t phys,
-                                         uint32_t flags) {
-  // Stub
-}
-
-void hal_internal_invalidate_tlb_entry(uint64_t virt) {
-  // Stub
-}
+#include "hal.h"
+#include "hal_clock.h"
+#include "hal_internal.h"
+#include "hal_sim.h"
+#include "pagetable.h"
+#include <stddef.h>
+
+static HardwareContext g_hw_context;
+static PageTable kernel_page_table;
+static int page_table_ready = 0;
+static bool (*deferred_page_table_init)(void) = NULL;
+static int page_table_init_lock = 0;
+static uint64_t timer_period_ticks = 0;
+
+/**
+ * @brief Validates HAL function parameters and sets error status if invalid.
+ * @param context Pointer to HardwareContext.
+ * @param transaction Pointer to HardwareTransaction.
+ * @return 0 if valid, 1 if invalid (status_code set to HAL_STATUS_INVALID).
+ */
+static int validate_hal_params(HardwareContext *context,
+                               HardwareTransaction *transaction) {
+  if (!context || !transaction) {
+    if (transaction)
+      transaction->status_code = HAL_STATUS_INVALID;
+    return 1; // Invalid
+  }
+  return 0; // Valid
+}
+
+void hal_initialize_hardware(HardwareContext *context,
+                             HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+  g_hw_context = *context;
+
+  if (!hal_clock_init()) {
+    transaction->status_code = HAL_STATUS_FAILURE;
+    return;
+  }
+  hal_internal_enable_user_counter();
+  hal_internal_program_interrupt_controller();
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_enable_interrupts(HardwareContext *context,
+                           HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  if (transaction->operation_code == HAL_OP_UNMASK_IRQ_LINE)
+    hal_internal_mask_interrupt_line((uint32_t)transaction->input_value,
+                                     false);
+  else if (transaction->operation_code == HAL_OP_ENABLE_IRQ)
+    hal_internal_set_irq_enabled(true);
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_disable_interrupts(HardwareContext *context,
+                            HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  if (transaction->operation_code == HAL_OP_MASK_IRQ_LINE)
+    hal_internal_mask_interrupt_line((uint32_t)transaction->input_value,
+                                     true);
+  else if (transaction->operation_code == HAL_OP_DISABLE_IRQ)
+    hal_internal_set_irq_enabled(false);
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_configure_timer_tick(HardwareContext *context,
+                              HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  uint64_t hz = transaction->input_value;
+  if (hz == 0) {
+    transaction->status_code = HAL_STATUS_INVALID;
+    return;
+  }
+  HalClockParams params;
+  hal_clock_get_params(&params);
+  hal_internal_program_timer_hardware(params.frequency / hz);
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_read_monotonic_time(HardwareContext *context,
+                             HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+#if SIMPLEOS_HAL_SIM
+  uint64_t time = hal_sim_now(); // Simulated time in manual mode
+#else
+  uint64_t time = hal_clock_read_ns();
+#endif
+  transaction->output_value = time;
+
+  if (transaction->output_address != 0) {
+    // Validate output address is within kernel memory bounds
+    if (transaction->output_address >= context->kernel_memory_base &&
+        transaction->output_address + sizeof(uint64_t) <=
+            context->kernel_memory_limit) {
+      *(uint64_t *)(transaction->output_address) = time;
+    } else {
+      transaction->status_code = HAL_STATUS_INVALID;
+      return;
+    }
+  }
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_save_cpu_context(HardwareContext *context,
+                          HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  TrapFrame *tf = (TrapFrame *)(transaction->output_address);
+  if (tf) {
+    tf->elr = 0xDEADBEEF; // Dummy
+  }
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_restore_cpu_context(HardwareContext *context,
+                             HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  TrapFrame *tf = (TrapFrame *)(transaction->input_address);
+  if (tf) {
+    hal_internal_set_stack_pointer(tf->sp);
+  }
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_acknowledge_interrupt(HardwareContext *context,
+                               HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  uint32_t vector = (uint32_t)transaction->input_value;
+  if (vector == HAL_TIMER_IRQ)
+    hal_internal_rearm_timer();
+  hal_internal_send_end_of_interrupt(vector);
+
+  transaction->status_code = HAL_STATUS_OK;
+}
+
+void hal_start_cpu(HardwareContext *context,
+                   HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  uint32_t cpu_id = (uint32_t)transaction->input_value;
+  if (cpu_id == 0 || cpu_id >= HAL_MAX_CPUS ||
+      transaction->input_address == 0) {
+    transaction->status_code = HAL_STATUS_INVALID;
+    return;
+  }
+  transaction->status_code =
+      hal_internal_start_cpu(cpu_id, transaction->input_address, cpu_id)
+          ? HAL_STATUS_OK
+          : HAL_STATUS_FAILURE;
+}
+
+/**
+ * @brief Maps [virt, virt + length) to physical memory starting at phys.
+ *
+ * Runs that are 2 MB aligned on both sides use block descriptors, the
+ * rest use 4 KB pages. Does no TLB maintenance.
+ * @return HAL status code.
+ */
+static uint32_t map_range(uint64_t virt, uint64_t phys, uint64_t length,
+                          uint32_t flags) {
+  if (length == 0 || ((virt | phys | length) & (HAL_PAGE_SIZE - 1)))
+    return HAL_STATUS_INVALID;
+
+  uint64_t end = virt + length;
+  while (virt < end) {
+    uint64_t step = HAL_PAGE_SIZE;
+    bool ok;
+    if (((virt | phys) & (HAL_BLOCK_SIZE - 1)) == 0 &&
+        end - virt >= HAL_BLOCK_SIZE) {
+      step = HAL_BLOCK_SIZE;
+      ok = hal_internal_write_block_entry(virt, phys, flags);
+    } else {
+      ok = hal_internal_write_page_table_entry(virt, phys, flags);
+    }
+    if (!ok)
+      return HAL_STATUS_FAILURE;
+    virt += step;
+    phys += step;
+  }
+  return HAL_STATUS_OK;
+}
+
+static uint32_t unmap_range(uint64_t virt, uint64_t length) {
+  if (length == 0 || ((virt | length) & (HAL_PAGE_SIZE - 1)))
+    return HAL_STATUS_INVALID;
+
+  uint64_t end = virt + length;
+  while (virt < end) {
+    uint64_t step = HAL_PAGE_SIZE;
+    if ((virt & (HAL_BLOCK_SIZE - 1)) == 0 && end - virt >= HAL_BLOCK_SIZE)
+      step = HAL_BLOCK_SIZE;
+    hal_internal_clear_page_table_entry(virt, step);
+    virt += step;
+  }
+  return HAL_STATUS_OK;
+}
+
+// Page-table work of one batched transaction, without TLB maintenance
+static bool run_memory_op(HardwareTransaction *transaction,
+                          uint64_t *virt, uint64_t *length) {
+  switch (transaction->operation_code) {
+  case HAL_OP_MAP_PAGE:
+  case HAL_OP_MAP_RANGE:
+    *virt = transaction->output_address;
+    *length = transaction->operation_code == HAL_OP_MAP_PAGE
+                  ? HAL_PAGE_SIZE
+                  : transaction->length;
+    transaction->status_code =
+        map_range(*virt, transaction->input_address, *length,
+                  (uint32_t)transaction->input_value);
+    return true;
+  case HAL_OP_UNMAP_PAGE:
+  case HAL_OP_UNMAP_RANGE:
+    *virt = transaction->input_address;
+    *length = transaction->operation_code == HAL_OP_UNMAP_PAGE
+                  ? HAL_PAGE_SIZE
+                  : transaction->length;
+    transaction->status_code = unmap_range(*virt, *length);
+    return true;
+  default:
+    return false;
+  }
+}
+
+void hal_map_memory_page(HardwareContext *context,
+                         HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  // New translations need no TLB maintenance; live mappings are replaced
+  // by unmapping them first (break-before-make)
+  uint64_t length = transaction->operation_code == HAL_OP_MAP_RANGE
+                        ? transaction->length
+                        : HAL_PAGE_SIZE;
+  transaction->status_code =
+      map_range(transaction->output_address, transaction->input_address,
+                length, (uint32_t)transaction->input_value);
+}
+
+void hal_unmap_memory_page(HardwareContext *context,
+                           HardwareTransaction *transaction) {
+  if (validate_hal_params(context, transaction))
+    return;
+
+  uint64_t length = transaction->operation_code == HAL_OP_UNMAP_RANGE
+                        ? transaction->length
+                        : HAL_PAGE_SIZE;
+  transaction->status_code = unmap_range(transaction->input_address, length);
+  if (transaction->status_code == HAL_STATUS_OK)
+    hal_internal_invalidate_tlb_range(transaction->input_address, length);
+}
+
+void hal_submit_batch(HardwareContext *context,
+                      HardwareTransaction *transactions, uint32_t count) {
+  if (!context || !transactions)
+    return;
+
+  uint64_t flush_start = UINT64_MAX;
+  uint64_t flush_end = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    HardwareTransaction *txn = &transactions[i];
+    uint64_t virt, length;
+    if (run_memory_op(txn, &virt, &length)) {
+      bool unmapped = txn->operation_code == HAL_OP_UNMAP_PAGE ||
+                      txn->operation_code == HAL_OP_UNMAP_RANGE;
+      if (!unmapped || txn->status_code != HAL_STATUS_OK)
+        continue;
+      if (virt < flush_start)
+        flush_start = virt;
+      if (virt + length > flush_end)
+        flush_end = virt + length;
+      continue;
+    }
+
+    switch (txn->operation_code) {
+    case HAL_OP_ACK_IRQ:
+      hal_acknowledge_interrupt(context, txn);
+      break;
+    case HAL_OP_MASK_IRQ_LINE:
+      hal_disable_interrupts(context, txn);
+      break;
+    case HAL_OP_UNMASK_IRQ_LINE:
+      hal_enable_interrupts(context, txn);
+      break;
+    case HAL_OP_READ_TIME:
+      hal_read_monotonic_time(context, txn);
+      break;
+    default:
+      txn->status_code = HAL_STATUS_UNSUPPORTED;
+      break;
+    }
+  }
+
+  if (flush_end > flush_start)
+    hal_internal_invalidate_tlb_range(flush_start, flush_end - flush_start);
+}
+
+void hal_internal_set_stack_pointer(uint64_t sp) { (void)sp; }
+
+/**
+ * @brief Calls fn(arg) with the stack pointer moved to stack_top.
+ *
+ * Used to run short-lived kernel work on a shared stack instead of the
+ * stack of whichever thread happened to trap. The previous stack pointer
+ * is kept in a callee-saved register and restored after fn returns.
+ * Host builds have no stack to switch and call fn directly.
+ * @param fn Function to invoke.
+ * @param arg Argument passed to fn.
+ * @param stack_top 16-byte aligned top of the stack to run on.
+ */
+void hal_internal_call_on_stack(void (*fn)(void *), void *arg,
+                                uint64_t stack_top) {
+#ifdef __aarch64__
+  register void (*x_fn)(void *) __asm__("x20") = fn;
+  register void *x_arg __asm__("x21") = arg;
+  register uint64_t x_top __asm__("x22") = stack_top;
+  __asm__ volatile("mov x19, sp\n"
+                   "mov sp, x22\n"
+                   "mov x0, x21\n"
+                   "blr x20\n"
+                   "mov sp, x19\n"
+                   : "+r"(x_fn), "+r"(x_arg), "+r"(x_top)
+                   :
+                   : "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8",
+                     "x9", "x10", "x11", "x12", "x13", "x14", "x15", "x16",
+                     "x17", "x18", "x19", "x30", "v0", "v1", "v2", "v3", "v4",
+                     "v5", "v6", "v7", "v16", "v17", "v18", "v19", "v20",
+                     "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28",
+                     "v29", "v30", "v31", "memory", "cc");
+#else
+  (void)stack_top;
+  fn(arg);
+#endif
+}
+
+void hal_internal_set_cpu_mode(uint32_t mode) { (void)mode; }
+
+uint64_t hal_internal_read_cpu_flags(void) {
+  uint64_t flags = 0;
+  return flags;
+}
+
+void hal_internal_write_cpu_flags(uint64_t flags) { (void)flags; }
+
+void hal_internal_program_timer_hardware(uint64_t ticks) {
+  timer_period_ticks = ticks;
+#if SIMPLEOS_HAL_SIM
+  hal_sim_program_timer(hal_clock_ticks_to_ns(ticks));
+#elif defined(__aarch64__)
+  // Write Time Value
+  __asm__ volatile("msr cntp_tval_el0, %0" : : "r"(ticks));
+  // Enable EL0 physical timer (bit 0 = enable, bit 1 = imask)
+  uint64_t ctl = 1;
+  __asm__ volatile("msr cntp_ctl_el0, %0" : : "r"(ctl));
+#else
+  (void)ticks;
+#endif
+}
+
+void hal_internal_rearm_timer(void) {
+#if !SIMPLEOS_HAL_SIM && defined(__aarch64__)
+  // The physical timer fires once per programming. Advance the compare
+  // value by one period rather than reloading TVAL, so the tick does not
+  // drift by the interrupt latency.
+  if (!timer_period_ticks)
+    return;
+  uint64_t cval;
+  __asm__ volatile("mrs %0, cntp_cval_el0" : "=r"(cval));
+  cval += timer_period_ticks;
+  __asm__ volatile("msr cntp_cval_el0, %0\n isb" : : "r"(cval) : "memory");
+#endif
+  // The simulated timer source is periodic already
+}
+
+void hal_internal_enable_user_counter(void) {
+#if !SIMPLEOS_HAL_SIM && defined(__aarch64__)
+  // CNTKCTL_EL1.EL0VCTEN (bit 1): EL0 reads of CNTVCT_EL0 do not trap
+  uint64_t kctl;
+  __asm__ volatile("mrs %0, cntkctl_el1" : "=r"(kctl));
+  kctl |= 1ull << 1;
+  __asm__ volatile("msr cntkctl_el1, %0\n isb" : : "r"(kctl) : "memory");
+#endif
+}
+
+uint64_t hal_internal_read_timer_hardware_counter(void) {
+  return hal_clock_read_counter();
+}
+
+void hal_internal_program_interrupt_controller(void) {
+#if SIMPLEOS_HAL_SIM
+  hal_sim_reset_controller();
+#else
+  // Skeleton for GIC initialization
+  // In a real implementation, we would use g_hw_context.mmio_base
+  // to configure the GIC Distributor and CPU Interface.
+#endif
+}
+
+void hal_internal_send_end_of_interrupt(uint32_t vector) {
+#if SIMPLEOS_HAL_SIM
+  hal_sim_end_of_interrupt(vector);
+#else
+  // Skeleton for GIC EOI
+  // Would write 'vector' to the GIC CPU Interface EOI register (GICC_EOIR)
+#endif
+}
+
+void hal_internal_mask_interrupt_line(uint32_t line, bool masked) {
+#if SIMPLEOS_HAL_SIM
+  hal_sim_mask_line(line, masked);
+#else
+  // Skeleton for GIC line masking
+  // Would set bit (line % 32) in GICD_ICENABLER(line / 32) to mask, or in
+  // GICD_ISENABLER(line / 32) to unmask.
+#endif
+}
+
+void hal_internal_set_irq_enabled(bool enabled) {
+#if SIMPLEOS_HAL_SIM
+  hal_sim_set_irq_enabled(enabled);
+#else
+  // Skeleton for the CPU interrupt mask
+  // Would clear DAIF.I with "msr daifclr, #2" to enable, or set it with
+  // "msr daifset, #2" to disable.
+#endif
+}
+
+bool hal_internal_irq_save(void) {
+#if SIMPLEOS_HAL_SIM
+  return hal_sim_set_irq_enabled(false);
+#elif defined(__aarch64__)
+  uint64_t daif;
+  __asm__ volatile("mrs %0, daif\n msr daifset, #2" : "=r"(daif)::"memory");
+  return !(daif & (1ull << 7)); // DAIF.I set means IRQs were masked
+#else
+  return false;
+#endif
+}
+
+void hal_internal_irq_restore(bool enabled) {
+  if (!enabled)
+    return;
+#if SIMPLEOS_HAL_SIM
+  hal_sim_set_irq_enabled(true);
+#elif defined(__aarch64__)
+  __asm__ volatile("msr daifclr, #2" ::: "memory");
+#endif
+}
+
+bool hal_internal_start_cpu(uint32_t cpu_id, uint64_t entry,
+                            uint64_t context_id) {
+#if SIMPLEOS_HAL_SIM
+  return hal_sim_start_cpu(cpu_id, (void (*)(uint64_t))(uintptr_t)entry,
+                           context_id) == HAL_SIM_SUCCESS;
+#else
+  // Skeleton for PSCI CPU_ON
+  // Would issue CPU_ON (0xC4000003) through "hvc #0" with x1 = cpu_id.
+  // The firmware starts the CPU with the MMU off, so x2 must be the
+  // physical address of a boot stub that sets up a stack, TPIDR_EL1 and
+  // the MMU before calling entry with context_id in x0. No such stub
+  // exists yet, so secondary CPUs are reported as not started and the
+  // kernel stays on the boot CPU.
+  (void)cpu_id;
+  (void)entry;
+  (void)context_id;
+  return false;
+#endif
+}
+
+void hal_internal_wait_for_interrupt(void) {
+#if SIMPLEOS_HAL_SIM
+  hal_sim_wait_for_interrupt();
+#elif defined(__aarch64__)
+  __asm__ volatile("wfi");
+#endif
+}
+
+void hal_internal_cpu_relax(void) {
+#if SIMPLEOS_HAL_SIM
+  hal_sim_cpu_relax();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
+
+bool hal_internal_init_page_tables(void *pool, uint64_t size) {
+  int ready = pagetable_init(&kernel_page_table, pool, size) ==
+              PAGETABLE_SUCCESS;
+  __atomic_store_n(&page_table_ready, ready, __ATOMIC_RELEASE);
+  return ready;
+}
+
+void hal_internal_defer_page_tables(bool (*init)(void)) {
+  deferred_page_table_init = init;
+}
+
+bool hal_internal_ensure_page_tables(void) {
+  if (__atomic_load_n(&page_table_ready, __ATOMIC_ACQUIRE))
+    return true;
+
+  // Concurrent first users wait for one build instead of racing it
+  while (__atomic_test_and_set(&page_table_init_lock, __ATOMIC_ACQUIRE))
+    ;
+  bool (*init)(void) = deferred_page_table_init;
+  deferred_page_table_init = NULL;
+  if (init && !page_table_ready)
+    init();
+  __atomic_clear(&page_table_init_lock, __ATOMIC_RELEASE);
+  return __atomic_load_n(&page_table_ready, __ATOMIC_ACQUIRE);
+}
+
+bool hal_internal_write_page_table_entry(uint64_t virt, uint64_t phys,
+                                         uint32_t flags) {
+  return hal_internal_ensure_page_tables() &&
+         pagetable_map_page(&kernel_page_table, virt, phys, flags) ==
+             PAGETABLE_SUCCESS;
+}
+
+bool hal_internal_write_block_entry(uint64_t virt, uint64_t phys,
+                                    uint32_t flags) {
+  return hal_internal_ensure_page_tables() &&
+         pagetable_map_block(&kernel_page_table, virt, phys, flags) ==
+             PAGETABLE_SUCCESS;
+}
+
+void hal_internal_clear_page_table_entry(uint64_t virt, uint64_t size) {
+  // Unmapping something that was never mapped is not an error, and
+  // tables that were never built hold no mappings
+  if (__atomic_load_n(&page_table_ready, __ATOMIC_ACQUIRE))
+    pagetable_unmap(&kernel_page_table, virt, size);
+}
+
+bool hal_internal_lookup_page_table_entry(uint64_t virt, uint64_t *phys,
+                                          uint32_t *flags) {
+  return __atomic_load_n(&page_table_ready, __ATOMIC_ACQUIRE) &&
+         pagetable_lookup(&kernel_page_table, virt, phys, flags) ==
+             PAGETABLE_SUCCESS;
+}
+
+uint64_t hal_internal_page_table_root(void) {
+  return hal_internal_ensure_page_tables()
+             ? (uint64_t)(uintptr_t)kernel_page_table.root
+             : 0;
+}
+
+void hal_internal_invalidate_tlb_entry(uint64_t virt) {
+#ifdef __aarch64__
+  __asm__ volatile("dsb ishst\n"
+                   "tlbi vae1is, %0\n"
+                   "dsb ish\n"
+                   "isb\n"
+                   :
+                   : "r"(virt >> 12)
+                   : "memory");
+#else
+  (void)virt;
+#endif
+}
+
+/**
+ * @brief Invalidates every translation in [virt, virt + length).
+ *
+ * One barrier pair covers the whole range. Past HAL_TLB_FLUSH_ALL_PAGES
+ * pages it is cheaper to drop the entire TLB than to walk the range.
+ */
+void hal_internal_invalidate_tlb_range(uint64_t virt, uint64_t length) {
+#ifdef __aarch64__
+  uint64_t pages = (length + HAL_PAGE_SIZE - 1) / HAL_PAGE_SIZE;
+  __asm__ volatile("dsb ishst" ::: "memory");
+  if (pages > HAL_TLB_FLUSH_ALL_PAGES) {
+    __asm__ volatile("tlbi vmalle1is" ::: "memory");
+  } else {
+    for (uint64_t i = 0; i < pages; i++)
+      __asm__ volatile("tlbi vae1is, %0"
+                       :
+                       : "r"((virt >> 12) + i)
+                       : "memory");
+  }
+  __asm__ volatile("dsb ish\n isb" ::: "memory");
+#else
+  (void)virt;
+  (void)length;
+#endif
+}
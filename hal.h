@@ -1,47 +1,73 @@
-#ifndef SIMPLEOS_HAL_H
-#define SIMPLEOS_HAL_H
-
-#include <stdint.h>
-#include <stdbool.h>
-typedef struct {
-    uint32_t cpu_architecture;      // 0=x86_64, 1=ARM64, etc.
-    uint32_t cpu_id;                // Logical CPU ID
-    uint32_t interrupt_controller_type; // Type of PIC/APIC/GIC
-    uint32_t timer_type;            // Type of timer hardware
-    uint64_t boot_info_address;     // Physical address of boot info (e.g. multiboot)
-    uint64_t kernel_memory_base;    // Start of kernel memory
-    uint64_t kernel_memory_limit;   // End of kernel memory
-} HardwareContext;
-typedef struct {
-    uint32_t operation_code;        // Opcode for the transaction
-    uint64_t input_address;         // Generic input pointer/addr
-    uint64_t input_value;           // Generic numeric input
-    uint64_t output_address;        // Result destination address
-    uint32_t status_code;          
-} HardwareTransaction;
-typedef enum {
-    HAL_OP_ENABLE_IRQ       = 1,
-    HAL_OP_DISABLE_IRQ      = 2,
-    HAL_OP_SET_TIMER        = 3,
-    HAL_OP_READ_TIME        = 4,
-    HAL_OP_MAP_PAGE         = 5,
-    HAL_OP_UNMAP_PAGE       = 6,
-    HAL_OP_ACK_IRQ          = 7,
-    HAL_OP_INIT_HARDWARE    = 8
-} kHalOperationCode;
-typedef enum {
-    HAL_STATUS_OK           = 0,
-    HAL_STATUS_INVALID      = 1,
-    HAL_STATUS_UNSUPPORTED  = 2,
-    HAL_STATUS_FAILURE      = 3
-} kHalStatusCode;
-
-void hal_initialize_hardware(HardwareContext* context, HardwareTransaction* transaction);
-void hal_enable_interrupts(HardwareContext* context, HardwareTransaction* transaction);
-void hal_disable_interrupts(HardwareContext* context, HardwareTransaction* transaction);
-void hal_configure_timer_tick(HardwareContext* context, HardwareTransaction* transaction);
-void hal_read_monotonic_time(HardwareContext* context, HardwareTransaction* transaction);
-void hal_acknowledge_interrupt(HardwareContext* context, HardwareTransaction* transaction);
-void hal_map_memory_page(HardwareContext* context, HardwareTransaction* transaction);
-void hal_unmap_memory_page(HardwareContext* context, HardwareTransaction* transaction);
-#endif 
+#ifndef SIMPLEOS_HAL_H
+#define SIMPLEOS_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HAL_MAX_CPUS 4              // Upper bound on logical CPUs
+#define HAL_PAGE_SIZE 4096          // Translation granule
+#define HAL_BLOCK_SIZE (512 * HAL_PAGE_SIZE) // Level-2 block mapping (2 MB)
+#define HAL_TLB_FLUSH_ALL_PAGES 64  // Larger flushes drop the whole TLB
+#define HAL_TIMER_IRQ 30            // Tick interrupt line (EL1 physical timer PPI)
+
+// Page flags for HAL_OP_MAP_PAGE/HAL_OP_MAP_RANGE (passed in input_value)
+#define HAL_PAGE_FLAG_READ  (1u << 0)
+#define HAL_PAGE_FLAG_WRITE (1u << 1)
+#define HAL_PAGE_FLAG_EXEC  (1u << 2)
+#define HAL_PAGE_FLAG_USER  (1u << 3)
+typedef struct {
+    uint32_t cpu_architecture;      // 0=x86_64, 1=ARM64, etc.
+    uint32_t cpu_id;                // Logical CPU ID
+    uint32_t interrupt_controller_type; // Type of PIC/APIC/GIC
+    uint32_t timer_type;            // Type of timer hardware
+    uint64_t boot_info_address;     // Physical address of boot info (e.g. multiboot)
+    uint64_t kernel_memory_base;    // Start of kernel memory
+    uint64_t kernel_memory_limit;   // End of kernel memory
+} HardwareContext;
+typedef struct {
+    uint32_t operation_code;        // Opcode for the transaction
+    uint64_t input_address;         // Generic input pointer/addr
+    uint64_t input_value;           // Generic numeric input
+    uint64_t output_address;        // Result destination address
+    uint64_t output_value;          // Generic numeric result
+    uint32_t status_code;          
+    uint64_t length;                // Byte length of range operations
+} HardwareTransaction;
+typedef enum {
+    HAL_OP_ENABLE_IRQ       = 1,
+    HAL_OP_DISABLE_IRQ      = 2,
+    HAL_OP_SET_TIMER        = 3,    // Tick rate in Hz in input_value
+    HAL_OP_READ_TIME        = 4,    // Monotonic nanoseconds in output_value
+    HAL_OP_MAP_PAGE         = 5,
+    HAL_OP_UNMAP_PAGE       = 6,
+    HAL_OP_ACK_IRQ          = 7,
+    HAL_OP_INIT_HARDWARE    = 8,
+    HAL_OP_MASK_IRQ_LINE    = 9,    // hal_disable_interrupts, line in input_value
+    HAL_OP_UNMASK_IRQ_LINE  = 10,   // hal_enable_interrupts, line in input_value
+    HAL_OP_MAP_RANGE        = 11,   // hal_map_memory_page, length bytes
+    HAL_OP_UNMAP_RANGE      = 12,   // hal_unmap_memory_page, length bytes
+    HAL_OP_START_CPU        = 13    // hal_start_cpu, CPU in input_value,
+                                    // entry in input_address
+} kHalOperationCode;
+typedef enum {
+    HAL_STATUS_OK           = 0,
+    HAL_STATUS_INVALID      = 1,
+    HAL_STATUS_UNSUPPORTED  = 2,
+    HAL_STATUS_FAILURE      = 3
+} kHalStatusCode;
+
+void hal_initialize_hardware(HardwareContext* context, HardwareTransaction* transaction);
+void hal_enable_interrupts(HardwareContext* context, HardwareTransaction* transaction);
+void hal_disable_interrupts(HardwareContext* context, HardwareTransaction* transaction);
+void hal_configure_timer_tick(HardwareContext* context, HardwareTransaction* transaction);
+void hal_read_monotonic_time(HardwareContext* context, HardwareTransaction* transaction);
+void hal_acknowledge_interrupt(HardwareContext* context, HardwareTransaction* transaction);
+void hal_map_memory_page(HardwareContext* context, HardwareTransaction* transaction);
+void hal_unmap_memory_page(HardwareContext* context, HardwareTransaction* transaction);
+// Runs count transactions with one validation pass and one TLB flush
+// covering every mapping they removed. Each transaction gets its own
+// status_code.
+void hal_submit_batch(HardwareContext* context, HardwareTransaction* transactions, uint32_t count);
+// Powers on a secondary CPU at entry, a void (*)(uint64_t cpu_id)
+void hal_start_cpu(HardwareContext* context, HardwareTransaction* transaction);
+#endif 
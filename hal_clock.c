@@ -0,0 +1,114 @@
+#include "hal_clock.h"
+#include <string.h>
+
+static HalClockParams clock_params;
+static int initialized = 0;
+
+#if defined(__x86_64__)
+static uint64_t read_host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/**
+ * @brief Determines the counter frequency in Hz.
+ *
+ * AArch64 reports it in CNTFRQ_EL0. The TSC has no architectural
+ * frequency register, so it is measured against CLOCK_MONOTONIC over
+ * HAL_CLOCK_CALIBRATION_NS.
+ */
+static uint64_t read_counter_frequency(void) {
+#if defined(__aarch64__)
+  uint64_t freq;
+  __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  return freq;
+#elif defined(__x86_64__)
+  uint64_t ns_start = read_host_ns();
+  uint64_t tsc_start = hal_clock_read_counter();
+  uint64_t ns_end;
+  do {
+    ns_end = read_host_ns();
+  } while (ns_end - ns_start < HAL_CLOCK_CALIBRATION_NS);
+  uint64_t ticks = hal_clock_read_counter() - tsc_start;
+  return (uint64_t)(((unsigned __int128)ticks * 1000000000ULL) /
+                    (ns_end - ns_start));
+#else
+  return 1000000000ULL;
+#endif
+}
+
+/**
+ * @brief Picks the most precise mult/shift pair for a counter frequency.
+ *
+ * The product ticks * mult must stay within 64 bits for any delta up to
+ * HAL_CLOCK_MAX_DELTA_S seconds of counter ticks.
+ */
+static int compute_mult_shift(uint64_t freq, uint64_t *mult,
+                              uint32_t *shift) {
+  uint64_t max_delta = freq * HAL_CLOCK_MAX_DELTA_S;
+  for (uint32_t s = 32; s > 0; s--) {
+    uint64_t m = (1000000000ULL << s) / freq;
+    uint64_t product;
+    if (m && !__builtin_mul_overflow(max_delta, m, &product)) {
+      *mult = m;
+      *shift = s;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int hal_clock_init(void) {
+  if (initialized)
+    return 1;
+  return hal_clock_init_with_frequency(read_counter_frequency());
+}
+
+int hal_clock_init_with_frequency(uint64_t freq) {
+  if (initialized)
+    return 1;
+  if (freq == 0)
+    return 0;
+
+  HalClockParams params;
+  memset(&params, 0, sizeof(params));
+  params.frequency = freq;
+  if (!compute_mult_shift(freq, &params.mult, &params.shift))
+    return 0;
+  params.counter_base = hal_clock_read_counter();
+
+  clock_params = params;
+  initialized = 1;
+  return 1;
+}
+
+uint64_t hal_clock_ticks_to_ns(uint64_t ticks) {
+  if (!initialized)
+    hal_clock_init();
+  // 128-bit product: uptime is not bounded by HAL_CLOCK_MAX_DELTA_S
+  return (uint64_t)(((unsigned __int128)ticks * clock_params.mult) >>
+                    clock_params.shift);
+}
+
+uint64_t hal_clock_ns_to_ticks(uint64_t ns) {
+  if (!initialized)
+    hal_clock_init();
+  return (uint64_t)(((unsigned __int128)ns * clock_params.frequency) /
+                    1000000000ULL);
+}
+
+uint64_t hal_clock_read_ns(void) {
+  if (!initialized)
+    hal_clock_init();
+  return hal_clock_ticks_to_ns(hal_clock_read_counter() -
+                               clock_params.counter_base);
+}
+
+void hal_clock_get_params(HalClockParams *params) {
+  if (!initialized)
+    hal_clock_init();
+  if (params)
+    *params = clock_params;
+}
@@ -0,0 +1,55 @@
+#ifndef SIMPLEOS_HAL_CLOCK_H
+#define SIMPLEOS_HAL_CLOCK_H
+
+#include <stdint.h>
+#ifndef __aarch64__
+#include <time.h>
+#endif
+
+// Longest counter delta the 64-bit mult/shift conversion must cover.
+// Readers working in 64 bits (the time page) rebase at least this often.
+#define HAL_CLOCK_MAX_DELTA_S 600
+#define HAL_CLOCK_CALIBRATION_NS 10000000ULL // TSC calibration window
+
+// Counter-to-nanosecond conversion: ns = (ticks * mult) >> shift
+typedef struct {
+  uint64_t frequency;    // Counter ticks per second
+  uint64_t mult;
+  uint32_t shift;
+  uint32_t reserved;
+  uint64_t counter_base; // Counter value at monotonic time zero
+} HalClockParams;
+
+/**
+ * @brief Reads the free-running counter behind the monotonic clock.
+ *
+ * AArch64 reads the virtual counter, which EL0 may read as well. x86-64
+ * hosts read the TSC; other hosts fall back to CLOCK_MONOTONIC, which
+ * already counts nanoseconds.
+ */
+static inline uint64_t hal_clock_read_counter(void) {
+#if defined(__aarch64__)
+  uint64_t cnt;
+  __asm__ volatile("isb\n mrs %0, cntvct_el0" : "=r"(cnt)::"memory");
+  return cnt;
+#elif defined(__x86_64__)
+  uint32_t lo, hi;
+  __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+int hal_clock_init(void);
+// Initializes from a frequency already known, e.g. from a warm-restart
+// snapshot, skipping calibration. No effect once initialized.
+int hal_clock_init_with_frequency(uint64_t frequency);
+uint64_t hal_clock_read_ns(void);
+uint64_t hal_clock_ticks_to_ns(uint64_t ticks);
+uint64_t hal_clock_ns_to_ticks(uint64_t ns);
+void hal_clock_get_params(HalClockParams *params);
+
+#endif // SIMPLEOS_HAL_CLOCK_H
@@ -1,38 +1,66 @@
-#ifndef SIMPLEOS_HAL_INTERNAL_H
-#define SIMPLEOS_HAL_INTERNAL_H
-
-#include "hal.h"
-#include <stdint.h>
-typedef struct {
-  uint64_t x[31]; // General purpose registers x0-x30
-  uint64_t sp;    // Stack pointer
-  uint64_t elr;   // Exception Link Register (PC)
-  uint64_t spsr;  // Saved Program Status Register
-} TrapFrame;
-typedef struct {
-  uint64_t ip;
-  uint64_t sp;
-  uint64_t r12;
-  uint64_t r13;
-  uint64_t r14;
-  uint64_t r15;
-} ThreadFrame;
-typedef struct {
-  uint64_t acpi_rsdp_address;
-  uint64_t mmio_base;
-  uint64_t mmio_size;
-} PlatformDescriptor;
-
-void hal_internal_set_stack_pointer(uint64_t sp);
-void hal_internal_set_cpu_mode(uint32_t mode);
-uint64_t hal_internal_read_cpu_flags(void);
-void hal_internal_write_cpu_flags(uint64_t flags);
-void hal_internal_program_timer_hardware(uint64_t ticks);
-uint64_t hal_internal_read_timer_hardware_counter(void);
-void hal_internal_program_interrupt_controller(void);
-void hal_internal_send_end_of_interrupt(uint32_t vector);
-void hal_internal_write_page_table_entry(uint64_t virt, uint64_t phys,
-                                         uint32_t flags);
-void hal_internal_invalidate_tlb_entry(uint64_t virt);
-
-#endif // SIMPLEOS_HAL_INTERNAL_H
+#ifndef SIMPLEOS_HAL_INTERNAL_H
+#define SIMPLEOS_HAL_INTERNAL_H
+
+#include "hal.h"
+#include <stdint.h>
+typedef struct {
+  uint64_t x[31]; // General purpose registers x0-x30
+  uint64_t sp;    // Stack pointer
+  uint64_t elr;   // Exception Link Register (PC)
+  uint64_t spsr;  // Saved Program Status Register
+} TrapFrame;
+typedef struct {
+  uint64_t ip;
+  uint64_t sp;
+  uint64_t r12;
+  uint64_t r13;
+  uint64_t r14;
+  uint64_t r15;
+} ThreadFrame;
+typedef struct {
+  uint64_t acpi_rsdp_address;
+  uint64_t mmio_base;
+  uint64_t mmio_size;
+} PlatformDescriptor;
+
+void hal_internal_set_stack_pointer(uint64_t sp);
+void hal_internal_call_on_stack(void (*fn)(void *), void *arg,
+                                uint64_t stack_top);
+void hal_internal_set_cpu_mode(uint32_t mode);
+uint64_t hal_internal_read_cpu_flags(void);
+void hal_internal_write_cpu_flags(uint64_t flags);
+void hal_internal_program_timer_hardware(uint64_t ticks);
+void hal_internal_rearm_timer(void); // Next tick, from the timer IRQ
+// Lets EL0 read the virtual counter (time page readers). Per CPU.
+void hal_internal_enable_user_counter(void);
+uint64_t hal_internal_read_timer_hardware_counter(void);
+void hal_internal_program_interrupt_controller(void);
+void hal_internal_send_end_of_interrupt(uint32_t vector);
+void hal_internal_mask_interrupt_line(uint32_t line, bool masked);
+void hal_internal_set_irq_enabled(bool enabled);
+// Masks interrupts and returns whether they were enabled, for locks that
+// interrupt handlers take as well
+bool hal_internal_irq_save(void);
+void hal_internal_irq_restore(bool enabled);
+bool hal_internal_start_cpu(uint32_t cpu_id, uint64_t entry,
+                            uint64_t context_id);
+void hal_internal_wait_for_interrupt(void);
+void hal_internal_cpu_relax(void); // Spin-wait hint
+// Kernel translation tables are built in a pool handed over at boot
+bool hal_internal_init_page_tables(void *pool, uint64_t size);
+// Defers the build to the first mapping or root query. init calls
+// hal_internal_init_page_tables and runs at most once.
+void hal_internal_defer_page_tables(bool (*init)(void));
+bool hal_internal_ensure_page_tables(void);
+bool hal_internal_write_page_table_entry(uint64_t virt, uint64_t phys,
+                                         uint32_t flags);
+bool hal_internal_write_block_entry(uint64_t virt, uint64_t phys,
+                                    uint32_t flags);
+void hal_internal_clear_page_table_entry(uint64_t virt, uint64_t size);
+bool hal_internal_lookup_page_table_entry(uint64_t virt, uint64_t *phys,
+                                          uint32_t *flags);
+uint64_t hal_internal_page_table_root(void); // TTBR0_EL1 value
+void hal_internal_invalidate_tlb_entry(uint64_t virt);
+void hal_internal_invalidate_tlb_range(uint64_t virt, uint64_t length);
+
+#endif // SIMPLEOS_HAL_INTERNAL_H
@@ -0,0 +1,548 @@
+#include "hal_sim.h"
+
+#if SIMPLEOS_HAL_SIM
+
+#include "hal_clock.h"
+#include "traps.h"
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#define TIMER_SOURCE 0 // Slot driven by hal_sim_program_timer
+#define NO_DEADLINE UINT64_MAX
+#define DEFAULT_SEED 0x9E3779B97F4A7C15ULL
+#define LINE_WORDS ((HAL_SIM_IRQ_LINES + 63) / 64)
+
+typedef struct {
+  HalSimSource config;
+  uint64_t deadline; // Simulated time of the next raise
+  uint64_t rng;
+  uint32_t burst_left;
+  int in_use;
+} SourceState;
+
+// Virtual interrupt controller. pending is set by whichever thread raises
+// and cleared by the CPU thread on delivery; the rest is CPU-thread only.
+typedef struct {
+  uint64_t pending[LINE_WORDS];
+  uint64_t masked[LINE_WORDS];
+  uint64_t active[LINE_WORDS];
+  uint64_t raised_at[HAL_SIM_IRQ_LINES];
+} VirtualController;
+
+static SourceState sources[HAL_SIM_MAX_SOURCES];
+static VirtualController vic;
+static HalSimStats stats;
+
+static pthread_mutex_t source_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t source_changed;
+static pthread_t timer_thread;
+static pthread_t cpu_thread;
+static uint32_t sim_mode;
+static uint64_t virtual_now; // Manual mode clock
+static int running = 0;
+static int irq_enabled = 0;  // CPU interrupt mask; clear until the kernel
+                             // enables interrupts, as out of reset
+static int delivering = 0;   // Set while a trap runs, like DAIF.I on entry
+static int frame_starved = 0; // Last delivery found no free trap frame
+static HalSimTraceFn trace_fn = NULL;
+
+static void count(uint64_t *counter, uint64_t value) {
+  __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static int test_bit(const uint64_t *bits, uint32_t line) {
+  return (__atomic_load_n(&bits[line / 64], __ATOMIC_ACQUIRE) >>
+          (line % 64)) & 1;
+}
+
+static void trace(uint32_t event, uint32_t line, uint64_t now,
+                  uint64_t raised_at) {
+  HalSimTraceFn fn = __atomic_load_n(&trace_fn, __ATOMIC_ACQUIRE);
+  if (fn)
+    fn(event, line, now, raised_at);
+}
+
+static void set_bit(uint64_t *bits, uint32_t line, int value) {
+  uint64_t mask = 1ULL << (line % 64);
+  if (value)
+    __atomic_fetch_or(&bits[line / 64], mask, __ATOMIC_RELEASE);
+  else
+    __atomic_fetch_and(&bits[line / 64], ~mask, __ATOMIC_RELEASE);
+}
+
+uint64_t hal_sim_now(void) {
+  if (sim_mode == HAL_SIM_MODE_MANUAL)
+    return __atomic_load_n(&virtual_now, __ATOMIC_ACQUIRE);
+  return hal_clock_read_ns();
+}
+
+// Level-style raise: a line already pending absorbs the new edge
+static void raise_line(uint32_t line, uint64_t when) {
+  uint64_t mask = 1ULL << (line % 64);
+  count(&stats.raised, 1);
+  if (__atomic_load_n(&vic.pending[line / 64], __ATOMIC_ACQUIRE) & mask) {
+    count(&stats.coalesced, 1);
+    trace(HAL_SIM_TRACE_COALESCE, line, when,
+          __atomic_load_n(&vic.raised_at[line], __ATOMIC_RELAXED));
+    return;
+  }
+  __atomic_store_n(&vic.raised_at[line], when, __ATOMIC_RELAXED);
+  __atomic_fetch_or(&vic.pending[line / 64], mask, __ATOMIC_RELEASE);
+  trace(HAL_SIM_TRACE_RAISE, line, when, when);
+}
+
+// Disables delivery around CPU-thread updates, like spin_lock_irqsave
+static int irq_save(void) {
+  return __atomic_exchange_n(&irq_enabled, 0, __ATOMIC_ACQ_REL);
+}
+
+static void irq_restore(int enabled) {
+  __atomic_store_n(&irq_enabled, enabled, __ATOMIC_RELEASE);
+  if (enabled)
+    hal_sim_poll();
+}
+
+static uint64_t next_random(SourceState *s) {
+  // xorshift64*: deterministic for a given seed
+  s->rng ^= s->rng >> 12;
+  s->rng ^= s->rng << 25;
+  s->rng ^= s->rng >> 27;
+  return s->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t next_interval(SourceState *s) {
+  HalSimSource *c = &s->config;
+  switch (c->pattern) {
+  case HAL_SIM_PATTERN_JITTER:
+    return c->period_ns - c->jitter_ns +
+           next_random(s) % (2 * c->jitter_ns + 1);
+  case HAL_SIM_PATTERN_BURST:
+    if (s->burst_left > 1) {
+      s->burst_left--;
+      return c->burst_gap_ns;
+    }
+    s->burst_left = c->burst_count;
+    return c->period_ns;
+  default:
+    return c->period_ns;
+  }
+}
+
+static void arm_source(SourceState *s, const HalSimSource *config,
+                       uint64_t now) {
+  s->config = *config;
+  s->rng = config->seed ? config->seed : DEFAULT_SEED;
+  s->burst_left = config->burst_count;
+  s->in_use = 1;
+  s->deadline = now + next_interval(s);
+}
+
+static int validate_source(const HalSimSource *c) {
+  if (!c || c->line >= HAL_SIM_IRQ_LINES || c->period_ns == 0)
+    return 0;
+  if (c->pattern == HAL_SIM_PATTERN_JITTER && c->jitter_ns >= c->period_ns)
+    return 0;
+  if (c->pattern == HAL_SIM_PATTERN_BURST &&
+      (c->burst_count == 0 || c->burst_gap_ns == 0))
+    return 0;
+  return c->pattern <= HAL_SIM_PATTERN_BURST;
+}
+
+// Caller holds source_lock. Returns the earliest deadline.
+static uint64_t earliest_deadline(int *slot) {
+  uint64_t best = NO_DEADLINE;
+  for (int i = 0; i < HAL_SIM_MAX_SOURCES; i++) {
+    if (sources[i].in_use && sources[i].deadline < best) {
+      best = sources[i].deadline;
+      *slot = i;
+    }
+  }
+  return best;
+}
+
+// Caller holds source_lock. Raises every source due by now.
+static int fire_due_sources(uint64_t now) {
+  int fired = 0;
+  for (int i = 0; i < HAL_SIM_MAX_SOURCES; i++) {
+    SourceState *s = &sources[i];
+    while (s->in_use && s->deadline <= now) {
+      raise_line(s->config.line, s->deadline);
+      s->deadline += next_interval(s);
+      fired = 1;
+    }
+  }
+  return fired;
+}
+
+static void *timer_thread_main(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&source_lock);
+  while (running) {
+    if (fire_due_sources(hal_clock_read_ns()))
+      pthread_kill(cpu_thread, SIGRTMIN);
+
+    int slot;
+    uint64_t next = earliest_deadline(&slot);
+    if (next == NO_DEADLINE) {
+      pthread_cond_wait(&source_changed, &source_lock);
+      continue;
+    }
+    // Deadlines are HAL clock time; the wait is on CLOCK_MONOTONIC
+    uint64_t now = hal_clock_read_ns();
+    uint64_t wait_ns = next > now ? next - now : 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t wake = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec + wait_ns;
+    ts.tv_sec = wake / 1000000000ULL;
+    ts.tv_nsec = wake % 1000000000ULL;
+    pthread_cond_timedwait(&source_changed, &source_lock, &ts);
+  }
+  pthread_mutex_unlock(&source_lock);
+  return NULL;
+}
+
+static void on_interrupt_signal(int sig) {
+  (void)sig;
+  hal_sim_poll();
+}
+
+/**
+ * @brief Runs one interrupt through the trap path on the calling thread.
+ *
+ * The line stays active until the handler's EOI. If no trap frame is
+ * available the line is raised again for a later poll.
+ */
+static int deliver(uint32_t line) {
+  TrapContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.trap_type = TRAP_TYPE_INTERRUPT;
+  ctx.trap_number = line;
+
+  TrapTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  if (capture_trap_state(&ctx, &txn) != TRAP_SUCCESS) {
+    count(&stats.held, 1);
+    frame_starved = 1;
+    set_bit(vic.active, line, 0);
+    set_bit(vic.pending, line, 1);
+    return 0;
+  }
+  dispatch_trap(&ctx, &txn);
+  restore_trap_state_and_return(&ctx, &txn);
+  // The simulated CPU cannot switch host stacks here; drivers of the
+  // clock watch this count and enter the scheduler themselves.
+  if (txn.return_action == TRAP_RETURN_SCHEDULE_NEXT)
+    count(&stats.reschedules, 1);
+  return 1;
+}
+
+static int deliver_pending(void) {
+  int progress = 0;
+  for (uint32_t w = 0; w < LINE_WORDS; w++) {
+    uint64_t ready = __atomic_load_n(&vic.pending[w], __ATOMIC_ACQUIRE) &
+                     ~vic.masked[w] & ~vic.active[w];
+    while (ready) {
+      uint32_t line = w * 64 + (uint32_t)__builtin_ctzll(ready);
+      ready &= ready - 1;
+
+      set_bit(vic.active, line, 1);
+      set_bit(vic.pending, line, 0);
+      uint64_t now = hal_sim_now();
+      uint64_t raised_at =
+          __atomic_load_n(&vic.raised_at[line], __ATOMIC_RELAXED);
+      uint64_t latency = now - raised_at;
+      trace(HAL_SIM_TRACE_DELIVER, line, now, raised_at);
+      count(&stats.delivered, 1);
+      count(&stats.latency_total, latency);
+      if (latency > stats.latency_max)
+        stats.latency_max = latency;
+
+      if (deliver(line)) {
+        trace(HAL_SIM_TRACE_RETURN, line, hal_sim_now(), raised_at);
+        progress = 1;
+      }
+    }
+  }
+  return progress;
+}
+
+void hal_sim_poll(void) {
+  for (;;) {
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE) ||
+        !__atomic_load_n(&irq_enabled, __ATOMIC_ACQUIRE))
+      return;
+    if (__atomic_exchange_n(&delivering, 1, __ATOMIC_ACQ_REL))
+      return; // The outer poll picks it up
+
+    int progress;
+    frame_starved = 0;
+    do {
+      progress = deliver_pending();
+    } while (progress);
+    __atomic_store_n(&delivering, 0, __ATOMIC_RELEASE);
+
+    // A raise landing after the last scan but before the flag dropped
+    // would otherwise wait for the next signal
+    int again = 0;
+    for (uint32_t w = 0; w < LINE_WORDS; w++)
+      if (__atomic_load_n(&vic.pending[w], __ATOMIC_ACQUIRE) &
+          ~vic.masked[w] & ~vic.active[w])
+        again = 1;
+    if (!again || frame_starved)
+      return;
+  }
+}
+
+int hal_sim_start(uint32_t mode) {
+  if (mode > HAL_SIM_MODE_MANUAL || running)
+    return HAL_SIM_ERR_INVALID_PARAM;
+
+  sim_mode = mode;
+  virtual_now = 0;
+  memset(&stats, 0, sizeof(stats));
+  cpu_thread = pthread_self();
+
+  // Sources armed before start (the boot timer) restart from now
+  uint64_t now = hal_sim_now();
+  pthread_mutex_lock(&source_lock);
+  for (int i = 0; i < HAL_SIM_MAX_SOURCES; i++)
+    if (sources[i].in_use)
+      arm_source(&sources[i], &sources[i].config, now);
+  pthread_mutex_unlock(&source_lock);
+
+  __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+  if (mode == HAL_SIM_MODE_MANUAL)
+    return HAL_SIM_SUCCESS;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_interrupt_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGRTMIN, &sa, NULL);
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&source_changed, &attr);
+  pthread_condattr_destroy(&attr);
+  if (pthread_create(&timer_thread, NULL, timer_thread_main, NULL) != 0) {
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    return HAL_SIM_ERR_NOT_RUNNING;
+  }
+  return HAL_SIM_SUCCESS;
+}
+
+void hal_sim_stop(void) {
+  if (!running)
+    return;
+  pthread_mutex_lock(&source_lock);
+  __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&source_lock);
+  if (sim_mode == HAL_SIM_MODE_SIGNAL) {
+    pthread_cond_signal(&source_changed);
+    pthread_join(timer_thread, NULL);
+    signal(SIGRTMIN, SIG_DFL);
+    pthread_cond_destroy(&source_changed);
+  }
+}
+
+static int install_source(int slot, const HalSimSource *source) {
+  int flags = irq_save();
+  pthread_mutex_lock(&source_lock);
+  if (slot < 0) {
+    for (int i = TIMER_SOURCE + 1; i < HAL_SIM_MAX_SOURCES; i++) {
+      if (!sources[i].in_use) {
+        slot = i;
+        break;
+      }
+    }
+  }
+  if (slot >= 0) {
+    if (source)
+      arm_source(&sources[slot], source, hal_sim_now());
+    else
+      sources[slot].in_use = 0;
+    if (running && sim_mode == HAL_SIM_MODE_SIGNAL)
+      pthread_cond_signal(&source_changed);
+  }
+  pthread_mutex_unlock(&source_lock);
+  irq_restore(flags);
+  return slot;
+}
+
+int hal_sim_add_source(const HalSimSource *source) {
+  if (!validate_source(source))
+    return HAL_SIM_ERR_INVALID_PARAM;
+  int slot = install_source(-1, source);
+  return slot < 0 ? HAL_SIM_ERR_NO_SPACE : slot;
+}
+
+int hal_sim_remove_source(int source_id) {
+  if (source_id <= TIMER_SOURCE || source_id >= HAL_SIM_MAX_SOURCES)
+    return HAL_SIM_ERR_INVALID_PARAM;
+  install_source(source_id, NULL);
+  return HAL_SIM_SUCCESS;
+}
+
+int hal_sim_inject(uint32_t line) {
+  if (line >= HAL_SIM_IRQ_LINES)
+    return HAL_SIM_ERR_INVALID_PARAM;
+  if (!running)
+    return HAL_SIM_ERR_NOT_RUNNING;
+  raise_line(line, hal_sim_now());
+  if (pthread_equal(pthread_self(), cpu_thread))
+    hal_sim_poll();
+  else
+    pthread_kill(cpu_thread, SIGRTMIN);
+  return HAL_SIM_SUCCESS;
+}
+
+int hal_sim_advance(uint64_t ns) {
+  if (!running || sim_mode != HAL_SIM_MODE_MANUAL)
+    return HAL_SIM_ERR_NOT_RUNNING;
+
+  uint64_t target = virtual_now + ns;
+  for (;;) {
+    // One source at a time, so deliveries happen in deadline order
+    pthread_mutex_lock(&source_lock);
+    int slot = -1;
+    uint64_t next = earliest_deadline(&slot);
+    if (next > target) {
+      pthread_mutex_unlock(&source_lock);
+      break;
+    }
+    __atomic_store_n(&virtual_now, next, __ATOMIC_RELEASE);
+    SourceState *s = &sources[slot];
+    raise_line(s->config.line, next);
+    s->deadline += next_interval(s);
+    pthread_mutex_unlock(&source_lock);
+    hal_sim_poll();
+  }
+  __atomic_store_n(&virtual_now, target, __ATOMIC_RELEASE);
+  return HAL_SIM_SUCCESS;
+}
+
+uint64_t hal_sim_next_deadline(void) {
+  int slot = -1;
+  pthread_mutex_lock(&source_lock);
+  uint64_t next = earliest_deadline(&slot);
+  pthread_mutex_unlock(&source_lock);
+  return next;
+}
+
+void hal_sim_set_trace(HalSimTraceFn fn) {
+  __atomic_store_n(&trace_fn, fn, __ATOMIC_RELEASE);
+}
+
+void hal_sim_query_stats(HalSimStats *out) {
+  if (!out)
+    return;
+  for (uint32_t i = 0; i < sizeof(stats) / sizeof(uint64_t); i++)
+    ((uint64_t *)out)[i] =
+        __atomic_load_n(&((uint64_t *)&stats)[i], __ATOMIC_RELAXED);
+}
+
+void hal_sim_program_timer(uint64_t period_ns) {
+  if (period_ns == 0) {
+    install_source(TIMER_SOURCE, NULL);
+    return;
+  }
+  HalSimSource timer;
+  memset(&timer, 0, sizeof(timer));
+  timer.line = HAL_TIMER_IRQ;
+  timer.pattern = HAL_SIM_PATTERN_PERIODIC;
+  timer.period_ns = period_ns;
+  install_source(TIMER_SOURCE, &timer);
+}
+
+void hal_sim_reset_controller(void) {
+  int flags = irq_save();
+  memset(&vic, 0, sizeof(vic));
+  irq_restore(flags);
+}
+
+void hal_sim_end_of_interrupt(uint32_t line) {
+  if (line >= HAL_SIM_IRQ_LINES)
+    return;
+  if (!test_bit(vic.active, line)) {
+    count(&stats.spurious_eoi, 1);
+    return;
+  }
+  set_bit(vic.active, line, 0);
+  count(&stats.eoi, 1);
+  hal_sim_poll(); // A line raised while active fires again now
+}
+
+void hal_sim_mask_line(uint32_t line, bool masked) {
+  if (line >= HAL_SIM_IRQ_LINES)
+    return;
+  set_bit(vic.masked, line, masked);
+  if (masked) {
+    if (test_bit(vic.pending, line))
+      count(&stats.held, 1);
+  } else {
+    hal_sim_poll();
+  }
+}
+
+typedef struct {
+  void (*entry)(uint64_t);
+  uint64_t context_id;
+} SecondaryStart;
+
+static SecondaryStart secondary_starts[HAL_MAX_CPUS];
+
+static void *secondary_cpu_main(void *arg) {
+  SecondaryStart *start = (SecondaryStart *)arg;
+  start->entry(start->context_id);
+  return NULL;
+}
+
+int hal_sim_start_cpu(uint32_t cpu_id, void (*entry)(uint64_t),
+                      uint64_t context_id) {
+  if (cpu_id == 0 || cpu_id >= HAL_MAX_CPUS || !entry)
+    return HAL_SIM_ERR_INVALID_PARAM;
+
+  SecondaryStart *start = &secondary_starts[cpu_id];
+  start->entry = entry;
+  start->context_id = context_id;
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  // Secondary CPUs never take the simulated interrupt signal
+  sigset_t blocked, previous;
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGRTMIN);
+  pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+  int res = pthread_create(&thread, &attr, secondary_cpu_main, start);
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+  pthread_attr_destroy(&attr);
+  return res == 0 ? HAL_SIM_SUCCESS : HAL_SIM_ERR_NOT_RUNNING;
+}
+
+void hal_sim_wait_for_interrupt(void) {
+  // Nothing targets secondary CPUs, so a short sleep stands in for WFI
+  struct timespec ts = {0, 1000000};
+  nanosleep(&ts, NULL);
+}
+
+void hal_sim_cpu_relax(void) {
+  // Simulated CPUs may share host cores; let the one being waited on run
+  sched_yield();
+}
+
+bool hal_sim_set_irq_enabled(bool enabled) {
+  if (!enabled)
+    return irq_save();
+  int was = __atomic_load_n(&irq_enabled, __ATOMIC_ACQUIRE);
+  irq_restore(1);
+  return was;
+}
+
+#endif // SIMPLEOS_HAL_SIM
@@ -0,0 +1,106 @@
+#ifndef SIMPLEOS_HAL_SIM_H
+#define SIMPLEOS_HAL_SIM_H
+
+#include "hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Simulated HAL backend for hosts: a virtual interrupt controller fed by
+// a timer thread, delivering interrupts into dispatch_trap. Builds for
+// the target keep the real GIC and generic-timer paths.
+#ifndef SIMPLEOS_HAL_SIM
+#ifdef __aarch64__
+#define SIMPLEOS_HAL_SIM 0
+#else
+#define SIMPLEOS_HAL_SIM 1
+#endif
+#endif
+
+// Status Codes
+#define HAL_SIM_SUCCESS 0
+#define HAL_SIM_ERR_INVALID_PARAM -1
+#define HAL_SIM_ERR_NO_SPACE -2
+#define HAL_SIM_ERR_NOT_RUNNING -4
+
+#define HAL_SIM_IRQ_LINES 224 // Matches TRAP_MAX_IRQS
+#define HAL_SIM_MAX_SOURCES 16
+
+// Delivery modes
+#define HAL_SIM_MODE_SIGNAL 0 // Timer thread interrupts the CPU thread
+#define HAL_SIM_MODE_MANUAL 1 // Caller drives time with hal_sim_advance
+
+// Source patterns
+#define HAL_SIM_PATTERN_PERIODIC 0 // Every period_ns
+#define HAL_SIM_PATTERN_JITTER 1   // period_ns +/- jitter_ns, uniform
+#define HAL_SIM_PATTERN_BURST 2    // burst_count raises burst_gap_ns apart,
+                                   // then period_ns until the next burst
+
+typedef struct {
+  uint32_t line;
+  uint32_t pattern;
+  uint64_t period_ns;
+  uint64_t jitter_ns;
+  uint32_t burst_count;
+  uint32_t reserved;
+  uint64_t burst_gap_ns;
+  uint64_t seed; // Jitter generator seed, 0 picks a fixed default
+} HalSimSource;
+
+typedef struct {
+  uint64_t raised;      // Raises from sources and hal_sim_inject
+  uint64_t delivered;   // Entries into dispatch_trap
+  uint64_t reschedules; // Deliveries that returned TRAP_RETURN_SCHEDULE_NEXT
+  uint64_t coalesced;   // Raises merged into an already pending line
+  uint64_t held;        // Pending lines masked, or no trap frame free
+  uint64_t eoi;
+  uint64_t spurious_eoi; // EOI for a line that was not active
+  uint64_t latency_total; // Raise to delivery, nanoseconds
+  uint64_t latency_max;
+} HalSimStats;
+
+// Controller trace events
+#define HAL_SIM_TRACE_RAISE 0    // Line became pending
+#define HAL_SIM_TRACE_COALESCE 1 // Raise absorbed by a pending line
+#define HAL_SIM_TRACE_DELIVER 2  // Line entered dispatch_trap
+#define HAL_SIM_TRACE_RETURN 3   // Line's trap returned
+
+// Called on the raising or delivering thread. raised_at is the raise a
+// delivery serves, the first of any coalesced ones.
+typedef void (*HalSimTraceFn)(uint32_t event, uint32_t line, uint64_t now,
+                              uint64_t raised_at);
+
+// mode is HAL_SIM_MODE_*. In signal mode the calling thread becomes the
+// simulated CPU; interrupts arrive on it asynchronously, as on hardware.
+int hal_sim_start(uint32_t mode);
+void hal_sim_stop(void);
+// Returns the source id, used to remove it again
+int hal_sim_add_source(const HalSimSource *source);
+int hal_sim_remove_source(int source_id);
+// Raises a line now; delivery follows on the CPU thread
+int hal_sim_inject(uint32_t line);
+// Manual mode: moves simulated time forward, delivering in time order.
+// The kernel's monotonic clock then reads simulated time as well.
+int hal_sim_advance(uint64_t ns);
+uint64_t hal_sim_now(void);
+// Manual mode: simulated time of the next source raise, UINT64_MAX if none
+uint64_t hal_sim_next_deadline(void);
+// NULL turns tracing off
+void hal_sim_set_trace(HalSimTraceFn fn);
+// Delivers whatever is pending and deliverable on the calling thread
+void hal_sim_poll(void);
+void hal_sim_query_stats(HalSimStats *stats);
+
+// Backend for the hal_internal_* interrupt and timer hooks
+void hal_sim_program_timer(uint64_t period_ns);
+void hal_sim_reset_controller(void);
+void hal_sim_end_of_interrupt(uint32_t line);
+void hal_sim_mask_line(uint32_t line, bool masked);
+// Returns whether interrupts were enabled before the call
+bool hal_sim_set_irq_enabled(bool enabled);
+// Secondary CPUs are host threads; interrupts only target the CPU thread
+int hal_sim_start_cpu(uint32_t cpu_id, void (*entry)(uint64_t),
+                      uint64_t context_id);
+void hal_sim_wait_for_interrupt(void);
+void hal_sim_cpu_relax(void);
+
+#endif // SIMPLEOS_HAL_SIM_H
@@ -0,0 +1,34 @@
+#ifndef SIMPLEOS_INIT_ONCE_H
+#define SIMPLEOS_INIT_ONCE_H
+
+#include "hal_internal.h"
+
+// One-time setup of module state that any CPU may touch first. The caller
+// that wins init_once_begin does the work and calls init_once_end; the
+// others wait for it, so nobody sees a half-built table.
+#define INIT_ONCE_PENDING 0
+#define INIT_ONCE_RUNNING 1
+#define INIT_ONCE_DONE 2
+
+static inline int init_once_done(int *state) {
+  return __atomic_load_n(state, __ATOMIC_ACQUIRE) == INIT_ONCE_DONE;
+}
+
+// Returns 1 when the caller must run the setup
+static inline int init_once_begin(int *state) {
+  if (init_once_done(state))
+    return 0;
+  int expected = INIT_ONCE_PENDING;
+  if (__atomic_compare_exchange_n(state, &expected, INIT_ONCE_RUNNING, 0,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    return 1;
+  while (!init_once_done(state))
+    hal_internal_cpu_relax();
+  return 0;
+}
+
+static inline void init_once_end(int *state) {
+  __atomic_store_n(state, INIT_ONCE_DONE, __ATOMIC_RELEASE);
+}
+
+#endif // SIMPLEOS_INIT_ONCE_H
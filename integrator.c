@@ -1,205 +1,595 @@
-#include "integrator.h"
-#include "hal.h"
-#include "integrator_internal.h"
-#include "ipc.h"
-#include "threads.h"
-#include <stddef.h>
-
-static SubsystemRegistry g_registry;
-static RoutingTable g_routing_table;
-
-/**
- * @brief Prepares a HardwareContext from the IntegratorContext.
- *
- * Initializes all relevant fields of the HardwareContext structure
- * using values from the IntegratorContext to ensure safe HAL operations.
- * @param hal_ctx Pointer to the HardwareContext to initialize.
- * @param integ_ctx Pointer to the source IntegratorContext.
- */
-static void prepare_hardware_context(HardwareContext *hal_ctx,
-                                     IntegratorContext *integ_ctx) {
-  if (!hal_ctx)
-    return;
-  hal_ctx->cpu_architecture = integ_ctx ? integ_ctx->cpu_architecture : 0;
-  hal_ctx->cpu_id = 0;                    // Primary CPU
-  hal_ctx->interrupt_controller_type = 0; // Default/GIC
-  hal_ctx->timer_type = 0;                // Default timer
-  hal_ctx->boot_info_address = integ_ctx ? integ_ctx->boot_info_address : 0;
-  hal_ctx->kernel_memory_base = integ_ctx ? integ_ctx->kernel_memory_base : 0;
-  hal_ctx->kernel_memory_limit = integ_ctx ? integ_ctx->kernel_memory_limit : 0;
-}
-
-void integrator_initialize_hardware_layer(IntegratorContext *context,
-                                          IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_HAL_INIT;
-
-  if (!integrator_internal_validate_boot_environment(context)) {
-    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
-    transaction->failure_reason_code = INTEGRATOR_FAIL_HAL; // broad category
-    return;
-  }
-
-  HardwareContext hal_ctx;
-  hal_ctx.cpu_architecture = context->cpu_architecture;
-  hal_ctx.boot_info_address = context->boot_info_address;
-
-  HardwareTransaction hal_txn;
-  hal_txn.operation_code = HAL_OP_INIT_HARDWARE;
-
-  hal_initialize_hardware(&hal_ctx, &hal_txn);
-
-  if (hal_txn.status_code != HAL_STATUS_OK) {
-    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
-    transaction->failure_reason_code = INTEGRATOR_FAIL_HAL;
-    return;
-  }
-
-  g_registry.hal_instance = (void *)1;
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_initialize_trap_routing(IntegratorContext *context,
-                                        IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_TRAP_INIT;
-
-  g_registry.trap_instance = (void *)1;
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_initialize_thread_subsystem(
-    IntegratorContext *context, IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_THREAD_INIT;
-
-  g_registry.thread_instance = (void *)1;
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_initialize_ipc_subsystem(IntegratorContext *context,
-                                         IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_IPC_INIT;
-
-  g_registry.ipc_instance = (void *)1;
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_initialize_syscall_dispatching(
-    IntegratorContext *context, IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_SYSCALL_INIT;
-
-  g_registry.syscall_instance = (void *)1;
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_wire_microkernel_dependencies(
-    IntegratorContext *context, IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_WIRING;
-
-  integrator_internal_bind_ipc_to_thread_ports();
-  integrator_internal_bind_thread_to_hal_ports();
-  integrator_internal_bind_trap_to_hal_ports();
-  integrator_internal_bind_trap_to_syscall_entry();
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_activate_interrupts_and_timer_tick(
-    IntegratorContext *context, IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  transaction->current_phase = INTEGRATOR_PHASE_ACTIVATION;
-
-  HardwareContext hal_ctx;
-  HardwareTransaction hal_txn;
-
-  // Initialize HardwareContext from IntegratorContext
-  prepare_hardware_context(&hal_ctx, context);
-
-  hal_txn.operation_code = HAL_OP_SET_TIMER;
-  hal_txn.input_value = 1000; // 1000Hz ticks
-  hal_txn.input_address = 0;
-  hal_txn.output_address = 0;
-  hal_txn.status_code = HAL_STATUS_OK;
-  hal_configure_timer_tick(&hal_ctx, &hal_txn);
-
-  hal_txn.operation_code = HAL_OP_ENABLE_IRQ;
-  hal_enable_interrupts(&hal_ctx, &hal_txn);
-
-  transaction->status_code = INTEGRATOR_STATUS_OK;
-}
-
-void integrator_launch_initial_system_thread(
-    IntegratorContext *context, IntegratorTransaction *transaction) {
-  if (!context || !transaction)
-    return;
-
-  ThreadDescriptor t_ctx;
-  t_ctx.thread_id = context->initial_thread_id;
-  t_ctx.owner_agent_id = context->initial_agent_id;
-
-  ThreadTransaction t_txn;
-  t_txn.action = THREAD_ACTION_CREATE;
-
-  create_thread(&t_ctx, &t_txn);
-
-  integrator_internal_set_kernel_phase_ready(transaction);
-}
-
-bool integrator_internal_validate_boot_environment(IntegratorContext *ctx) {
-  if (!ctx)
-    return false;
-  if (ctx->kernel_memory_limit <= ctx->kernel_memory_base)
-    return false;
-  return true;
-}
-
-void integrator_internal_allocate_kernel_internal_memory(
-    IntegratorContext *ctx) {
-  // Stub
-}
-
-void integrator_internal_bind_ipc_to_thread_ports(void) {
-  // Stub: IPC module -> Thread module
-}
-
-void integrator_internal_bind_thread_to_hal_ports(void) {
-  // Stub: Thread module -> HAL context save/restore
-}
-
-void integrator_internal_bind_trap_to_hal_ports(void) {
-  // Stub: Trap module -> HAL ack/mask
-}
-
-void integrator_internal_bind_trap_to_syscall_entry(void) {
-  // Stub: Trap vector -> Syscall handler
-}
-
-void integrator_internal_set_kernel_phase_ready(IntegratorTransaction *txn) {
-  if (txn) {
-    txn->current_phase = INTEGRATOR_PHASE_READY;
-    txn->status_code = INTEGRATOR_STATUS_OK;
-  }
-}
+#include "integrator.h"
+#include "frames.h"
+#include "hal.h"
+#include "hal_clock.h"
+#include "hal_internal.h"
+#include "integrator_internal.h"
+#include "ipc.h"
+#include "percpu.h"
+#include "snapshot.h"
+#include "stack_pool.h"
+#include "syscalls.h"
+#include "threads.h"
+#include "timepage.h"
+#include "traps.h"
+#include "workqueue.h"
+#include <stddef.h>
+#include <string.h>
+
+static SubsystemRegistry g_registry;
+static RoutingTable g_routing_table;
+
+#define KERNEL_TABLE_POOL_ORDER 6 // 64 pages of translation tables
+
+// Boot graph node flags
+#define BOOT_NODE_ANY_CPU 0x1    // May run on a secondary CPU
+#define BOOT_NODE_DEFERRABLE 0x2 // Has a first-use trigger
+
+typedef void (*IntegratorPhaseFn)(IntegratorContext *context,
+                                  IntegratorTransaction *transaction);
+
+typedef struct {
+  uint32_t phase;      // kIntegratorPhase
+  uint32_t depends_on; // INTEGRATOR_PHASE_BIT of each prerequisite
+  uint32_t flags;      // BOOT_NODE_*
+  IntegratorPhaseFn run;
+} BootNode;
+
+#define PHASE_BIT(name) INTEGRATOR_PHASE_BIT(INTEGRATOR_PHASE_##name)
+
+// HAL init is the root and always runs first on the boot CPU. Anything
+// that programs per-CPU state (vectors, IRQs, the init thread's home)
+// stays on the boot CPU.
+static const BootNode boot_graph[] = {
+    {INTEGRATOR_PHASE_HAL_INIT, 0, 0, integrator_initialize_hardware_layer},
+    {INTEGRATOR_PHASE_PAGE_TABLES, PHASE_BIT(HAL_INIT),
+     BOOT_NODE_ANY_CPU | BOOT_NODE_DEFERRABLE,
+     integrator_initialize_page_tables},
+    {INTEGRATOR_PHASE_TRAP_INIT, PHASE_BIT(HAL_INIT), BOOT_NODE_ANY_CPU,
+     integrator_initialize_trap_routing},
+    {INTEGRATOR_PHASE_THREAD_INIT, PHASE_BIT(HAL_INIT), BOOT_NODE_ANY_CPU,
+     integrator_initialize_thread_subsystem},
+    {INTEGRATOR_PHASE_IPC_INIT, PHASE_BIT(HAL_INIT), BOOT_NODE_ANY_CPU,
+     integrator_initialize_ipc_subsystem},
+    {INTEGRATOR_PHASE_SYSCALL_INIT, PHASE_BIT(HAL_INIT), BOOT_NODE_ANY_CPU,
+     integrator_initialize_syscall_dispatching},
+    {INTEGRATOR_PHASE_WIRING,
+     PHASE_BIT(TRAP_INIT) | PHASE_BIT(THREAD_INIT) | PHASE_BIT(IPC_INIT) |
+         PHASE_BIT(SYSCALL_INIT),
+     0, integrator_wire_microkernel_dependencies},
+    {INTEGRATOR_PHASE_ACTIVATION, PHASE_BIT(WIRING) | PHASE_BIT(PAGE_TABLES),
+     0, integrator_activate_interrupts_and_timer_tick},
+    // After activation, so threads the kernel starts itself exist first
+    {INTEGRATOR_PHASE_RESTORE, PHASE_BIT(ACTIVATION), 0,
+     integrator_restore_snapshot},
+    {INTEGRATOR_PHASE_READY, PHASE_BIT(ACTIVATION) | PHASE_BIT(RESTORE), 0,
+     integrator_launch_initial_system_thread},
+};
+
+#define BOOT_NODE_COUNT (sizeof(boot_graph) / sizeof(boot_graph[0]))
+
+// Shared by every CPU taking part in integrator_boot
+typedef struct {
+  IntegratorContext *context;
+  uint32_t pending; // Phases this boot runs
+  uint32_t claimed; // Phases a CPU has taken
+  uint32_t done;    // Finished phases, plus deferred ones for ordering
+  uint32_t failed;
+  uint32_t active;
+  uint32_t failed_phase;
+  uint32_t failure_reason_code;
+  uint64_t phase_ticks[INTEGRATOR_PHASE_COUNT];
+  uint32_t phase_cpu[INTEGRATOR_PHASE_COUNT];
+} BootGraphState;
+
+static BootGraphState g_boot;
+static IntegratorTransaction g_boot_report;
+static uint32_t g_started_cpus = 1; // Bit per CPU, the boot CPU included
+
+/**
+ * @brief Prepares a HardwareContext from the IntegratorContext.
+ *
+ * Initializes all relevant fields of the HardwareContext structure
+ * using values from the IntegratorContext to ensure safe HAL operations.
+ * @param hal_ctx Pointer to the HardwareContext to initialize.
+ * @param integ_ctx Pointer to the source IntegratorContext.
+ */
+static void prepare_hardware_context(HardwareContext *hal_ctx,
+                                     IntegratorContext *integ_ctx) {
+  if (!hal_ctx)
+    return;
+  hal_ctx->cpu_architecture = integ_ctx ? integ_ctx->cpu_architecture : 0;
+  hal_ctx->cpu_id = percpu_cpu_id();
+  hal_ctx->interrupt_controller_type = 0; // Default/GIC
+  hal_ctx->timer_type = 0;                // Default timer
+  hal_ctx->boot_info_address = integ_ctx ? integ_ctx->boot_info_address : 0;
+  hal_ctx->kernel_memory_base = integ_ctx ? integ_ctx->kernel_memory_base : 0;
+  hal_ctx->kernel_memory_limit = integ_ctx ? integ_ctx->kernel_memory_limit : 0;
+}
+
+void integrator_initialize_hardware_layer(IntegratorContext *context,
+                                          IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_HAL_INIT;
+
+  if (!integrator_internal_validate_boot_environment(context)) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_HAL; // broad category
+    return;
+  }
+
+  // The boot CPU is CPU 0; bind it before anything reads per-CPU data
+  HardwareContext hal_ctx;
+  prepare_hardware_context(&hal_ctx, context);
+  percpu_init_cpu(0, &hal_ctx);
+
+  HardwareTransaction hal_txn;
+  hal_txn.operation_code = HAL_OP_INIT_HARDWARE;
+
+  hal_initialize_hardware(&hal_ctx, &hal_txn);
+
+  if (hal_txn.status_code != HAL_STATUS_OK ||
+      !integrator_internal_allocate_kernel_internal_memory(context)) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_HAL;
+    return;
+  }
+
+  g_registry.hal_instance = (void *)1;
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_initialize_page_tables(IntegratorContext *context,
+                                       IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_PAGE_TABLES;
+
+  // Builds now unless a first mapping already did
+  if (!hal_internal_ensure_page_tables()) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_HAL;
+    return;
+  }
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_restore_snapshot(IntegratorContext *context,
+                                 IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_RESTORE;
+
+  if (snapshot_restore((const void *)(uintptr_t)context->snapshot_region_base,
+                       context->snapshot_region_size) != SNAPSHOT_SUCCESS) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_RESTORE;
+    return;
+  }
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_initialize_trap_routing(IntegratorContext *context,
+                                        IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_TRAP_INIT;
+
+  g_registry.trap_instance = (void *)1;
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_initialize_thread_subsystem(
+    IntegratorContext *context, IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_THREAD_INIT;
+
+  uint64_t stack_region;
+  if (frames_alloc_exact(STACK_POOL_REGION_SIZE, &stack_region) !=
+      FRAMES_SUCCESS) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_THREAD;
+    return;
+  }
+
+  HardwareContext hal_ctx;
+  prepare_hardware_context(&hal_ctx, context);
+  if (stack_pool_init(&hal_ctx, stack_region, STACK_POOL_REGION_SIZE) !=
+      STACK_POOL_SUCCESS) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_THREAD;
+    return;
+  }
+
+  g_registry.thread_instance = (void *)1;
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_initialize_ipc_subsystem(IntegratorContext *context,
+                                         IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_IPC_INIT;
+
+  g_registry.ipc_instance = (void *)1;
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_initialize_syscall_dispatching(
+    IntegratorContext *context, IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_SYSCALL_INIT;
+
+  // Subsystem handlers registered so far move into the routing table
+  syscall_install_table(g_routing_table.syscall_handlers);
+
+  g_registry.syscall_instance = (void *)1;
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_wire_microkernel_dependencies(
+    IntegratorContext *context, IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_WIRING;
+
+  integrator_internal_bind_ipc_to_thread_ports();
+  integrator_internal_bind_thread_to_hal_ports();
+  integrator_internal_bind_trap_to_hal_ports(context);
+  integrator_internal_bind_trap_to_syscall_entry();
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_activate_interrupts_and_timer_tick(
+    IntegratorContext *context, IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  transaction->current_phase = INTEGRATOR_PHASE_ACTIVATION;
+
+  HardwareContext hal_ctx;
+  HardwareTransaction hal_txn;
+
+  // Initialize HardwareContext from IntegratorContext
+  prepare_hardware_context(&hal_ctx, context);
+
+  hal_txn.operation_code = HAL_OP_SET_TIMER;
+  hal_txn.input_value = 1000; // 1000Hz ticks
+  hal_txn.input_address = 0;
+  hal_txn.output_address = 0;
+  hal_txn.status_code = HAL_STATUS_OK;
+  hal_configure_timer_tick(&hal_ctx, &hal_txn);
+
+  // Agents read time from the shared page; the tick keeps it fresh
+  if (timepage_init(&hal_ctx) != TIMEPAGE_SUCCESS) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_HAL;
+    return;
+  }
+
+  // Bottom halves must be able to run before the first IRQ arrives
+  if (workqueue_start(hal_ctx.cpu_id, WORKQUEUE_DEFAULT_PRIORITY) !=
+      WORKQUEUE_SUCCESS) {
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = INTEGRATOR_FAIL_WIRING;
+    return;
+  }
+
+  hal_txn.operation_code = HAL_OP_ENABLE_IRQ;
+  hal_enable_interrupts(&hal_ctx, &hal_txn);
+
+  // A CPU that fails to start leaves the system running on fewer cores
+  integrator_internal_start_secondary_cpus(context);
+
+  transaction->status_code = INTEGRATOR_STATUS_OK;
+}
+
+void integrator_launch_initial_system_thread(
+    IntegratorContext *context, IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  ThreadDescriptor t_ctx;
+  memset(&t_ctx, 0, sizeof(t_ctx)); // stack_base NULL: use the stack pool
+  t_ctx.thread_id = context->initial_thread_id;
+  t_ctx.owner_agent_id = context->initial_agent_id;
+
+  ThreadTransaction t_txn;
+  t_txn.action = THREAD_ACTION_CREATE;
+
+  // After a warm boot the init thread may be restored already, in which
+  // case create_thread leaves it alone
+
+  create_thread(&t_ctx, &t_txn);
+
+  integrator_internal_set_kernel_phase_ready(transaction);
+}
+
+bool integrator_internal_validate_boot_environment(IntegratorContext *ctx) {
+  if (!ctx)
+    return false;
+  if (ctx->kernel_memory_limit <= ctx->kernel_memory_base)
+    return false;
+  return true;
+}
+
+/**
+ * @brief First-use trigger for the page-table phase.
+ *
+ * Called by the HAL, under its build lock, from the first mapping. The
+ * build is charged to the page-table phase in the boot report only when
+ * the phase was deferred; otherwise the phase itself is being timed.
+ */
+static bool build_deferred_page_tables(void) {
+  uint32_t bit = INTEGRATOR_PHASE_BIT(INTEGRATOR_PHASE_PAGE_TABLES);
+  uint64_t start = hal_clock_read_counter();
+  bool built = integrator_internal_build_kernel_page_tables();
+  if (built && (g_boot_report.deferred_phases & bit)) {
+    g_boot_report.phase_duration_ns[INTEGRATOR_PHASE_PAGE_TABLES] =
+        hal_clock_ticks_to_ns(hal_clock_read_counter() - start);
+    g_boot_report.phase_cpu[INTEGRATOR_PHASE_PAGE_TABLES] = percpu_cpu_id();
+    g_boot_report.deferred_phases &= ~bit;
+    g_boot_report.completed_phases |= bit;
+  }
+  return built;
+}
+
+bool integrator_internal_allocate_kernel_internal_memory(
+    IntegratorContext *ctx) {
+  // Everything after this point draws kernel memory from the frame allocator
+  if (frames_init(ctx->kernel_memory_base, ctx->kernel_memory_limit) !=
+      FRAMES_SUCCESS)
+    return false;
+
+  // The page-table phase builds them; until it runs, the first mapping does
+  hal_internal_defer_page_tables(build_deferred_page_tables);
+  return true;
+}
+
+bool integrator_internal_build_kernel_page_tables(void) {
+  uint64_t table_pool;
+  if (frames_alloc(KERNEL_TABLE_POOL_ORDER, &table_pool) != FRAMES_SUCCESS)
+    return false;
+  return hal_internal_init_page_tables(
+      (void *)(uintptr_t)table_pool,
+      (uint64_t)HAL_PAGE_SIZE << KERNEL_TABLE_POOL_ORDER);
+}
+
+static void run_boot_node(const BootNode *node) {
+  IntegratorTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+
+  uint64_t start = hal_clock_read_counter();
+  node->run(g_boot.context, &txn);
+  g_boot.phase_ticks[node->phase] = hal_clock_read_counter() - start;
+  g_boot.phase_cpu[node->phase] = percpu_cpu_id();
+
+  if (txn.status_code != INTEGRATOR_STATUS_OK &&
+      !__atomic_exchange_n(&g_boot.failed, 1, __ATOMIC_ACQ_REL)) {
+    g_boot.failed_phase = node->phase;
+    g_boot.failure_reason_code = txn.failure_reason_code;
+  }
+  __atomic_fetch_or(&g_boot.done, INTEGRATOR_PHASE_BIT(node->phase),
+                    __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Takes and runs boot phases until none are left or one failed.
+ *
+ * Every participating CPU runs this loop; a phase is claimed with one
+ * atomic OR, so each runs exactly once.
+ * @param boot_cpu Whether phases restricted to the boot CPU may be taken.
+ */
+static void run_boot_graph(bool boot_cpu) {
+  for (;;) {
+    uint32_t done = __atomic_load_n(&g_boot.done, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&g_boot.failed, __ATOMIC_ACQUIRE) ||
+        (done & g_boot.pending) == g_boot.pending)
+      return;
+
+    const BootNode *next = NULL;
+    for (uint32_t i = 0; i < BOOT_NODE_COUNT && !next; i++) {
+      const BootNode *node = &boot_graph[i];
+      uint32_t bit = INTEGRATOR_PHASE_BIT(node->phase);
+      if (!(g_boot.pending & bit) ||
+          (__atomic_load_n(&g_boot.claimed, __ATOMIC_ACQUIRE) & bit) ||
+          (!boot_cpu && !(node->flags & BOOT_NODE_ANY_CPU)) ||
+          (node->depends_on & done) != node->depends_on)
+        continue;
+      if (!(__atomic_fetch_or(&g_boot.claimed, bit, __ATOMIC_ACQ_REL) & bit))
+        next = node;
+    }
+    if (next)
+      run_boot_node(next);
+    else
+      hal_internal_cpu_relax();
+  }
+}
+
+void integrator_boot(IntegratorContext *context,
+                     IntegratorTransaction *transaction) {
+  if (!context || !transaction)
+    return;
+
+  uint64_t boot_start = hal_clock_read_counter();
+
+  // A valid snapshot makes this a warm boot. Its clock calibration is
+  // reused before HAL init would measure the counter again.
+  SnapshotHeader snapshot;
+  uint32_t warm = context->snapshot_region_base &&
+                  snapshot_inspect(
+                      (const void *)(uintptr_t)context->snapshot_region_base,
+                      context->snapshot_region_size,
+                      &snapshot) == SNAPSHOT_SUCCESS;
+  if (warm)
+    hal_clock_init_with_frequency(snapshot.counter_frequency);
+
+  memset(&g_boot, 0, sizeof(g_boot));
+  memset(&g_boot_report, 0, sizeof(g_boot_report));
+  g_boot.context = context;
+  for (uint32_t i = 0; i < BOOT_NODE_COUNT; i++) {
+    uint32_t bit = INTEGRATOR_PHASE_BIT(boot_graph[i].phase);
+    if (boot_graph[i].phase == INTEGRATOR_PHASE_RESTORE && !warm)
+      g_boot.done |= bit; // Nothing to restore on a cold boot
+    else if ((boot_graph[i].flags & BOOT_NODE_DEFERRABLE) &&
+             (context->deferred_phases & bit))
+      g_boot_report.deferred_phases |= bit; // Run on first use
+    else
+      g_boot.pending |= bit;
+  }
+  // Deferred phases count as done for ordering
+  g_boot.done |= g_boot_report.deferred_phases;
+
+  // The root brings up memory and per-CPU data; secondaries need both
+  g_boot.claimed = INTEGRATOR_PHASE_BIT(INTEGRATOR_PHASE_HAL_INIT);
+  run_boot_node(&boot_graph[0]);
+  if (!g_boot.failed) {
+    __atomic_store_n(&g_boot.active, 1, __ATOMIC_RELEASE);
+    integrator_internal_start_secondary_cpus(context);
+    run_boot_graph(true);
+  }
+
+  // After a failure, let phases already running on secondaries finish
+  while ((__atomic_load_n(&g_boot.done, __ATOMIC_ACQUIRE) & g_boot.claimed) !=
+         g_boot.claimed)
+    hal_internal_cpu_relax();
+  __atomic_store_n(&g_boot.active, 0, __ATOMIC_RELEASE);
+
+  transaction->warm_boot = warm;
+  transaction->completed_phases = g_boot.done & g_boot.pending;
+  for (uint32_t phase = 0; phase < INTEGRATOR_PHASE_COUNT; phase++) {
+    if (!(transaction->completed_phases & INTEGRATOR_PHASE_BIT(phase)))
+      continue;
+    transaction->phase_duration_ns[phase] =
+        hal_clock_ticks_to_ns(g_boot.phase_ticks[phase]);
+    transaction->phase_cpu[phase] = g_boot.phase_cpu[phase];
+  }
+
+  if (g_boot.failed) {
+    transaction->current_phase = g_boot.failed_phase;
+    transaction->status_code = INTEGRATOR_STATUS_FAILURE;
+    transaction->failure_reason_code = g_boot.failure_reason_code;
+  } else {
+    integrator_internal_set_kernel_phase_ready(transaction);
+    transaction->failure_reason_code = INTEGRATOR_FAIL_NONE;
+  }
+  // Conversion may calibrate the clock, so the total is taken last
+  transaction->total_duration_ns =
+      hal_clock_ticks_to_ns(hal_clock_read_counter() - boot_start);
+
+  // A deferred phase may already have been triggered during boot
+  for (uint32_t phase = 0; phase < INTEGRATOR_PHASE_COUNT; phase++) {
+    if (!(g_boot_report.completed_phases & INTEGRATOR_PHASE_BIT(phase)))
+      continue;
+    transaction->completed_phases |= INTEGRATOR_PHASE_BIT(phase);
+    transaction->phase_duration_ns[phase] =
+        g_boot_report.phase_duration_ns[phase];
+    transaction->phase_cpu[phase] = g_boot_report.phase_cpu[phase];
+  }
+  transaction->deferred_phases = g_boot_report.deferred_phases;
+  g_boot_report = *transaction;
+}
+
+void integrator_query_boot_report(IntegratorTransaction *report) {
+  if (report)
+    *report = g_boot_report;
+}
+
+int integrator_checkpoint(IntegratorContext *context) {
+  if (!context || !context->snapshot_region_base)
+    return SNAPSHOT_ERR_INVALID_PARAM;
+  return snapshot_save((void *)(uintptr_t)context->snapshot_region_base,
+                       context->snapshot_region_size, NULL);
+}
+
+/**
+ * @brief First C code on a secondary CPU.
+ *
+ * Binds the CPU to its per-CPU block and helps with any boot phases
+ * still outstanding, then idles in the scheduler. Only threads created
+ * on this CPU are queued here.
+ * @param cpu_id Logical CPU id, passed through the HAL as context id.
+ */
+static void secondary_cpu_entry(uint64_t cpu_id) {
+  percpu_init_cpu((uint32_t)cpu_id, &percpu_get(0)->hw_context);
+  hal_internal_enable_user_counter();
+  // Top halves queue work on the CPU they ran on; its worker is homed
+  // here, as threads stay on the CPU that created them
+  workqueue_start((uint32_t)cpu_id, WORKQUEUE_DEFAULT_PRIORITY);
+  if (__atomic_load_n(&g_boot.active, __ATOMIC_ACQUIRE))
+    run_boot_graph(false);
+  for (;;) {
+    if (__atomic_load_n(&percpu_this()->ready_count, __ATOMIC_ACQUIRE))
+      thread_schedule();
+    hal_internal_wait_for_interrupt();
+  }
+}
+
+uint32_t integrator_internal_start_secondary_cpus(IntegratorContext *ctx) {
+  uint32_t count = ctx->cpu_count < HAL_MAX_CPUS ? ctx->cpu_count
+                                                 : HAL_MAX_CPUS;
+  uint32_t started = 0;
+
+  HardwareContext hal_ctx;
+  prepare_hardware_context(&hal_ctx, ctx);
+  for (uint32_t cpu = 1; cpu < count; cpu++) {
+    if (g_started_cpus & (1u << cpu))
+      continue;
+    HardwareTransaction hal_txn;
+    memset(&hal_txn, 0, sizeof(hal_txn));
+    hal_txn.operation_code = HAL_OP_START_CPU;
+    hal_txn.input_value = cpu;
+    hal_txn.input_address = (uint64_t)(uintptr_t)secondary_cpu_entry;
+    hal_start_cpu(&hal_ctx, &hal_txn);
+    if (hal_txn.status_code == HAL_STATUS_OK) {
+      g_started_cpus |= 1u << cpu;
+      started++;
+    }
+  }
+  return started;
+}
+
+void integrator_internal_bind_ipc_to_thread_ports(void) {
+  // Stub: IPC module -> Thread module
+}
+
+void integrator_internal_bind_thread_to_hal_ports(void) {
+  // Stub: Thread module -> HAL context save/restore
+}
+
+void integrator_internal_bind_trap_to_hal_ports(IntegratorContext *ctx) {
+  // Trap module -> HAL ack/mask, and trap vectors -> routing table
+  HardwareContext hal_ctx;
+  prepare_hardware_context(&hal_ctx, ctx);
+  trap_install_vector_table(g_routing_table.trap_handlers, &hal_ctx);
+}
+
+void integrator_internal_bind_trap_to_syscall_entry(void) {
+  // Stub: Trap vector -> Syscall handler
+}
+
+void integrator_internal_set_kernel_phase_ready(IntegratorTransaction *txn) {
+  if (txn) {
+    txn->current_phase = INTEGRATOR_PHASE_READY;
+    txn->status_code = INTEGRATOR_STATUS_OK;
+  }
+}
@@ -1,67 +1,98 @@
-#ifndef INTEGRATOR_H
-#define INTEGRATOR_H
-
-#include <stdbool.h>
-#include <stdint.h>
-
-typedef struct {
-  uint64_t boot_info_address;   // Physical address of boot info
-  uint32_t cpu_architecture;    // 0=x86_64, 1=ARM64, etc.
-  uint32_t cpu_count;           // Number of detected CPUs
-  uint64_t kernel_memory_base;  // Start of kernel memory
-  uint64_t kernel_memory_limit; // End of kernel memory
-  uint32_t initial_agent_id;    // ID for the init process/agent
-  uint32_t initial_thread_id;   // ID for the init thread
-} IntegratorContext;
-
-typedef enum {
-  INTEGRATOR_PHASE_HAL_INIT = 1,
-  INTEGRATOR_PHASE_TRAP_INIT = 2,
-  INTEGRATOR_PHASE_THREAD_INIT = 3,
-  INTEGRATOR_PHASE_IPC_INIT = 4,
-  INTEGRATOR_PHASE_SYSCALL_INIT = 5,
-  INTEGRATOR_PHASE_WIRING = 6,
-  INTEGRATOR_PHASE_ACTIVATION = 7,
-  INTEGRATOR_PHASE_READY = 8
-} kIntegratorPhase;
-
-typedef enum {
-  INTEGRATOR_STATUS_OK = 0,
-  INTEGRATOR_STATUS_FAILURE = 1
-} kIntegratorStatusCode;
-
-typedef enum {
-  INTEGRATOR_FAIL_NONE = 0,
-  INTEGRATOR_FAIL_HAL = 1,
-  INTEGRATOR_FAIL_TRAP = 2,
-  INTEGRATOR_FAIL_THREAD = 3,
-  INTEGRATOR_FAIL_IPC = 4,
-  INTEGRATOR_FAIL_SYSCALL = 5,
-  INTEGRATOR_FAIL_WIRING = 6
-} kIntegratorFailureCode;
-
-typedef struct {
-  uint32_t current_phase;       // kIntegratorPhase
-  uint32_t status_code;         // kIntegratorStatusCode
-  uint32_t failure_reason_code; // kIntegratorFailureCode
-} IntegratorTransaction;
-
-void integrator_initialize_hardware_layer(IntegratorContext *context,
-                                          IntegratorTransaction *transaction);
-void integrator_initialize_trap_routing(IntegratorContext *context,
-                                        IntegratorTransaction *transaction);
-void integrator_initialize_thread_subsystem(IntegratorContext *context,
-                                            IntegratorTransaction *transaction);
-void integrator_initialize_ipc_subsystem(IntegratorContext *context,
-                                         IntegratorTransaction *transaction);
-void integrator_initialize_syscall_dispatching(
-    IntegratorContext *context, IntegratorTransaction *transaction);
-void integrator_wire_microkernel_dependencies(
-    IntegratorContext *context, IntegratorTransaction *transaction);
-void integrator_activate_interrupts_and_timer_tick(
-    IntegratorContext *context, IntegratorTransaction *transaction);
-void integrator_launch_initial_system_thread(
-    IntegratorContext *context, IntegratorTransaction *transaction);
-void integrator_internal_set_kernel_phase_ready(IntegratorTransaction *txn);
-
-#endif // INTEGRATOR_H
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  uint64_t boot_info_address;   // Physical address of boot info
+  uint32_t cpu_architecture;    // 0=x86_64, 1=ARM64, etc.
+  uint32_t cpu_count;           // Number of detected CPUs
+  uint64_t kernel_memory_base;  // Start of kernel memory
+  uint64_t kernel_memory_limit; // End of kernel memory
+  uint32_t initial_agent_id;    // ID for the init process/agent
+  uint32_t initial_thread_id;   // ID for the init thread
+  uint32_t deferred_phases;     // INTEGRATOR_PHASE_BIT set to run on first
+                                // use; only deferrable phases honour it
+  uint64_t snapshot_region_base; // Retained across warm resets, 0 = none
+  uint64_t snapshot_region_size;
+} IntegratorContext;
+
+typedef enum {
+  INTEGRATOR_PHASE_HAL_INIT = 1,
+  INTEGRATOR_PHASE_TRAP_INIT = 2,
+  INTEGRATOR_PHASE_THREAD_INIT = 3,
+  INTEGRATOR_PHASE_IPC_INIT = 4,
+  INTEGRATOR_PHASE_SYSCALL_INIT = 5,
+  INTEGRATOR_PHASE_WIRING = 6,
+  INTEGRATOR_PHASE_ACTIVATION = 7,
+  INTEGRATOR_PHASE_READY = 8,
+  INTEGRATOR_PHASE_PAGE_TABLES = 9, // Kernel translation tables, deferrable
+  INTEGRATOR_PHASE_RESTORE = 10     // Warm boot only: replay the snapshot
+} kIntegratorPhase;
+
+#define INTEGRATOR_PHASE_COUNT 11 // Indexable by kIntegratorPhase
+#define INTEGRATOR_PHASE_BIT(phase) (1u << (phase))
+
+typedef enum {
+  INTEGRATOR_STATUS_OK = 0,
+  INTEGRATOR_STATUS_FAILURE = 1
+} kIntegratorStatusCode;
+
+typedef enum {
+  INTEGRATOR_FAIL_NONE = 0,
+  INTEGRATOR_FAIL_HAL = 1,
+  INTEGRATOR_FAIL_TRAP = 2,
+  INTEGRATOR_FAIL_THREAD = 3,
+  INTEGRATOR_FAIL_IPC = 4,
+  INTEGRATOR_FAIL_SYSCALL = 5,
+  INTEGRATOR_FAIL_WIRING = 6,
+  INTEGRATOR_FAIL_RESTORE = 7
+} kIntegratorFailureCode;
+
+typedef struct {
+  uint32_t current_phase;       // kIntegratorPhase
+  uint32_t status_code;         // kIntegratorStatusCode
+  uint32_t failure_reason_code; // kIntegratorFailureCode
+  // Boot report, filled by integrator_boot
+  uint32_t warm_boot;        // 1 when state was restored from a snapshot
+  uint32_t completed_phases; // INTEGRATOR_PHASE_BIT per finished phase
+  uint32_t deferred_phases;  // Phases still waiting for their first use
+  uint64_t total_duration_ns;
+  uint64_t phase_duration_ns[INTEGRATOR_PHASE_COUNT];
+  uint32_t phase_cpu[INTEGRATOR_PHASE_COUNT]; // CPU that ran each phase
+} IntegratorTransaction;
+
+void integrator_initialize_hardware_layer(IntegratorContext *context,
+                                          IntegratorTransaction *transaction);
+void integrator_initialize_page_tables(IntegratorContext *context,
+                                       IntegratorTransaction *transaction);
+void integrator_restore_snapshot(IntegratorContext *context,
+                                 IntegratorTransaction *transaction);
+void integrator_initialize_trap_routing(IntegratorContext *context,
+                                        IntegratorTransaction *transaction);
+void integrator_initialize_thread_subsystem(IntegratorContext *context,
+                                            IntegratorTransaction *transaction);
+void integrator_initialize_ipc_subsystem(IntegratorContext *context,
+                                         IntegratorTransaction *transaction);
+void integrator_initialize_syscall_dispatching(
+    IntegratorContext *context, IntegratorTransaction *transaction);
+void integrator_wire_microkernel_dependencies(
+    IntegratorContext *context, IntegratorTransaction *transaction);
+void integrator_activate_interrupts_and_timer_tick(
+    IntegratorContext *context, IntegratorTransaction *transaction);
+void integrator_launch_initial_system_thread(
+    IntegratorContext *context, IntegratorTransaction *transaction);
+void integrator_internal_set_kernel_phase_ready(IntegratorTransaction *txn);
+
+// Runs every phase in dependency order. Phases with no ordering between
+// them run concurrently on the secondary CPUs started after HAL init.
+void integrator_boot(IntegratorContext *context,
+                     IntegratorTransaction *transaction);
+// Latest boot report, including deferred phases that have since run
+void integrator_query_boot_report(IntegratorTransaction *report);
+// Saves channels, threads and agent configuration into the snapshot
+// region for the next warm boot. Returns a SNAPSHOT_* code.
+int integrator_checkpoint(IntegratorContext *context);
+
+#endif // INTEGRATOR_H
@@ -1,274 +1,364 @@
-#include "ipc.h"
-#include <stdlib.h>
-#include <string.h>
-
-typedef struct MessageNode {
-  MessageEnvelope envelope;
-  void *internal_payload_copy;
-  struct MessageNode *next;
-} MessageNode;
-
-typedef struct {
-  ChannelDescriptor descriptor;
-  MessageNode *head;
-  MessageNode *tail;
-  uint32_t current_count;
-  int is_active;
-} Channel;
-
-#define MAX_CHANNELS 1024
-static Channel channel_table[MAX_CHANNELS];
-static int initialized = 0;
-
-static void ensure_initialized() {
-  // TODO: This initialization pattern is not thread-safe.
-  // In a multi-threaded environment, use atomic operations or locking.
-  if (!initialized) {
-    memset(channel_table, 0, sizeof(channel_table));
-    initialized = 1;
-  }
-}
-
-static Channel *ipc_lookup_channel(uint32_t channel_id) {
-  if (channel_id >= MAX_CHANNELS)
-    return NULL;
-  if (!channel_table[channel_id].is_active)
-    return NULL;
-  return &channel_table[channel_id];
-}
-
-static int ipc_validate_sender_permissions(Channel *chan, uint32_t src_id) {
-  // permissions == 0 means public channel (any agent allowed)
-  // permissions == owner_agent_id means only owner can access
-  // permissions == specific_id means only that specific agent can access
-  if (chan->descriptor.permissions == 0) {
-    return 1; // Public channel - allow all
-  }
-  if (chan->descriptor.owner_agent_id == src_id) {
-    return 1; // Owner always has access
-  }
-  if (chan->descriptor.permissions == src_id) {
-    return 1; // Explicitly permitted agent
-  }
-  return 0; // Access denied
-}
-
-static int ipc_validate_message_size(Channel *chan, uint32_t len) {
-  return len <= chan->descriptor.max_message_size;
-}
-
-static int ipc_queue_is_full(Channel *chan) {
-  return chan->current_count >= chan->descriptor.max_messages;
-}
-
-static int ipc_queue_is_empty(Channel *chan) {
-  return chan->current_count == 0;
-}
-
-/**
- * @brief Releases memory associated with a message node.
- *
- * Frees the internal payload copy (if any) and the node itself.
- * @param node Pointer to the MessageNode to release. Can be NULL.
- */
-static void release_message_node(MessageNode *node) {
-  if (!node)
-    return;
-  if (node->internal_payload_copy) {
-    free(node->internal_payload_copy);
-    node->internal_payload_copy = NULL;
-  }
-  free(node);
-}
-
-static int ipc_queue_push(Channel *chan, MessageEnvelope *txn) {
-  MessageNode *node = (MessageNode *)malloc(sizeof(MessageNode));
-  if (!node)
-    return IPC_ERR_OUT_OF_MEMORY;
-
-  node->envelope = *txn;
-  node->next = NULL;
-
-  if (txn->payload && txn->payload_len > 0) {
-    node->internal_payload_copy = malloc(txn->payload_len);
-    if (!node->internal_payload_copy) {
-      free(node);
-      return IPC_ERR_OUT_OF_MEMORY;
-    }
-    memcpy(node->internal_payload_copy, txn->payload, txn->payload_len);
-    node->envelope.payload = node->internal_payload_copy;
-  } else {
-    node->internal_payload_copy = NULL;
-    node->envelope.payload = NULL;
-  }
-
-  if (chan->tail) {
-    chan->tail->next = node;
-  } else {
-    chan->head = node;
-  }
-  chan->tail = node;
-  chan->current_count++;
-  return IPC_SUCCESS;
-}
-
-static int ipc_queue_pop(Channel *chan, MessageEnvelope *txn_out) {
-  if (ipc_queue_is_empty(chan))
-    return IPC_ERR_CHANNEL_EMPTY;
-
-  MessageNode *node = chan->head;
-  *txn_out = node->envelope;
-
-  chan->head = node->next;
-  if (chan->head == NULL) {
-    chan->tail = NULL;
-  }
-  chan->current_count--;
-
-  // Release the node memory after extracting the envelope
-  release_message_node(node);
-
-  return IPC_SUCCESS;
-}
-
-int ipc_channel_create(ChannelDescriptor *ctx, MessageEnvelope *txn) {
-  ensure_initialized();
-
-  if (!ctx)
-    return IPC_ERR_INVALID_PARAM;
-  if (ctx->channel_id >= MAX_CHANNELS)
-    return IPC_ERR_INVALID_PARAM;
-  if (channel_table[ctx->channel_id].is_active)
-    return IPC_ERR_PERMISSION_DENIED;
-  Channel *chan = &channel_table[ctx->channel_id];
-  chan->descriptor = *ctx;
-  chan->head = NULL;
-  chan->tail = NULL;
-  chan->current_count = 0;
-  chan->is_active = 1;
-
-  return IPC_SUCCESS;
-}
-
-int ipc_channel_close(ChannelDescriptor *ctx, MessageEnvelope *txn) {
-  ensure_initialized();
-  if (!ctx)
-    return IPC_ERR_INVALID_PARAM;
-
-  Channel *chan = ipc_lookup_channel(ctx->channel_id);
-  if (!chan)
-    return IPC_ERR_CHANNEL_NOT_FOUND;
-
-  if (chan->descriptor.owner_agent_id != txn->dst_agent_id) {
-    return IPC_ERR_PERMISSION_DENIED;
-  }
-  MessageNode *cur = chan->head;
-  while (cur) {
-    MessageNode *next = cur->next;
-    if (cur->internal_payload_copy)
-      free(cur->internal_payload_copy);
-    free(cur);
-    cur = next;
-  }
-
-  chan->head = NULL;
-  chan->tail = NULL;
-  chan->current_count = 0;
-  chan->is_active = 0;
-
-  return IPC_SUCCESS;
-}
-
-int ipc_send(ChannelDescriptor *ctx, MessageEnvelope *txn) {
-  ensure_initialized();
-  if (!ctx || !txn)
-    return IPC_ERR_INVALID_PARAM;
-
-  Channel *chan = ipc_lookup_channel(ctx->channel_id);
-  if (!chan)
-    return IPC_ERR_CHANNEL_NOT_FOUND;
-
-  if (!ipc_validate_sender_permissions(chan, txn->dst_agent_id)) {
-    return IPC_ERR_PERMISSION_DENIED;
-  }
-  if (!ipc_validate_message_size(chan, txn->payload_len)) {
-    return IPC_ERR_PAYLOAD_TOO_LARGE;
-  }
-
-  if (ipc_queue_is_full(chan)) {
-    if (chan->descriptor.delivery_mode == IPC_DELIVERY_DROP) {
-      return IPC_ERR_CHANNEL_FULL;
-    } else {
-      // TODO: Blocking mode requires integration with thread subsystem.
-      // Should call block_thread() and wait for queue space to become
-      // available. For now, return error to avoid indefinite block.
-      return IPC_ERR_CHANNEL_FULL;
-    }
-  }
-
-  return ipc_queue_push(chan, txn);
-}
-
-int ipc_recv(ChannelDescriptor *ctx, MessageEnvelope *txn) {
-  ensure_initialized();
-  if (!ctx || !txn)
-    return IPC_ERR_INVALID_PARAM;
-
-  Channel *chan = ipc_lookup_channel(ctx->channel_id);
-  if (!chan)
-    return IPC_ERR_CHANNEL_NOT_FOUND;
-
-  if (ipc_queue_is_empty(chan)) {
-    if (txn->flags & IPC_MSG_FLAG_NON_BLOCKING) {
-      return IPC_ERR_CHANNEL_EMPTY;
-    } else {
-      // TODO: Blocking mode requires integration with thread subsystem.
-      // Should call block_thread() and wait for message arrival.
-      // For now, return error to avoid indefinite block.
-      return IPC_ERR_CHANNEL_EMPTY;
-    }
-  }
-
-  MessageNode *node = chan->head;
-
-  void *user_buf = txn->payload;
-  uint32_t user_buf_len = txn->payload_len;
-
-  *txn = node->envelope;
-
-  if (user_buf && user_buf_len > 0 && node->internal_payload_copy) {
-    uint32_t copy_len = (node->envelope.payload_len < user_buf_len)
-                            ? node->envelope.payload_len
-                            : user_buf_len;
-    memcpy(user_buf, node->internal_payload_copy, copy_len);
-    txn->payload = user_buf;
-    txn->payload_len = copy_len;
-  } else {
-  }
-
-  chan->head = node->next;
-  if (!chan->head)
-    chan->tail = NULL;
-  chan->current_count--;
-
-  if (node->internal_payload_copy)
-    free(node->internal_payload_copy);
-  free(node);
-
-  return IPC_SUCCESS;
-}
-
-int ipc_call(ChannelDescriptor *ctx, MessageEnvelope *txn) {
-  int res = ipc_send(ctx, txn);
-  if (res != IPC_SUCCESS)
-    return res;
-
-  // TODO: Synchronous call should block waiting for a reply message.
-  // This requires:
-  // 1. Setting IPC_MSG_FLAG_REPLY_REQUIRED on the sent message
-  // 2. Blocking the calling thread via block_thread()
-  // 3. Receiving the reply when woken up
-  // For now, only the send portion is implemented.
-
-  return IPC_SUCCESS;
-}
+#include "ipc.h"
+#include "agents.h"
+#include "events.h"
+#include "hal_internal.h"
+#include "slab.h"
+#include <string.h>
+
+typedef struct MessageNode {
+  MessageEnvelope envelope;
+  void *internal_payload_copy;
+  struct MessageNode *next;
+  uint32_t charged_agent_id; // Sender charged for the node and payload
+} MessageNode;
+
+typedef struct {
+  ChannelDescriptor descriptor;
+  MessageNode *head;
+  MessageNode *tail;
+  uint32_t current_count;
+  int is_active;
+} Channel;
+
+#define MAX_CHANNELS IPC_MAX_CHANNELS
+static Channel channel_table[MAX_CHANNELS];
+static SlabCache message_cache;
+static int initialized = 0;
+// Guards channel_table and every queue: senders, receivers and the event
+// dispatcher may run on different CPUs. IRQ forwarding sends from
+// interrupt context, so the lock is held with interrupts masked.
+static int channel_lock = 0;
+
+static bool lock_channels(void) {
+  bool irq = hal_internal_irq_save();
+  while (__atomic_test_and_set(&channel_lock, __ATOMIC_ACQUIRE))
+    hal_internal_cpu_relax();
+  return irq;
+}
+
+static void unlock_channels(bool irq) {
+  __atomic_clear(&channel_lock, __ATOMIC_RELEASE);
+  hal_internal_irq_restore(irq);
+}
+
+static void ensure_initialized() {
+  // TODO: This initialization pattern is not thread-safe.
+  // In a multi-threaded environment, use atomic operations or locking.
+  if (!initialized) {
+    memset(channel_table, 0, sizeof(channel_table));
+    slab_cache_init(&message_cache, "ipc-message", sizeof(MessageNode));
+    initialized = 1;
+  }
+}
+
+static Channel *ipc_lookup_channel(uint32_t channel_id) {
+  if (channel_id >= MAX_CHANNELS)
+    return NULL;
+  if (!channel_table[channel_id].is_active)
+    return NULL;
+  return &channel_table[channel_id];
+}
+
+static int ipc_validate_sender_permissions(Channel *chan, uint32_t src_id) {
+  // permissions == 0 means public channel (any agent allowed)
+  // permissions == owner_agent_id means only owner can access
+  // permissions == specific_id means only that specific agent can access
+  if (chan->descriptor.permissions == 0) {
+    return 1; // Public channel - allow all
+  }
+  if (chan->descriptor.owner_agent_id == src_id) {
+    return 1; // Owner always has access
+  }
+  if (chan->descriptor.permissions == src_id) {
+    return 1; // Explicitly permitted agent
+  }
+  return 0; // Access denied
+}
+
+static int ipc_validate_message_size(Channel *chan, uint32_t len) {
+  return len <= chan->descriptor.max_message_size;
+}
+
+static int ipc_queue_is_full(Channel *chan) {
+  return chan->current_count >= chan->descriptor.max_messages;
+}
+
+static int ipc_queue_is_empty(Channel *chan) {
+  return chan->current_count == 0;
+}
+
+/**
+ * @brief Releases memory associated with a message node.
+ *
+ * Returns the internal payload copy (if any) and the node itself to their
+ * slab caches. The payload size class comes from the queued envelope.
+ * @param node Pointer to the MessageNode to release. Can be NULL.
+ */
+static void release_message_node(MessageNode *node) {
+  if (!node)
+    return;
+  uint64_t charge = sizeof(MessageNode);
+  if (node->internal_payload_copy) {
+    slab_free_bytes(node->internal_payload_copy, node->envelope.payload_len);
+    node->internal_payload_copy = NULL;
+    charge += node->envelope.payload_len;
+  }
+  agent_release_memory(node->charged_agent_id, charge);
+  slab_free(&message_cache, node);
+}
+
+static int ipc_queue_push(Channel *chan, MessageEnvelope *txn) {
+  // Queued messages count against the sender's quota until received
+  uint32_t sender = txn->dst_agent_id;
+  uint64_t payload_len = txn->payload ? txn->payload_len : 0;
+  if (agent_charge_memory(sender, sizeof(MessageNode) + payload_len) !=
+      AGENT_SUCCESS)
+    return IPC_ERR_OUT_OF_MEMORY;
+
+  MessageNode *node;
+  if (slab_alloc(&message_cache, (void **)&node) != SLAB_SUCCESS) {
+    agent_release_memory(sender, sizeof(MessageNode) + payload_len);
+    return IPC_ERR_OUT_OF_MEMORY;
+  }
+
+  node->envelope = *txn;
+  node->next = NULL;
+  node->charged_agent_id = sender;
+
+  if (payload_len > 0) {
+    if (slab_alloc_bytes(txn->payload_len, &node->internal_payload_copy) !=
+        SLAB_SUCCESS) {
+      agent_release_memory(sender, sizeof(MessageNode) + payload_len);
+      slab_free(&message_cache, node);
+      return IPC_ERR_OUT_OF_MEMORY;
+    }
+    memcpy(node->internal_payload_copy, txn->payload, txn->payload_len);
+    node->envelope.payload = node->internal_payload_copy;
+  } else {
+    node->internal_payload_copy = NULL;
+    node->envelope.payload = NULL;
+  }
+
+  if (chan->tail) {
+    chan->tail->next = node;
+  } else {
+    chan->head = node;
+  }
+  chan->tail = node;
+  chan->current_count++;
+  return IPC_SUCCESS;
+}
+
+// Unlinks the oldest message. The payload is copied into the buffer the
+// caller passed in txn_out, if any, before the node is released.
+static int ipc_queue_pop(Channel *chan, MessageEnvelope *txn_out) {
+  if (ipc_queue_is_empty(chan))
+    return IPC_ERR_CHANNEL_EMPTY;
+
+  MessageNode *node = chan->head;
+  void *user_buf = txn_out->payload;
+  uint32_t user_buf_len = txn_out->payload_len;
+  *txn_out = node->envelope;
+
+  if (user_buf && user_buf_len > 0 && node->internal_payload_copy) {
+    uint32_t copy_len = (node->envelope.payload_len < user_buf_len)
+                            ? node->envelope.payload_len
+                            : user_buf_len;
+    memcpy(user_buf, node->internal_payload_copy, copy_len);
+    txn_out->payload = user_buf;
+    txn_out->payload_len = copy_len;
+  }
+
+  chan->head = node->next;
+  if (chan->head == NULL) {
+    chan->tail = NULL;
+  }
+  chan->current_count--;
+
+  // Release the node memory after extracting the envelope
+  release_message_node(node);
+
+  return IPC_SUCCESS;
+}
+
+// Caller holds the channel lock
+static int channel_create_locked(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+
+  if (!ctx)
+    return IPC_ERR_INVALID_PARAM;
+  if (ctx->channel_id >= MAX_CHANNELS)
+    return IPC_ERR_INVALID_PARAM;
+  if (channel_table[ctx->channel_id].is_active)
+    return IPC_ERR_PERMISSION_DENIED;
+  Channel *chan = &channel_table[ctx->channel_id];
+  chan->descriptor = *ctx;
+  chan->head = NULL;
+  chan->tail = NULL;
+  chan->current_count = 0;
+  chan->is_active = 1;
+
+  return IPC_SUCCESS;
+}
+
+// Caller holds the channel lock
+static int channel_close_locked(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  if (!ctx)
+    return IPC_ERR_INVALID_PARAM;
+
+  Channel *chan = ipc_lookup_channel(ctx->channel_id);
+  if (!chan)
+    return IPC_ERR_CHANNEL_NOT_FOUND;
+
+  if (chan->descriptor.owner_agent_id != txn->dst_agent_id) {
+    return IPC_ERR_PERMISSION_DENIED;
+  }
+  MessageNode *cur = chan->head;
+  while (cur) {
+    MessageNode *next = cur->next;
+    release_message_node(cur);
+    cur = next;
+  }
+
+  chan->head = NULL;
+  chan->tail = NULL;
+  chan->current_count = 0;
+  chan->is_active = 0;
+
+  return IPC_SUCCESS;
+}
+
+// Caller holds the channel lock
+static int send_locked(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  if (!ctx || !txn)
+    return IPC_ERR_INVALID_PARAM;
+
+  Channel *chan = ipc_lookup_channel(ctx->channel_id);
+  if (!chan)
+    return IPC_ERR_CHANNEL_NOT_FOUND;
+
+  if (!ipc_validate_sender_permissions(chan, txn->dst_agent_id)) {
+    return IPC_ERR_PERMISSION_DENIED;
+  }
+  if (!ipc_validate_message_size(chan, txn->payload_len)) {
+    return IPC_ERR_PAYLOAD_TOO_LARGE;
+  }
+
+  if (ipc_queue_is_full(chan)) {
+    if (chan->descriptor.delivery_mode == IPC_DELIVERY_DROP) {
+      return IPC_ERR_CHANNEL_FULL;
+    } else {
+      // TODO: Blocking mode requires integration with thread subsystem.
+      // Should call block_thread() and wait for queue space to become
+      // available. For now, return error to avoid indefinite block.
+      return IPC_ERR_CHANNEL_FULL;
+    }
+  }
+
+  int res = ipc_queue_push(chan, txn);
+  if (res == IPC_SUCCESS)
+    event_notify_channel(ctx->channel_id);
+  return res;
+}
+
+// Caller holds the channel lock
+static int recv_locked(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  if (!ctx || !txn)
+    return IPC_ERR_INVALID_PARAM;
+
+  Channel *chan = ipc_lookup_channel(ctx->channel_id);
+  if (!chan)
+    return IPC_ERR_CHANNEL_NOT_FOUND;
+
+  if (ipc_queue_is_empty(chan)) {
+    if (txn->flags & IPC_MSG_FLAG_NON_BLOCKING) {
+      return IPC_ERR_CHANNEL_EMPTY;
+    } else {
+      // TODO: Blocking mode requires integration with thread subsystem.
+      // Should call block_thread() and wait for message arrival.
+      // For now, return error to avoid indefinite block.
+      return IPC_ERR_CHANNEL_EMPTY;
+    }
+  }
+
+  return ipc_queue_pop(chan, txn);
+}
+
+int ipc_channel_create(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  ensure_initialized();
+  bool irq = lock_channels();
+  int res = channel_create_locked(ctx, txn);
+  unlock_channels(irq);
+  return res;
+}
+
+int ipc_channel_close(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  ensure_initialized();
+  bool irq = lock_channels();
+  int res = channel_close_locked(ctx, txn);
+  unlock_channels(irq);
+  return res;
+}
+
+int ipc_send(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  ensure_initialized();
+  bool irq = lock_channels();
+  int res = send_locked(ctx, txn);
+  unlock_channels(irq);
+  return res;
+}
+
+int ipc_recv(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  ensure_initialized();
+  bool irq = lock_channels();
+  int res = recv_locked(ctx, txn);
+  unlock_channels(irq);
+  return res;
+}
+
+int ipc_call(ChannelDescriptor *ctx, MessageEnvelope *txn) {
+  int res = ipc_send(ctx, txn);
+  if (res != IPC_SUCCESS)
+    return res;
+
+  // TODO: Synchronous call should block waiting for a reply message.
+  // This requires:
+  // 1. Setting IPC_MSG_FLAG_REPLY_REQUIRED on the sent message
+  // 2. Blocking the calling thread via block_thread()
+  // 3. Receiving the reply when woken up
+  // For now, only the send portion is implemented.
+
+  return IPC_SUCCESS;
+}
+
+int ipc_channel_check_owner(uint32_t channel_id, uint32_t agent_id) {
+  ensure_initialized();
+  bool irq = lock_channels();
+  Channel *chan = ipc_lookup_channel(channel_id);
+  int res = IPC_SUCCESS;
+  if (!chan)
+    res = IPC_ERR_CHANNEL_NOT_FOUND;
+  else if (chan->descriptor.owner_agent_id != agent_id)
+    res = IPC_ERR_PERMISSION_DENIED;
+  unlock_channels(irq);
+  return res;
+}
+
+int ipc_export_channels(ChannelDescriptor *out, uint32_t max_count,
+                        uint32_t *count) {
+  ensure_initialized();
+  if (!count || (!out && max_count))
+    return IPC_ERR_INVALID_PARAM;
+
+  uint32_t n = 0;
+  bool irq = lock_channels();
+  for (uint32_t i = 0; i < MAX_CHANNELS; i++) {
+    if (!channel_table[i].is_active)
+      continue;
+    if (n < max_count)
+      out[n] = channel_table[i].descriptor;
+    n++;
+  }
+  unlock_channels(irq);
+  *count = n;
+  return IPC_SUCCESS;
+}
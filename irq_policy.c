@@ -0,0 +1,163 @@
+#include "irq_policy.h"
+#include <string.h>
+
+typedef struct {
+  IrqPolicy policy;
+  IrqPolicyStats stats;
+  uint32_t pending;       // Interrupts merged but not yet delivered
+  uint32_t window_events; // Interrupts in the current storm window
+  uint32_t backoff_shift; // Consecutive storms so far, capped
+  uint64_t window_start;
+  uint64_t last_delivery;
+  uint64_t unmask_at;
+} IrqLine;
+
+#define LINE_WORDS (IRQ_POLICY_MAX_IRQS / 32)
+
+static IrqLine lines[IRQ_POLICY_MAX_IRQS];
+// Lines the timer tick has to look at: held events, storm-masked lines
+static uint32_t pending_lines[LINE_WORDS];
+static uint32_t masked_lines[LINE_WORDS];
+
+static void set_bit(uint32_t *mask, uint32_t irq) {
+  mask[irq / 32] |= (1u << (irq % 32));
+}
+
+static void clear_bit(uint32_t *mask, uint32_t irq) {
+  mask[irq / 32] &= ~(1u << (irq % 32));
+}
+
+static void set_line_mask(HardwareContext *hw_ctx, uint32_t irq,
+                          int masked) {
+  HardwareTransaction txn;
+  txn.operation_code = masked ? HAL_OP_MASK_IRQ_LINE : HAL_OP_UNMASK_IRQ_LINE;
+  txn.input_address = 0;
+  txn.input_value = irq;
+  txn.output_address = 0;
+  txn.status_code = HAL_STATUS_OK;
+  if (masked)
+    hal_disable_interrupts(hw_ctx, &txn);
+  else
+    hal_enable_interrupts(hw_ctx, &txn);
+}
+
+static uint32_t take_pending(IrqLine *line, uint32_t irq, uint64_t now) {
+  uint32_t count = line->pending;
+  line->pending = 0;
+  line->last_delivery = now;
+  line->stats.deliveries++;
+  line->stats.merged += count - 1;
+  clear_bit(pending_lines, irq);
+  return count;
+}
+
+/**
+ * @brief Counts an interrupt against the storm window.
+ * @return 1 if the line is storming and has just been masked.
+ */
+static int detect_storm(HardwareContext *hw_ctx, IrqLine *line, uint32_t irq,
+                        uint64_t now) {
+  IrqPolicy *p = &line->policy;
+  if (!p->storm_threshold)
+    return 0;
+
+  if (now - line->window_start >= p->storm_window) {
+    // A calm window forgives earlier storms
+    if (line->window_events <= p->storm_threshold)
+      line->backoff_shift = 0;
+    line->window_start = now;
+    line->window_events = 0;
+  }
+
+  if (++line->window_events <= p->storm_threshold)
+    return 0;
+
+  set_line_mask(hw_ctx, irq, 1);
+  line->stats.masked = 1;
+  line->stats.storms++;
+  line->unmask_at = now + (p->storm_backoff << line->backoff_shift);
+  if (line->backoff_shift < IRQ_POLICY_MAX_BACKOFF_SHIFT)
+    line->backoff_shift++;
+  set_bit(masked_lines, irq);
+  return 1;
+}
+
+int irq_policy_configure(IrqPolicy *policy) {
+  if (!policy || policy->irq >= IRQ_POLICY_MAX_IRQS)
+    return IRQ_POLICY_ERR_INVALID_PARAM;
+  // Masked lines are released from the tick, so the tick line itself
+  // must never be coalesced or masked
+  if (policy->irq == HAL_TIMER_IRQ)
+    return IRQ_POLICY_ERR_INVALID_PARAM;
+  if (policy->storm_threshold &&
+      (policy->storm_window == 0 || policy->storm_backoff == 0))
+    return IRQ_POLICY_ERR_INVALID_PARAM;
+
+  IrqLine *line = &lines[policy->irq];
+  line->policy = *policy;
+  line->window_events = 0;
+  line->backoff_shift = 0;
+  return IRQ_POLICY_SUCCESS;
+}
+
+int irq_policy_query_stats(uint32_t irq, IrqPolicyStats *stats) {
+  if (irq >= IRQ_POLICY_MAX_IRQS || !stats)
+    return IRQ_POLICY_ERR_INVALID_PARAM;
+  *stats = lines[irq].stats;
+  return IRQ_POLICY_SUCCESS;
+}
+
+uint32_t irq_policy_on_interrupt(HardwareContext *hw_ctx, uint32_t irq,
+                                 uint64_t now) {
+  if (irq >= IRQ_POLICY_MAX_IRQS)
+    return 1;
+
+  IrqLine *line = &lines[irq];
+  IrqPolicy *p = &line->policy;
+  line->stats.events++;
+  line->pending++;
+
+  // A storming line is masked; flush what it had so nothing is lost
+  if (detect_storm(hw_ctx, line, irq, now))
+    return take_pending(line, irq, now);
+
+  if (!p->event_threshold && !p->min_interval)
+    return take_pending(line, irq, now);
+  if (p->event_threshold && line->pending >= p->event_threshold)
+    return take_pending(line, irq, now);
+  if (p->min_interval && now - line->last_delivery >= p->min_interval)
+    return take_pending(line, irq, now);
+
+  set_bit(pending_lines, irq);
+  return 0;
+}
+
+void irq_policy_tick(HardwareContext *hw_ctx, uint32_t cpu_id, uint64_t now,
+                     IrqPolicyDeliverFn deliver) {
+  for (uint32_t word = 0; word < LINE_WORDS; word++) {
+    uint32_t bits = pending_lines[word];
+    while (bits) {
+      uint32_t irq = word * 32 + (uint32_t)__builtin_ctz(bits);
+      bits &= bits - 1;
+      IrqLine *line = &lines[irq];
+      // Lines with an interval bound never hold events longer than that
+      if (line->policy.min_interval &&
+          now - line->last_delivery >= line->policy.min_interval)
+        deliver(cpu_id, irq, take_pending(line, irq, now));
+    }
+
+    bits = masked_lines[word];
+    while (bits) {
+      uint32_t irq = word * 32 + (uint32_t)__builtin_ctz(bits);
+      bits &= bits - 1;
+      IrqLine *line = &lines[irq];
+      if (now < line->unmask_at)
+        continue;
+      clear_bit(masked_lines, irq);
+      line->stats.masked = 0;
+      line->window_start = now;
+      line->window_events = 0;
+      set_line_mask(hw_ctx, irq, 0);
+    }
+  }
+}
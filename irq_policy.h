@@ -0,0 +1,54 @@
+#ifndef SIMPLEOS_IRQ_POLICY_H
+#define SIMPLEOS_IRQ_POLICY_H
+
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define IRQ_POLICY_SUCCESS 0
+#define IRQ_POLICY_ERR_INVALID_PARAM -1
+
+#define IRQ_POLICY_MAX_IRQS 224
+#define IRQ_POLICY_MAX_BACKOFF_SHIFT 6 // Backoff grows to 64x its base
+
+// Per-line delivery policy. Times are nanoseconds.
+// With both event_threshold and min_interval zero every interrupt is
+// delivered. Otherwise interrupts are merged and delivered as one work
+// item, or one channel message on bound lines, once event_threshold
+// events are pending or min_interval has passed since the last delivery,
+// whichever comes first. A storm (more than storm_threshold interrupts
+// within storm_window) masks the line for storm_backoff, doubling on each
+// consecutive storm.
+typedef struct {
+  uint32_t irq;             // IRQ line
+  uint32_t event_threshold; // Deliver after this many events (0 = off)
+  uint64_t min_interval;    // Deliver at most once per interval (0 = off)
+  uint32_t storm_threshold; // Interrupts per window that mask (0 = off)
+  uint32_t reserved;
+  uint64_t storm_window;    // Storm detection window
+  uint64_t storm_backoff;   // Initial mask duration
+} IrqPolicy;
+
+typedef struct {
+  uint64_t events;     // Interrupts taken
+  uint64_t deliveries; // Merged deliveries to the bottom half or channel
+  uint64_t merged;     // Interrupts folded into a later delivery
+  uint32_t storms;     // Times the line was masked
+  uint32_t masked;     // 1 while masked by the storm detector
+} IrqPolicyStats;
+
+int irq_policy_configure(IrqPolicy *policy);
+int irq_policy_query_stats(uint32_t irq, IrqPolicyStats *stats);
+
+// Receives interrupts flushed by the tick, merged into one delivery
+typedef void (*IrqPolicyDeliverFn)(uint32_t cpu_id, uint32_t irq,
+                                   uint32_t events);
+
+// Trap-path hooks
+uint32_t irq_policy_on_interrupt(HardwareContext *hw_ctx, uint32_t irq,
+                                 uint64_t now);
+void irq_policy_tick(HardwareContext *hw_ctx, uint32_t cpu_id, uint64_t now,
+                     IrqPolicyDeliverFn deliver);
+
+#endif // SIMPLEOS_IRQ_POLICY_H
@@ -0,0 +1,306 @@
+#include "pagetable.h"
+#include <string.h>
+
+// Stage-1 descriptor bits (4 KB granule)
+#define DESC_VALID (1ULL << 0)
+#define DESC_TABLE (1ULL << 1) // Table at levels 0-2, page at level 3
+#define DESC_ATTR_NORMAL (0ULL << 2) // MAIR_EL1 index 0: normal memory
+#define DESC_AP_EL0 (1ULL << 6)
+#define DESC_AP_RO (1ULL << 7)
+#define DESC_SH_INNER (3ULL << 8)
+#define DESC_AF (1ULL << 10)
+#define DESC_NG (1ULL << 11)
+#define DESC_PXN (1ULL << 53)
+#define DESC_UXN (1ULL << 54)
+#define DESC_ADDR_MASK 0x0000FFFFFFFFF000ULL
+
+#define LEAF_LEVEL 3
+#define BLOCK_LEVEL 2
+
+static uint32_t level_shift(uint32_t level) { return 39 - 9 * level; }
+
+static uint32_t table_index(uint64_t virt, uint32_t level) {
+  return (uint32_t)(virt >> level_shift(level)) & (PAGETABLE_ENTRIES - 1);
+}
+
+static uint64_t *next_table(uint64_t desc) {
+  return (uint64_t *)(uintptr_t)(desc & DESC_ADDR_MASK);
+}
+
+static uint32_t table_slot(const PageTable *pt, const uint64_t *table) {
+  return (uint32_t)(((const uint8_t *)table - pt->pool_base) / HAL_PAGE_SIZE);
+}
+
+static uint64_t leaf_attributes(uint32_t flags) {
+  uint64_t attr = DESC_AF | DESC_SH_INNER | DESC_ATTR_NORMAL;
+  if (!(flags & HAL_PAGE_FLAG_WRITE))
+    attr |= DESC_AP_RO;
+  if (flags & HAL_PAGE_FLAG_USER) {
+    // The kernel never executes agent pages
+    attr |= DESC_AP_EL0 | DESC_NG | DESC_PXN;
+    if (!(flags & HAL_PAGE_FLAG_EXEC))
+      attr |= DESC_UXN;
+  } else {
+    attr |= DESC_UXN;
+    if (!(flags & HAL_PAGE_FLAG_EXEC))
+      attr |= DESC_PXN;
+  }
+  return attr;
+}
+
+static uint32_t leaf_flags(uint64_t desc) {
+  uint32_t flags = HAL_PAGE_FLAG_READ;
+  if (!(desc & DESC_AP_RO))
+    flags |= HAL_PAGE_FLAG_WRITE;
+  if (desc & DESC_AP_EL0) {
+    flags |= HAL_PAGE_FLAG_USER;
+    if (!(desc & DESC_UXN))
+      flags |= HAL_PAGE_FLAG_EXEC;
+  } else if (!(desc & DESC_PXN)) {
+    flags |= HAL_PAGE_FLAG_EXEC;
+  }
+  return flags;
+}
+
+static uint64_t *alloc_table(PageTable *pt) {
+  if (!pt->free_head)
+    return NULL;
+  uint32_t slot = pt->free_head - 1;
+  uint64_t *table = (uint64_t *)(pt->pool_base + (uint64_t)slot * HAL_PAGE_SIZE);
+  pt->free_head = (uint32_t)table[0]; // Free pages link through word 0
+  memset(table, 0, HAL_PAGE_SIZE);
+  pt->live_entries[slot] = 0;
+  pt->tables_used++;
+  return table;
+}
+
+static void free_table(PageTable *pt, uint64_t *table) {
+  uint32_t slot = table_slot(pt, table);
+  table[0] = pt->free_head;
+  pt->free_head = slot + 1;
+  pt->tables_used--;
+}
+
+static void set_entry(PageTable *pt, uint64_t *table, uint32_t index,
+                      uint64_t desc) {
+  if (!(table[index] & DESC_VALID))
+    pt->live_entries[table_slot(pt, table)]++;
+  // Single-copy atomic so a concurrent table walk sees old or new
+  __atomic_store_n(&table[index], desc, __ATOMIC_RELEASE);
+}
+
+static void clear_entry(PageTable *pt, uint64_t *table, uint32_t index) {
+  if (table[index] & DESC_VALID)
+    pt->live_entries[table_slot(pt, table)]--;
+  __atomic_store_n(&table[index], 0, __ATOMIC_RELEASE);
+}
+
+static int valid_address(uint64_t virt, uint64_t phys, uint64_t align) {
+  return virt < (1ULL << PAGETABLE_VA_BITS) && (phys & ~DESC_ADDR_MASK) == 0 &&
+         ((virt | phys) & (align - 1)) == 0;
+}
+
+/**
+ * @brief Returns tables on the path to virt that no longer map anything.
+ *
+ * Walks down recording the path, then frees empty tables bottom-up. The
+ * root is never freed.
+ */
+static void prune_path(PageTable *pt, uint64_t virt) {
+  uint64_t *path[PAGETABLE_LEVELS];
+  uint32_t depth = 0;
+  uint64_t *table = pt->root;
+  while (1) {
+    path[depth++] = table;
+    if (depth == PAGETABLE_LEVELS)
+      break;
+    uint64_t desc = table[table_index(virt, depth - 1)];
+    if ((desc & (DESC_VALID | DESC_TABLE)) != (DESC_VALID | DESC_TABLE))
+      break;
+    table = next_table(desc);
+  }
+
+  while (depth > 1) {
+    uint64_t *child = path[depth - 1];
+    if (pt->live_entries[table_slot(pt, child)] != 0)
+      break;
+    clear_entry(pt, path[depth - 2], table_index(virt, depth - 2));
+    free_table(pt, child);
+    depth--;
+  }
+}
+
+/**
+ * @brief Walks to the table holding virt's descriptor at target_level,
+ * allocating missing tables on the way.
+ */
+static int walk_create(PageTable *pt, uint64_t virt, uint32_t target_level,
+                       uint64_t **out) {
+  uint64_t *table = pt->root;
+  for (uint32_t level = 0; level < target_level; level++) {
+    uint32_t index = table_index(virt, level);
+    uint64_t desc = table[index];
+    if (!(desc & DESC_VALID)) {
+      uint64_t *next = alloc_table(pt);
+      if (!next)
+        return PAGETABLE_ERR_OUT_OF_MEMORY;
+      set_entry(pt, table, index,
+                (uint64_t)(uintptr_t)next | DESC_TABLE | DESC_VALID);
+      table = next;
+    } else if (!(desc & DESC_TABLE)) {
+      return PAGETABLE_ERR_ALREADY_MAPPED; // Inside a block
+    } else {
+      table = next_table(desc);
+    }
+  }
+  *out = table;
+  return PAGETABLE_SUCCESS;
+}
+
+/**
+ * @brief Replaces a 2 MB block with a table of 512 equivalent pages.
+ *
+ * The caller invalidates the range afterwards; until then the TLB may
+ * still hold the block translation, which maps the same frames.
+ */
+static uint64_t *split_block(PageTable *pt, uint64_t *table, uint32_t index) {
+  uint64_t block = table[index];
+  uint64_t *pages = alloc_table(pt);
+  if (!pages)
+    return NULL;
+
+  uint64_t base = block & DESC_ADDR_MASK;
+  uint64_t attr = block & ~DESC_ADDR_MASK;
+  for (uint32_t i = 0; i < PAGETABLE_ENTRIES; i++)
+    pages[i] = (base + (uint64_t)i * HAL_PAGE_SIZE) | attr | DESC_TABLE;
+  pt->live_entries[table_slot(pt, pages)] = PAGETABLE_ENTRIES;
+
+  __atomic_store_n(&table[index],
+                   (uint64_t)(uintptr_t)pages | DESC_TABLE | DESC_VALID,
+                   __ATOMIC_RELEASE);
+  return pages;
+}
+
+int pagetable_init(PageTable *pt, void *pool, uint64_t pool_size) {
+  if (!pt || !pool)
+    return PAGETABLE_ERR_INVALID_PARAM;
+
+  uintptr_t base = ((uintptr_t)pool + HAL_PAGE_SIZE - 1) &
+                   ~(uintptr_t)(HAL_PAGE_SIZE - 1);
+  uint64_t skipped = base - (uintptr_t)pool;
+  if (pool_size < skipped + HAL_PAGE_SIZE)
+    return PAGETABLE_ERR_INVALID_PARAM;
+  uint64_t pages = (pool_size - skipped) / HAL_PAGE_SIZE;
+  if (pages > PAGETABLE_MAX_TABLES)
+    pages = PAGETABLE_MAX_TABLES;
+
+  memset(pt, 0, sizeof(*pt));
+  pt->pool_base = (uint8_t *)base;
+  pt->pool_pages = (uint32_t)pages;
+  for (uint32_t slot = pt->pool_pages; slot-- > 0;) {
+    uint64_t *page = (uint64_t *)(pt->pool_base + (uint64_t)slot * HAL_PAGE_SIZE);
+    page[0] = pt->free_head;
+    pt->free_head = slot + 1;
+  }
+
+  pt->root = alloc_table(pt);
+  return PAGETABLE_SUCCESS;
+}
+
+int pagetable_map_page(PageTable *pt, uint64_t virt, uint64_t phys,
+                       uint32_t flags) {
+  if (!pt || !pt->root || !valid_address(virt, phys, HAL_PAGE_SIZE))
+    return PAGETABLE_ERR_INVALID_PARAM;
+
+  uint64_t *table;
+  int res = walk_create(pt, virt, LEAF_LEVEL, &table);
+  if (res == PAGETABLE_SUCCESS) {
+    uint32_t index = table_index(virt, LEAF_LEVEL);
+    if (table[index] & DESC_VALID)
+      res = PAGETABLE_ERR_ALREADY_MAPPED;
+    else
+      set_entry(pt, table, index,
+                phys | leaf_attributes(flags) | DESC_TABLE | DESC_VALID);
+  }
+  if (res != PAGETABLE_SUCCESS)
+    prune_path(pt, virt); // Drop tables allocated for a failed mapping
+  return res;
+}
+
+int pagetable_map_block(PageTable *pt, uint64_t virt, uint64_t phys,
+                        uint32_t flags) {
+  if (!pt || !pt->root || !valid_address(virt, phys, HAL_BLOCK_SIZE))
+    return PAGETABLE_ERR_INVALID_PARAM;
+
+  uint64_t *table;
+  int res = walk_create(pt, virt, BLOCK_LEVEL, &table);
+  if (res == PAGETABLE_SUCCESS) {
+    uint32_t index = table_index(virt, BLOCK_LEVEL);
+    if (table[index] & DESC_VALID)
+      res = PAGETABLE_ERR_ALREADY_MAPPED;
+    else
+      set_entry(pt, table, index, phys | leaf_attributes(flags) | DESC_VALID);
+  }
+  if (res != PAGETABLE_SUCCESS)
+    prune_path(pt, virt);
+  return res;
+}
+
+int pagetable_unmap(PageTable *pt, uint64_t virt, uint64_t size) {
+  if (!pt || !pt->root || (size != HAL_PAGE_SIZE && size != HAL_BLOCK_SIZE) ||
+      !valid_address(virt, 0, size))
+    return PAGETABLE_ERR_INVALID_PARAM;
+
+  uint32_t target = size == HAL_PAGE_SIZE ? LEAF_LEVEL : BLOCK_LEVEL;
+  uint64_t *table = pt->root;
+  for (uint32_t level = 0; level < target; level++) {
+    uint32_t index = table_index(virt, level);
+    uint64_t desc = table[index];
+    if (!(desc & DESC_VALID))
+      return PAGETABLE_ERR_NOT_MAPPED;
+    if (desc & DESC_TABLE) {
+      table = next_table(desc);
+    } else if (level == BLOCK_LEVEL) {
+      table = split_block(pt, table, index);
+      if (!table)
+        return PAGETABLE_ERR_OUT_OF_MEMORY;
+    } else {
+      return PAGETABLE_ERR_INVALID_PARAM; // 1 GB blocks are never created
+    }
+  }
+
+  uint32_t index = table_index(virt, target);
+  uint64_t desc = table[index];
+  if (!(desc & DESC_VALID))
+    return PAGETABLE_ERR_NOT_MAPPED;
+  clear_entry(pt, table, index);
+  // A 2 MB range mapped with pages: its whole leaf table goes at once
+  if (target == BLOCK_LEVEL && (desc & DESC_TABLE))
+    free_table(pt, next_table(desc));
+
+  prune_path(pt, virt);
+  return PAGETABLE_SUCCESS;
+}
+
+int pagetable_lookup(const PageTable *pt, uint64_t virt, uint64_t *phys,
+                     uint32_t *flags) {
+  if (!pt || !pt->root || virt >= (1ULL << PAGETABLE_VA_BITS))
+    return PAGETABLE_ERR_INVALID_PARAM;
+
+  const uint64_t *table = pt->root;
+  for (uint32_t level = 0; level < PAGETABLE_LEVELS; level++) {
+    uint64_t desc = table[table_index(virt, level)];
+    if (!(desc & DESC_VALID))
+      return PAGETABLE_ERR_NOT_MAPPED;
+    if (level == LEAF_LEVEL || !(desc & DESC_TABLE)) {
+      uint64_t offset_mask = (1ULL << level_shift(level)) - 1;
+      if (phys)
+        *phys = (desc & DESC_ADDR_MASK & ~offset_mask) | (virt & offset_mask);
+      if (flags)
+        *flags = leaf_flags(desc);
+      return PAGETABLE_SUCCESS;
+    }
+    table = next_table(desc);
+  }
+  return PAGETABLE_ERR_NOT_MAPPED;
+}
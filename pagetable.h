@@ -0,0 +1,48 @@
+#ifndef SIMPLEOS_PAGETABLE_H
+#define SIMPLEOS_PAGETABLE_H
+
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define PAGETABLE_SUCCESS 0
+#define PAGETABLE_ERR_INVALID_PARAM -1
+#define PAGETABLE_ERR_OUT_OF_MEMORY -2
+#define PAGETABLE_ERR_ALREADY_MAPPED -4
+#define PAGETABLE_ERR_NOT_MAPPED -5
+
+#define PAGETABLE_LEVELS 4
+#define PAGETABLE_ENTRIES 512          // Descriptors per table page
+#define PAGETABLE_VA_BITS 48
+#define PAGETABLE_MAX_TABLES 1024      // Largest table pool, in pages
+
+// AArch64 stage-1 translation tables, 4 KB granule, 48-bit VA. Table
+// pages come from a caller-provided pool (any page-aligned memory, so
+// the engine runs unchanged on a host buffer). Descriptors hold pool
+// addresses as output addresses, which assumes the pool is identity
+// mapped. Tables left without live entries are returned to the pool.
+typedef struct {
+  uint64_t *root;      // Level-0 table; TTBR0_EL1 value
+  uint8_t *pool_base;  // First table page
+  uint32_t pool_pages; // Pages in the pool
+  uint32_t free_head;  // Free table page index + 1, 0 when exhausted
+  uint32_t tables_used;
+  uint32_t reserved;
+  uint16_t live_entries[PAGETABLE_MAX_TABLES]; // Valid descriptors per table
+} PageTable;
+
+int pagetable_init(PageTable *pt, void *pool, uint64_t pool_size);
+// virt/phys 4 KB aligned; flags are HAL_PAGE_FLAG_*
+int pagetable_map_page(PageTable *pt, uint64_t virt, uint64_t phys,
+                       uint32_t flags);
+// virt/phys 2 MB aligned; maps one level-2 block descriptor
+int pagetable_map_block(PageTable *pt, uint64_t virt, uint64_t phys,
+                        uint32_t flags);
+// size is HAL_PAGE_SIZE or HAL_BLOCK_SIZE. Unmapping a page inside a block
+// splits the block; unmapping a block range drops whatever maps it.
+int pagetable_unmap(PageTable *pt, uint64_t virt, uint64_t size);
+int pagetable_lookup(const PageTable *pt, uint64_t virt, uint64_t *phys,
+                     uint32_t *flags);
+
+#endif // SIMPLEOS_PAGETABLE_H
@@ -0,0 +1,74 @@
+#include "percpu.h"
+
+PerCpu percpu_areas[HAL_MAX_CPUS] = {
+    [0 ... HAL_MAX_CPUS - 1] = {.current_thread = PERCPU_NO_THREAD,
+                                .ready_head = PERCPU_NO_THREAD,
+                                .ready_tail = PERCPU_NO_THREAD}};
+
+#if !(defined(__aarch64__) && !SIMPLEOS_HAL_SIM)
+__thread PerCpu *percpu_current = NULL;
+#endif
+
+PerCpu *percpu_get(uint32_t cpu_id) {
+  if (cpu_id >= HAL_MAX_CPUS)
+    return NULL;
+  return &percpu_areas[cpu_id];
+}
+
+int percpu_init_cpu(uint32_t cpu_id, const HardwareContext *hw_ctx) {
+  PerCpu *cpu = percpu_get(cpu_id);
+  if (!cpu)
+    return PERCPU_ERR_INVALID_PARAM;
+
+  if (hw_ctx)
+    cpu->hw_context = *hw_ctx;
+  cpu->hw_context.cpu_id = cpu_id;
+
+#if defined(__aarch64__) && !SIMPLEOS_HAL_SIM
+  __asm__ volatile("msr tpidr_el1, %0" : : "r"(cpu));
+#else
+  percpu_current = cpu;
+#endif
+  __atomic_store_n(&cpu->online, 1, __ATOMIC_RELEASE);
+  return PERCPU_SUCCESS;
+}
+
+uint32_t percpu_online_count(void) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < HAL_MAX_CPUS; i++)
+    count += __atomic_load_n(&percpu_areas[i].online, __ATOMIC_ACQUIRE);
+  return count;
+}
+
+int percpu_query_stats(uint32_t cpu_id, PerCpuStats *stats) {
+  PerCpu *cpu = percpu_get(cpu_id);
+  if (!cpu || !stats)
+    return PERCPU_ERR_INVALID_PARAM;
+  if (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE))
+    return PERCPU_ERR_NOT_FOUND;
+  *stats = cpu->stats;
+  return PERCPU_SUCCESS;
+}
+
+void percpu_request_resched(uint32_t cpu_id) {
+  PerCpu *cpu = percpu_get(cpu_id);
+  if (cpu)
+    __atomic_store_n(&cpu->need_resched, 1, __ATOMIC_RELEASE);
+}
+
+int percpu_resched_pending(void) {
+  return __atomic_load_n(&percpu_this()->need_resched, __ATOMIC_ACQUIRE) != 0;
+}
+
+void percpu_clear_resched(void) {
+  __atomic_store_n(&percpu_this()->need_resched, 0, __ATOMIC_RELEASE);
+}
+
+void percpu_lock_run_queue(PerCpu *cpu) {
+  while (__atomic_test_and_set(&cpu->run_queue_lock, __ATOMIC_ACQUIRE))
+    ;
+}
+
+void percpu_unlock_run_queue(PerCpu *cpu) {
+  __atomic_clear(&cpu->run_queue_lock, __ATOMIC_RELEASE);
+}
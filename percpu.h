@@ -0,0 +1,75 @@
+#ifndef SIMPLEOS_PERCPU_H
+#define SIMPLEOS_PERCPU_H
+
+#include "hal.h"
+#include "hal_sim.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define PERCPU_SUCCESS 0
+#define PERCPU_ERR_INVALID_PARAM -1
+#define PERCPU_ERR_NOT_FOUND -5
+
+#define PERCPU_NO_THREAD 0xFFFFFFFFu
+
+typedef struct {
+  uint64_t context_switches;
+  uint64_t idle_entries; // Scheduler runs that found nothing ready
+  uint64_t traps;
+  uint64_t syscalls;
+} PerCpuStats;
+
+// State only its own CPU writes, one block per CPU on its own cache
+// lines. The run queue is the exception: other CPUs append to it when
+// waking a thread homed here, under run_queue_lock, and need_resched,
+// which any CPU may set atomically.
+typedef struct {
+  uint32_t online;
+  uint32_t current_thread; // PERCPU_NO_THREAD while idle
+  uint32_t ready_head;     // Run queue, linked through the thread table
+  uint32_t ready_tail;
+  uint32_t ready_count;
+  int run_queue_lock;
+  uint32_t need_resched; // Scheduler runs at the next trap exit
+  HardwareContext hw_context; // This CPU's context for HAL calls
+  PerCpuStats stats;
+} __attribute__((aligned(64))) PerCpu;
+
+extern PerCpu percpu_areas[HAL_MAX_CPUS];
+
+#if defined(__aarch64__) && !SIMPLEOS_HAL_SIM
+// TPIDR_EL1 holds the block of the running CPU, set by percpu_init_cpu
+static inline PerCpu *percpu_this(void) {
+  PerCpu *cpu;
+  __asm__ volatile("mrs %0, tpidr_el1" : "=r"(cpu));
+  return cpu;
+}
+#else
+// Each simulated CPU is a host thread; unbound threads act as CPU 0
+extern __thread PerCpu *percpu_current;
+static inline PerCpu *percpu_this(void) {
+  return percpu_current ? percpu_current : &percpu_areas[0];
+}
+#endif
+
+static inline uint32_t percpu_cpu_id(void) {
+  return (uint32_t)(percpu_this() - percpu_areas);
+}
+
+PerCpu *percpu_get(uint32_t cpu_id);
+// Binds the calling CPU to its block and marks it online
+int percpu_init_cpu(uint32_t cpu_id, const HardwareContext *hw_ctx);
+uint32_t percpu_online_count(void);
+int percpu_query_stats(uint32_t cpu_id, PerCpuStats *stats);
+
+// Asks cpu_id to enter its scheduler when it next leaves a trap
+void percpu_request_resched(uint32_t cpu_id);
+int percpu_resched_pending(void);
+// Clears this CPU's request once the scheduler has picked it up
+void percpu_clear_resched(void);
+
+void percpu_lock_run_queue(PerCpu *cpu);
+void percpu_unlock_run_queue(PerCpu *cpu);
+
+#endif // SIMPLEOS_PERCPU_H
@@ -0,0 +1,926 @@
+#include "scenario.h"
+#include "agents.h"
+#include "events.h"
+#include "hal_clock.h"
+#include "hal_internal.h"
+#include "hal_sim.h"
+#include "integrator.h"
+#include "ipc.h"
+#include "irq_policy.h"
+#include "percpu.h"
+#include "syscalls.h"
+#include "threads.h"
+#include "traps.h"
+#include "workqueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Deterministic discrete-event latency simulator. The kernel runs on the
+// hal_sim virtual clock: interrupts come from seeded hal_sim sources and
+// go through dispatch_trap, agents are event handlers and threads whose
+// work is simulated time, and their syscalls take the trap path. Kernel
+// code itself takes no simulated time; the scenario's cost model charges
+// each path instead, stretched by interrupts that land inside it.
+
+#define SIM_KERNEL_MEMORY (64u << 20)
+#define SIM_COUNTER_FREQUENCY 1000000000ULL // Keeps tick periods exact
+#define SIM_AGENT_BASE 2
+#define SIM_CHANNEL_BASE 900
+#define SIM_HANDLER_BASE 128
+#define SIM_THREAD_BASE 32
+#define SIM_CHANNEL_DEPTH 16
+#define SIM_PENDING_DEPTH 256 // Interrupts held by a policy or queued
+#define SIM_MESSAGE_SIZE 32
+#define SIM_TRACE_RING 8192
+#define SIM_WORST_HEAD 16 // Steps kept from the start of a worst case
+#define SIM_WORST_TAIL 24 // and from its end
+#define SIM_WORST_EVENTS (SIM_WORST_HEAD + SIM_WORST_TAIL)
+#define SIM_NO_ITEM 0xFFFF
+
+#define SIM_EXIT_BUDGET_MISSED 3
+
+// Trace events
+#define SIM_EV_RAISE 0
+#define SIM_EV_COALESCE 1
+#define SIM_EV_IRQ 2          // arg: line
+#define SIM_EV_LOST 3         // Bound channel full, message dropped
+#define SIM_EV_HANDLER 4      // arg: SIM_ROLE_*
+#define SIM_EV_HANDLER_END 5
+#define SIM_EV_SYSCALL 6      // arg: syscall number
+#define SIM_EV_SWITCH 7       // arg: thread id
+#define SIM_EV_IDLE 8
+#define SIM_EV_BOTTOM_HALF 9  // arg: merged events
+#define SIM_EV_REPLY 10       // arg: request sequence
+#define SIM_EV_HELD 11        // arg: line; taken, held back by its policy
+#define SIM_EV_STORM 12       // arg: line; masked by the storm detector
+
+// Event handler roles
+#define SIM_ROLE_SENSOR 0
+#define SIM_ROLE_CLIENT 1
+#define SIM_ROLE_SERVER 2
+#define SIM_ROLE_REPLY 3
+
+typedef struct {
+  uint64_t time;
+  uint16_t type;
+  uint16_t item;
+  uint32_t arg;
+} SimEvent;
+
+// Consecutive identical events of a worst case, folded into one
+typedef struct {
+  SimEvent event;
+  uint64_t last;   // Time of the last one folded in
+  uint32_t repeat;
+} SimStep;
+
+// One latency being measured, with the events behind its worst sample
+typedef struct {
+  uint64_t samples;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t misses; // Samples over budget
+  uint64_t worst_cause; // Simulated time the worst sample started
+  uint32_t worst_count;
+  uint32_t worst_elided; // Steps between the kept head and tail
+  uint32_t worst_lost;   // Start of the window fell out of the ring
+  SimStep worst[SIM_WORST_EVENTS];
+} SimProbe;
+
+typedef struct {
+  uint64_t sent_at;
+  uint32_t sequence;
+  uint32_t item;
+} SimRequest;
+
+typedef struct {
+  const ScenarioItem *config;
+  uint32_t index;
+  uint32_t agent_id;
+  uint32_t server_agent_id;
+  uint32_t channel_id;        // Bound to the item's IRQ line
+  uint32_t server_channel_id;
+  uint32_t reply_channel_id;
+  uint32_t thread_id;
+  uint32_t sequence;
+  uint64_t raised;
+  uint64_t coalesced;
+  uint64_t lost;
+  // Raise times of interrupts taken on the line that the handler has not
+  // seen yet, whether held by the line's policy or queued on the channel
+  uint64_t pending[SIM_PENDING_DEPTH];
+  uint32_t pending_head;
+  uint32_t pending_count;
+  // Messages on the bound channel. The kernel is the only sender there,
+  // so this mirrors the channel exactly.
+  uint32_t queued;
+  uint64_t policy_events; // Interrupts the line's policy has let through
+  uint32_t policy_storms;
+  SimProbe probe;
+} SimItem;
+
+static Scenario scenario;
+static SimItem items[SCENARIO_MAX_ITEMS];
+static int16_t line_items[HAL_SIM_IRQ_LINES];
+static SimEvent ring[SIM_TRACE_RING];
+static uint64_t ring_total; // Events ever recorded
+
+static void record(uint16_t type, uint16_t item, uint32_t arg) {
+  SimEvent *ev = &ring[ring_total++ % SIM_TRACE_RING];
+  ev->time = hal_sim_now();
+  ev->type = type;
+  ev->item = item;
+  ev->arg = arg;
+}
+
+static void record_at(uint64_t time, uint16_t type, uint16_t item,
+                      uint32_t arg) {
+  record(type, item, arg);
+  ring[(ring_total - 1) % SIM_TRACE_RING].time = time;
+}
+
+/**
+ * @brief Burns simulated CPU time.
+ *
+ * Interrupts due inside the span are taken at their deadlines; each one
+ * taken pushes the end of the span out by the modelled interrupt cost.
+ */
+static void sim_compute(uint64_t ns) {
+  while (ns) {
+    HalSimStats before, after;
+    hal_sim_query_stats(&before);
+    hal_sim_advance(ns);
+    hal_sim_query_stats(&after);
+    ns = (after.delivered - before.delivered) * scenario.costs.irq_ns;
+  }
+}
+
+/**
+ * @brief Burns up to ns of a thread's CPU time, stopping at preemption.
+ *
+ * Time advances one interrupt deadline at a time. An interrupt that
+ * returns TRAP_RETURN_SCHEDULE_NEXT ends the slice, as the exception
+ * return path would enter the scheduler there.
+ */
+static uint64_t sim_reschedules(void) {
+  HalSimStats stats;
+  hal_sim_query_stats(&stats);
+  return stats.reschedules;
+}
+
+static void sim_compute_preemptible(uint64_t ns) {
+  uint64_t reschedules = sim_reschedules();
+  while (ns) {
+    uint64_t now = hal_sim_now();
+    uint64_t next = hal_sim_next_deadline();
+    uint64_t step = next > now ? next - now : 1;
+    if (step > ns)
+      step = ns;
+    sim_compute(step);
+    ns -= step;
+    if (sim_reschedules() != reschedules)
+      return;
+  }
+}
+
+static int is_context_event(uint16_t type) {
+  return type == SIM_EV_SWITCH || type == SIM_EV_IDLE ||
+         type == SIM_EV_HANDLER;
+}
+
+static void fold_event(SimStep *steps, uint32_t *count, const SimEvent *ev) {
+  SimStep *prev = *count ? &steps[*count - 1] : NULL;
+  if (prev && prev->event.type == ev->type && prev->event.item == ev->item &&
+      prev->event.arg == ev->arg) {
+    prev->repeat++;
+    prev->last = ev->time;
+    return;
+  }
+  SimStep *step = &steps[(*count)++];
+  step->event = *ev;
+  step->last = ev->time;
+  step->repeat = 1;
+}
+
+/**
+ * @brief Keeps the events of a new worst case for a probe.
+ *
+ * The window runs from the cause to now, preceded by whatever held the
+ * CPU when it opened. A raise taken at once folds into its delivery and
+ * runs of identical events fold into one step; long windows keep their
+ * first SIM_WORST_HEAD and last SIM_WORST_TAIL steps.
+ */
+static void capture_worst(SimProbe *probe, uint64_t cause) {
+  static SimStep steps[SIM_TRACE_RING + 1];
+  uint64_t oldest = ring_total > SIM_TRACE_RING ? ring_total - SIM_TRACE_RING
+                                                : 0;
+  uint64_t first = ring_total;
+  while (first > oldest && ring[(first - 1) % SIM_TRACE_RING].time >= cause)
+    first--;
+  uint64_t context = first;
+  while (context > oldest &&
+         !is_context_event(ring[(context - 1) % SIM_TRACE_RING].type))
+    context--;
+
+  uint32_t count = 0;
+  if (context > oldest)
+    fold_event(steps, &count, &ring[(context - 1) % SIM_TRACE_RING]);
+  for (uint64_t i = first; i < ring_total; i++) {
+    const SimEvent *ev = &ring[i % SIM_TRACE_RING];
+    const SimEvent *next = &ring[(i + 1) % SIM_TRACE_RING];
+    if (ev->type == SIM_EV_RAISE && i + 1 < ring_total &&
+        next->type == SIM_EV_IRQ && next->arg == ev->arg &&
+        next->time == ev->time)
+      continue;
+    fold_event(steps, &count, ev);
+  }
+
+  probe->worst_cause = cause;
+  probe->worst_lost = first == oldest && oldest > 0;
+  probe->worst_elided = 0;
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (count > SIM_WORST_EVENTS && i == SIM_WORST_HEAD) {
+      probe->worst_elided = count - SIM_WORST_EVENTS;
+      i = count - SIM_WORST_TAIL;
+    }
+    probe->worst[kept++] = steps[i];
+  }
+  probe->worst_count = kept;
+}
+
+static void probe_sample(SimItem *item, uint64_t cause) {
+  SimProbe *probe = &item->probe;
+  uint64_t latency = hal_sim_now() - cause;
+  probe->samples++;
+  probe->total_ns += latency;
+  if (item->config->budget_ns && latency > item->config->budget_ns)
+    probe->misses++;
+  if (latency > probe->max_ns || probe->samples == 1) {
+    probe->max_ns = latency;
+    capture_worst(probe, cause);
+  }
+}
+
+static uint64_t pop_pending(SimItem *item) {
+  uint64_t raised_at = item->pending[item->pending_head];
+  item->pending_head = (item->pending_head + 1) % SIM_PENDING_DEPTH;
+  item->pending_count--;
+  return raised_at;
+}
+
+/**
+ * @brief Mirrors what the kernel did with a line once a trap returns.
+ *
+ * The line's policy stats tell whether interrupts were let through. For
+ * a bound line that is one message on the channel, or, with the channel
+ * full, interrupts lost.
+ */
+static void settle_line(SimItem *item, uint32_t trap_line) {
+  uint32_t line = item->config->line;
+  uint16_t index = (uint16_t)item->index;
+  IrqPolicyStats stats;
+  if (irq_policy_query_stats(line, &stats) != IRQ_POLICY_SUCCESS)
+    return;
+  if (stats.storms != item->policy_storms) {
+    item->policy_storms = stats.storms;
+    record(SIM_EV_STORM, index, line);
+  }
+
+  uint64_t through = stats.deliveries + stats.merged;
+  uint64_t events = through - item->policy_events;
+  item->policy_events = through;
+  if (!events) {
+    // The interrupt just taken went nowhere: retag it so runs of held
+    // interrupts fold into one step
+    SimEvent *last = &ring[(ring_total - 1) % SIM_TRACE_RING];
+    if (trap_line == line && ring_total && last->type == SIM_EV_IRQ &&
+        last->arg == line)
+      last->type = SIM_EV_HELD;
+    return;
+  }
+  if (item->config->kind != SCENARIO_SENSOR &&
+      item->config->kind != SCENARIO_REQUEST)
+    return;
+  if (item->queued == SIM_CHANNEL_DEPTH) {
+    // forward_irq_to_channel found the channel full
+    item->lost += events;
+    record(SIM_EV_LOST, index, line);
+    for (; events && item->pending_count; events--)
+      pop_pending(item);
+    return;
+  }
+  item->queued++;
+}
+
+// hal_sim controller trace: raises, deliveries into dispatch_trap and
+// the returns from it
+static void on_controller_event(uint32_t event, uint32_t line, uint64_t now,
+                                uint64_t raised_at) {
+  int16_t index = line_items[line];
+  uint16_t item = index < 0 ? SIM_NO_ITEM : (uint16_t)index;
+  if (event == HAL_SIM_TRACE_RAISE || event == HAL_SIM_TRACE_COALESCE) {
+    record_at(now, event == HAL_SIM_TRACE_RAISE ? SIM_EV_RAISE
+                                                : SIM_EV_COALESCE,
+              item, line);
+    if (index >= 0) {
+      items[index].raised++;
+      if (event == HAL_SIM_TRACE_COALESCE)
+        items[index].coalesced++;
+    }
+    return;
+  }
+
+  if (event == HAL_SIM_TRACE_RETURN) {
+    // A tick may flush lines other than its own
+    for (uint32_t i = 0; i < scenario.item_count; i++)
+      if (items[i].config->kind != SCENARIO_HOG)
+        settle_line(&items[i], line);
+    return;
+  }
+
+  record(SIM_EV_IRQ, item, line);
+  if (index < 0)
+    return;
+  SimItem *it = &items[index];
+  if (it->config->kind != SCENARIO_SENSOR &&
+      it->config->kind != SCENARIO_REQUEST)
+    return;
+  if (it->pending_count == SIM_PENDING_DEPTH)
+    pop_pending(it);
+  it->pending[(it->pending_head + it->pending_count++) % SIM_PENDING_DEPTH] =
+      raised_at;
+}
+
+/**
+ * @brief Issues a block-ABI syscall through the trap path.
+ * @return Syscall status, or the trap error if no frame was free.
+ */
+static int sim_syscall(SimItem *item, uint32_t agent_id, uint32_t number,
+                       void *args, uint32_t size) {
+  sim_compute(scenario.costs.syscall_ns);
+  record(SIM_EV_SYSCALL, (uint16_t)item->index, number);
+
+  TrapContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.trap_type = TRAP_TYPE_SYSCALL;
+  ctx.current_agent_id = agent_id;
+  ctx.current_thread_id = thread_current_id();
+  ctx.privilege_level = PRIVILEGE_USER;
+
+  TrapTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  int res = capture_trap_state(&ctx, &txn);
+  if (res != TRAP_SUCCESS)
+    return res;
+  TrapFrame *frame = (TrapFrame *)txn.trap_frame_address;
+  frame->x[0] = ((uint64_t)SYSCALL_ABI_BLOCK << 32) | number;
+  frame->x[1] = (uint64_t)(uintptr_t)args;
+  frame->x[2] = size;
+  dispatch_trap(&ctx, &txn);
+  res = (int)(int64_t)frame->x[0];
+  restore_trap_state_and_return(&ctx, &txn);
+  return res;
+}
+
+// Argument block of SYSCALL_IPC_SEND
+typedef struct {
+  ChannelDescriptor cd;
+  MessageEnvelope me;
+} SimIpcArgs;
+
+static void send_request(SimItem *item, uint32_t agent_id,
+                         uint32_t channel_id, SimRequest *request) {
+  SimIpcArgs args;
+  memset(&args, 0, sizeof(args));
+  args.cd.channel_id = channel_id;
+  args.me.dst_agent_id = agent_id;
+  args.me.flags = IPC_MSG_FLAG_NON_BLOCKING;
+  args.me.payload = request;
+  args.me.payload_len = sizeof(*request);
+  sim_syscall(item, agent_id, SYSCALL_IPC_SEND, &args, sizeof(args));
+}
+
+static void enter_handler(SimItem *item, uint32_t role) {
+  sim_compute(scenario.costs.dispatch_ns);
+  record(SIM_EV_HANDLER, (uint16_t)item->index, role);
+}
+
+// Returns the number of interrupts an IRQ message stands for
+static uint32_t take_irq_message(SimItem *item, const MessageEnvelope *msg) {
+  uint32_t events = 1;
+  if (msg->payload && msg->payload_len >= sizeof(events))
+    memcpy(&events, msg->payload, sizeof(events));
+  item->queued--;
+  return events;
+}
+
+static void on_sensor_message(const MessageEnvelope *msg, void *state) {
+  SimItem *item = (SimItem *)state;
+  enter_handler(item, SIM_ROLE_SENSOR);
+  // Each merged interrupt is a sample, measured from its own raise
+  for (uint32_t n = take_irq_message(item, msg); n && item->pending_count;
+       n--)
+    probe_sample(item, pop_pending(item));
+  sim_compute(item->config->work_ns);
+  record(SIM_EV_HANDLER_END, (uint16_t)item->index, SIM_ROLE_SENSOR);
+}
+
+static void on_client_tick(const MessageEnvelope *msg, void *state) {
+  SimItem *item = (SimItem *)state;
+  enter_handler(item, SIM_ROLE_CLIENT);
+  for (uint32_t n = take_irq_message(item, msg); n && item->pending_count;
+       n--)
+    pop_pending(item);
+  SimRequest request;
+  memset(&request, 0, sizeof(request));
+  request.sent_at = hal_sim_now();
+  request.sequence = item->sequence++;
+  request.item = item->index;
+  send_request(item, item->agent_id, item->server_channel_id, &request);
+  record(SIM_EV_HANDLER_END, (uint16_t)item->index, SIM_ROLE_CLIENT);
+}
+
+static void on_server_request(const MessageEnvelope *msg, void *state) {
+  SimItem *item = (SimItem *)state;
+  enter_handler(item, SIM_ROLE_SERVER);
+  SimRequest request;
+  memcpy(&request, msg->payload, sizeof(request));
+  sim_compute(item->config->work_ns);
+  send_request(item, item->server_agent_id, item->reply_channel_id,
+               &request);
+  record(SIM_EV_HANDLER_END, (uint16_t)item->index, SIM_ROLE_SERVER);
+}
+
+static void on_client_reply(const MessageEnvelope *msg, void *state) {
+  SimItem *item = (SimItem *)state;
+  enter_handler(item, SIM_ROLE_REPLY);
+  SimRequest request;
+  memcpy(&request, msg->payload, sizeof(request));
+  record(SIM_EV_REPLY, (uint16_t)item->index, request.sequence);
+  probe_sample(item, request.sent_at);
+  record(SIM_EV_HANDLER_END, (uint16_t)item->index, SIM_ROLE_REPLY);
+}
+
+static void on_noise_bottom_half(uint32_t irq, uint32_t event_count,
+                                 void *arg) {
+  SimItem *item = (SimItem *)arg;
+  record(SIM_EV_BOTTOM_HALF, (uint16_t)item->index, event_count);
+  sim_compute(item->config->work_ns * event_count);
+}
+
+// Hog threads never run host code; run_thread stands in for them
+static void hog_entry(void) {}
+
+// Setup goes through the kernel calls directly; it is not measured
+
+static int create_channel(uint32_t channel_id, uint32_t owner) {
+  ChannelDescriptor cd;
+  memset(&cd, 0, sizeof(cd));
+  cd.channel_id = channel_id;
+  cd.owner_agent_id = owner;
+  cd.max_messages = SIM_CHANNEL_DEPTH;
+  cd.max_message_size = SIM_MESSAGE_SIZE;
+  cd.delivery_mode = IPC_DELIVERY_DROP;
+  MessageEnvelope me;
+  memset(&me, 0, sizeof(me));
+  me.dst_agent_id = owner;
+  return ipc_channel_create(&cd, &me);
+}
+
+static int register_handler(uint32_t handler_id, uint32_t owner,
+                            uint32_t channel_id, EventHandlerFn fn,
+                            SimItem *item) {
+  EventHandlerDescriptor hd;
+  memset(&hd, 0, sizeof(hd));
+  hd.handler_id = handler_id;
+  hd.owner_agent_id = owner;
+  hd.channel_id = channel_id;
+  hd.handler = fn;
+  hd.agent_state = item;
+  EventTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  txn.requester_agent_id = owner;
+  return event_handler_register(&hd, &txn);
+}
+
+static int configure_policy(SimItem *item) {
+  const ScenarioItem *c = item->config;
+  if (!c->coalesce && !c->interval_ns && !c->storm)
+    return 0;
+  IrqPolicy policy;
+  memset(&policy, 0, sizeof(policy));
+  policy.irq = c->line;
+  policy.event_threshold = c->coalesce;
+  policy.min_interval = c->interval_ns;
+  policy.storm_threshold = c->storm;
+  policy.storm_window = c->window_ns;
+  policy.storm_backoff = c->backoff_ns;
+  return irq_policy_configure(&policy) == IRQ_POLICY_SUCCESS ? 0 : -1;
+}
+
+static int add_source(SimItem *item) {
+  const ScenarioItem *c = item->config;
+  HalSimSource source;
+  memset(&source, 0, sizeof(source));
+  source.line = c->line;
+  source.period_ns = c->period_ns;
+  source.jitter_ns = c->jitter_ns;
+  source.burst_count = c->burst_count;
+  source.burst_gap_ns = c->burst_gap_ns;
+  source.pattern = c->burst_count  ? HAL_SIM_PATTERN_BURST
+                   : c->jitter_ns ? HAL_SIM_PATTERN_JITTER
+                                  : HAL_SIM_PATTERN_PERIODIC;
+  // Distinct, reproducible streams per item
+  source.seed = c->seed ? c->seed
+                        : (scenario.seed + item->index + 1) *
+                              0x9E3779B97F4A7C15ULL;
+  return hal_sim_add_source(&source) >= 0 ? 0 : -1;
+}
+
+/**
+ * @brief Creates the agents, channels, handlers and sources of one item.
+ *
+ * Handler ids follow script order, so earlier items are dispatched first
+ * within an event pass.
+ */
+static int setup_item(SimItem *item, uint32_t *next_agent) {
+  const ScenarioItem *c = item->config;
+  uint32_t base = SIM_CHANNEL_BASE + item->index * 3;
+  uint32_t handler = SIM_HANDLER_BASE + item->index * 3;
+  item->agent_id = (*next_agent)++;
+
+  if (c->kind != SCENARIO_HOG) {
+    if (c->line >= HAL_SIM_IRQ_LINES || c->line == HAL_TIMER_IRQ ||
+        line_items[c->line] >= 0)
+      return -1;
+    line_items[c->line] = (int16_t)item->index;
+    if (configure_policy(item) != 0)
+      return -1;
+  }
+
+  switch (c->kind) {
+  case SCENARIO_SENSOR:
+    item->channel_id = base;
+    if (create_channel(item->channel_id, item->agent_id) != IPC_SUCCESS ||
+        register_handler(handler, item->agent_id, item->channel_id,
+                         on_sensor_message, item) != EVENT_SUCCESS ||
+        trap_bind_irq_to_channel(c->line, item->channel_id,
+                                 item->agent_id) != TRAP_SUCCESS)
+      return -1;
+    return add_source(item);
+
+  case SCENARIO_REQUEST:
+    item->server_agent_id = (*next_agent)++;
+    item->channel_id = base;
+    item->server_channel_id = base + 1;
+    item->reply_channel_id = base + 2;
+    if (create_channel(item->channel_id, item->agent_id) != IPC_SUCCESS ||
+        create_channel(item->server_channel_id, item->server_agent_id) !=
+            IPC_SUCCESS ||
+        create_channel(item->reply_channel_id, item->agent_id) !=
+            IPC_SUCCESS ||
+        register_handler(handler, item->agent_id, item->channel_id,
+                         on_client_tick, item) != EVENT_SUCCESS ||
+        register_handler(handler + 1, item->server_agent_id,
+                         item->server_channel_id, on_server_request,
+                         item) != EVENT_SUCCESS ||
+        register_handler(handler + 2, item->agent_id, item->reply_channel_id,
+                         on_client_reply, item) != EVENT_SUCCESS ||
+        trap_bind_irq_to_channel(c->line, item->channel_id,
+                                 item->agent_id) != TRAP_SUCCESS)
+      return -1;
+    return add_source(item);
+
+  case SCENARIO_NOISE:
+    if (c->work_ns &&
+        workqueue_register_bottom_half(c->line, on_noise_bottom_half,
+                                       item) != WORKQUEUE_SUCCESS)
+      return -1;
+    return add_source(item);
+
+  default: {
+    AgentDescriptor agent;
+    memset(&agent, 0, sizeof(agent));
+    agent.agent_id = item->agent_id;
+    agent.cpu_share_permille = c->share;
+    if (agent_configure(&agent, NULL) != AGENT_SUCCESS)
+      return -1;
+    ThreadDescriptor td;
+    memset(&td, 0, sizeof(td));
+    td.thread_id = item->thread_id = SIM_THREAD_BASE + item->index;
+    td.owner_agent_id = item->agent_id;
+    td.entry_point = (void *)hog_entry;
+    td.priority = c->priority;
+    return create_thread(&td, NULL) == THREAD_SUCCESS ? 0 : -1;
+  }
+  }
+}
+
+static SimItem *hog_for_thread(uint32_t thread_id) {
+  for (uint32_t i = 0; i < scenario.item_count; i++)
+    if (items[i].config->kind == SCENARIO_HOG &&
+        items[i].thread_id == thread_id)
+      return &items[i];
+  return NULL;
+}
+
+static void block_current(uint32_t thread_id) {
+  ThreadDescriptor td;
+  memset(&td, 0, sizeof(td));
+  td.thread_id = thread_id;
+  ThreadTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  block_thread(&td, &txn);
+}
+
+/**
+ * @brief Runs the current thread's body for one scheduling step.
+ *
+ * Hogs compute for a quantum, or until an interrupt makes an event
+ * handler pending. The bottom-half thread drains its queue
+ * and blocks once empty, as workqueue_thread_main does. Threads the
+ * scenario does not drive (the init thread) block at once.
+ */
+static void run_thread(uint32_t thread_id) {
+  SimItem *hog = hog_for_thread(thread_id);
+  if (hog) {
+    sim_compute_preemptible(scenario.costs.quantum_ns);
+    return;
+  }
+  if (thread_id == WORKQUEUE_THREAD_ID_BASE) {
+    workqueue_run_bottom_halves(0);
+    WorkqueueStats stats;
+    workqueue_query_stats(0, &stats);
+    if (stats.queued == stats.completed)
+      block_current(thread_id);
+    return;
+  }
+  block_current(thread_id);
+}
+
+static void run(uint64_t end) {
+  uint32_t last = PERCPU_NO_THREAD;
+  while (hal_sim_now() < end) {
+    // Scheduling points dispatch pending event handlers first
+    thread_schedule();
+    uint32_t current = thread_current_id();
+    if (current == PERCPU_NO_THREAD) {
+      // WFI: sleep until the next interrupt
+      uint64_t now = hal_sim_now();
+      uint64_t next = hal_sim_next_deadline();
+      if (last != PERCPU_NO_THREAD)
+        record(SIM_EV_IDLE, SIM_NO_ITEM, 0);
+      last = PERCPU_NO_THREAD;
+      hal_sim_advance((next < end ? next : end) - now);
+      continue;
+    }
+    if (current != last) {
+      uint64_t reschedules = sim_reschedules();
+      record(SIM_EV_SWITCH, SIM_NO_ITEM, current);
+      sim_compute(scenario.costs.switch_ns);
+      last = current;
+      if (sim_reschedules() != reschedules)
+        continue; // Preempted while switching in
+    }
+    run_thread(current);
+  }
+}
+
+static void format_time(char *out, size_t size, uint64_t ns) {
+  if (ns >= 1000000)
+    snprintf(out, size, "%.3fms", ns / 1e6);
+  else if (ns >= 1000)
+    snprintf(out, size, "%.3fus", ns / 1e3);
+  else
+    snprintf(out, size, "%lluns", (unsigned long long)ns);
+}
+
+static const char *item_name(uint16_t item) {
+  return item == SIM_NO_ITEM ? "kernel" : items[item].config->name;
+}
+
+static void print_step(const SimStep *step, uint64_t cause) {
+  static const char *const roles[] = {"sensor", "client", "server", "reply"};
+  const SimEvent *ev = &step->event;
+  char offset[32];
+  format_time(offset, sizeof(offset),
+              ev->time >= cause ? ev->time - cause : cause - ev->time);
+  printf("    %c%-12s ", ev->time >= cause ? '+' : '-', offset);
+  switch (ev->type) {
+  case SIM_EV_RAISE:
+    printf("irq %u raised (%s)\n", ev->arg, item_name(ev->item));
+    break;
+  case SIM_EV_COALESCE:
+    printf("irq %u raised, merged into pending (%s)\n", ev->arg,
+           item_name(ev->item));
+    break;
+  case SIM_EV_IRQ:
+    printf("irq %u taken (%s)\n", ev->arg, item_name(ev->item));
+    break;
+  case SIM_EV_LOST:
+    printf("irq %u message dropped, channel full (%s)\n", ev->arg,
+           item_name(ev->item));
+    break;
+  case SIM_EV_HELD:
+    printf("irq %u taken, held by its policy (%s)\n", ev->arg,
+           item_name(ev->item));
+    break;
+  case SIM_EV_STORM:
+    printf("irq %u storming, line masked (%s)\n", ev->arg,
+           item_name(ev->item));
+    break;
+  case SIM_EV_HANDLER:
+    printf("%s %s handler runs\n", item_name(ev->item), roles[ev->arg]);
+    break;
+  case SIM_EV_HANDLER_END:
+    printf("%s %s handler returns\n", item_name(ev->item), roles[ev->arg]);
+    break;
+  case SIM_EV_SYSCALL:
+    printf("%s syscall %u\n", item_name(ev->item), ev->arg);
+    break;
+  case SIM_EV_SWITCH: {
+    SimItem *hog = hog_for_thread(ev->arg);
+    printf("switch to thread %u (%s)\n", ev->arg,
+           hog ? hog->config->name
+               : ev->arg == WORKQUEUE_THREAD_ID_BASE ? "bottom halves"
+                                                     : "kernel");
+    break;
+  }
+  case SIM_EV_IDLE:
+    printf("cpu idle\n");
+    break;
+  case SIM_EV_BOTTOM_HALF:
+    printf("%s bottom half, %u merged interrupts\n", item_name(ev->item),
+           ev->arg);
+    break;
+  case SIM_EV_REPLY:
+    printf("%s reply %u received\n", item_name(ev->item), ev->arg);
+    break;
+  }
+  if (step->repeat > 1) {
+    format_time(offset, sizeof(offset), step->last - cause);
+    printf("    %-13s   ... %u times, the last at +%s\n", "", step->repeat,
+           offset);
+  }
+}
+
+static int report(const char *path) {
+  char a[32], b[32], c[32];
+  int missed = 0;
+  format_time(a, sizeof(a), scenario.duration_ns);
+  printf("scenario %s, seed %llu, %s simulated\n", path,
+         (unsigned long long)scenario.seed, a);
+  printf("\n%-28s %9s %12s %12s %12s %7s\n", "latency", "samples", "mean",
+         "max", "budget", "misses");
+  for (uint32_t i = 0; i < scenario.item_count; i++) {
+    SimItem *item = &items[i];
+    const char *what = item->config->kind == SCENARIO_SENSOR
+                           ? "irq_to_agent"
+                           : "request_reply";
+    if (item->config->kind != SCENARIO_SENSOR &&
+        item->config->kind != SCENARIO_REQUEST)
+      continue;
+    char name[64];
+    snprintf(name, sizeof(name), "%s.%s", item->config->name, what);
+    SimProbe *p = &item->probe;
+    format_time(a, sizeof(a), p->samples ? p->total_ns / p->samples : 0);
+    format_time(b, sizeof(b), p->max_ns);
+    if (item->config->budget_ns)
+      format_time(c, sizeof(c), item->config->budget_ns);
+    else
+      snprintf(c, sizeof(c), "-");
+    printf("%-28s %9llu %12s %12s %12s %7llu\n", name,
+           (unsigned long long)p->samples, a, b, c,
+           (unsigned long long)p->misses);
+    if (p->misses)
+      missed = 1;
+  }
+
+  HalSimStats hs;
+  hal_sim_query_stats(&hs);
+  WorkqueueStats ws;
+  workqueue_query_stats(0, &ws);
+  printf("\ninterrupts: %llu raised, %llu taken, %llu merged while pending\n",
+         (unsigned long long)hs.raised, (unsigned long long)hs.delivered,
+         (unsigned long long)hs.coalesced);
+  printf("bottom halves: %llu queued, %llu dropped, deepest queue %u\n",
+         (unsigned long long)ws.queued, (unsigned long long)ws.dropped,
+         ws.max_depth);
+  for (uint32_t i = 0; i < scenario.item_count; i++) {
+    const ScenarioItem *c = items[i].config;
+    IrqPolicyStats ps;
+    if ((c->coalesce || c->interval_ns || c->storm) &&
+        irq_policy_query_stats(c->line, &ps) == IRQ_POLICY_SUCCESS)
+      printf("%s policy: %llu interrupts in %llu deliveries, %u storms\n",
+             c->name, (unsigned long long)ps.events,
+             (unsigned long long)ps.deliveries, ps.storms);
+    if (items[i].lost)
+      printf("%s: %llu interrupts dropped on a full channel\n", c->name,
+             (unsigned long long)items[i].lost);
+  }
+
+  for (uint32_t i = 0; i < scenario.item_count; i++) {
+    SimProbe *p = &items[i].probe;
+    if (!p->samples)
+      continue;
+    format_time(a, sizeof(a), p->max_ns);
+    format_time(b, sizeof(b), p->worst_cause);
+    printf("\nworst case %s: %s, starting at t=%s\n", items[i].config->name,
+           a, b);
+    if (p->worst_lost)
+      printf("    (earlier events of this window are no longer traced)\n");
+    for (uint32_t e = 0; e < p->worst_count; e++) {
+      if (p->worst_elided && e == SIM_WORST_HEAD)
+        printf("    ... %u steps\n", p->worst_elided);
+      print_step(&p->worst[e], p->worst_cause);
+    }
+  }
+  return missed;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--seed N] [--duration T] SCENARIO\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  const char *seed = NULL;
+  const char *duration = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+      seed = argv[++i];
+    else if (!strcmp(argv[i], "--duration") && i + 1 < argc)
+      duration = argv[++i];
+    else if (argv[i][0] != '-' && !path)
+      path = argv[i];
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!path) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  char error[128];
+  if (scenario_load(path, &scenario, error, sizeof(error)) !=
+      SCENARIO_SUCCESS) {
+    fprintf(stderr, "latsim: %s\n", error);
+    return 2;
+  }
+  if (seed)
+    scenario.seed = strtoull(seed, NULL, 0);
+  if (duration && (!scenario_parse_time(duration, &scenario.duration_ns) ||
+                   scenario.duration_ns == 0)) {
+    fprintf(stderr, "latsim: bad duration '%s'\n", duration);
+    return 2;
+  }
+
+  // The clock runs simulated from the first kernel reading on, so boot
+  // and workload see the same timeline on every run
+  hal_clock_init_with_frequency(SIM_COUNTER_FREQUENCY);
+  if (hal_sim_start(HAL_SIM_MODE_MANUAL) != HAL_SIM_SUCCESS) {
+    fprintf(stderr, "latsim: cannot start the simulated HAL\n");
+    return 1;
+  }
+
+  void *memory = aligned_alloc(HAL_BLOCK_SIZE, SIM_KERNEL_MEMORY);
+  IntegratorContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.cpu_count = 1;
+  ctx.kernel_memory_base = (uint64_t)(uintptr_t)memory;
+  ctx.kernel_memory_limit = ctx.kernel_memory_base + SIM_KERNEL_MEMORY;
+  ctx.initial_agent_id = 1;
+  ctx.initial_thread_id = 1;
+  IntegratorTransaction boot;
+  memset(&boot, 0, sizeof(boot));
+  if (memory)
+    integrator_boot(&ctx, &boot);
+  if (!memory || boot.status_code != INTEGRATOR_STATUS_OK) {
+    fprintf(stderr, "latsim: kernel boot failed\n");
+    return 1;
+  }
+
+  memset(line_items, 0xFF, sizeof(line_items));
+  uint32_t next_agent = SIM_AGENT_BASE;
+  for (uint32_t i = 0; i < scenario.item_count; i++) {
+    items[i].config = &scenario.items[i];
+    items[i].index = i;
+    if (setup_item(&items[i], &next_agent) != 0) {
+      fprintf(stderr,
+              "latsim: cannot set up '%s' (line taken, or the tick line)\n",
+              scenario.items[i].name);
+      return 1;
+    }
+  }
+
+  hal_sim_set_trace(on_controller_event);
+  run(hal_sim_now() + scenario.duration_ns);
+  hal_sim_set_trace(NULL);
+  hal_sim_stop();
+
+  return report(path) ? SIM_EXIT_BUDGET_MISSED : 0;
+}
@@ -0,0 +1,228 @@
+#include "scenario.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENARIO_LINE_SIZE 256
+
+// Defaults: a 1 ms tick machine with costs in the range of the host
+// microbenchmarks
+static const ScenarioCosts default_costs = {
+    .irq_ns = 2000,
+    .syscall_ns = 1000,
+    .dispatch_ns = 500,
+    .switch_ns = 2000,
+    .quantum_ns = 1000000,
+};
+
+static int fail(char *error, uint32_t size, uint32_t line, const char *fmt,
+                ...) {
+  if (error && size) {
+    int n = snprintf(error, size, "line %u: ", line);
+    va_list ap;
+    va_start(ap, fmt);
+    if (n >= 0 && (uint32_t)n < size)
+      vsnprintf(error + n, size - n, fmt, ap);
+    va_end(ap);
+  }
+  return SCENARIO_ERR_SYNTAX;
+}
+
+static int parse_u64(const char *text, uint64_t *out) {
+  char *end;
+  if (!*text)
+    return 0;
+  *out = strtoull(text, &end, 0);
+  return *end == '\0';
+}
+
+// Accepts <number><ns|us|ms|s>
+int scenario_parse_time(const char *text, uint64_t *out) {
+  char *end;
+  if (!*text)
+    return 0;
+  uint64_t value = strtoull(text, &end, 10);
+  uint64_t scale;
+  if (!strcmp(end, "ns"))
+    scale = 1;
+  else if (!strcmp(end, "us"))
+    scale = 1000;
+  else if (!strcmp(end, "ms"))
+    scale = 1000000;
+  else if (!strcmp(end, "s"))
+    scale = 1000000000;
+  else
+    return 0;
+  *out = value * scale;
+  return 1;
+}
+
+static int parse_kind(const char *word, uint32_t *kind) {
+  static const char *const names[] = {"sensor", "request", "noise", "hog"};
+  for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (!strcmp(word, names[i])) {
+      *kind = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Applies one key=value of an item line
+static int parse_item_field(ScenarioItem *item, const char *key,
+                            const char *value) {
+  uint64_t n;
+  if (!strcmp(key, "line"))
+    return parse_u64(value, &n) && (item->line = (uint32_t)n, 1);
+  if (!strcmp(key, "period"))
+    return scenario_parse_time(value, &item->period_ns);
+  if (!strcmp(key, "jitter"))
+    return scenario_parse_time(value, &item->jitter_ns);
+  if (!strcmp(key, "gap"))
+    return scenario_parse_time(value, &item->burst_gap_ns);
+  if (!strcmp(key, "burst"))
+    return parse_u64(value, &n) && (item->burst_count = (uint32_t)n, 1);
+  if (!strcmp(key, "work"))
+    return scenario_parse_time(value, &item->work_ns);
+  if (!strcmp(key, "budget"))
+    return scenario_parse_time(value, &item->budget_ns);
+  if (!strcmp(key, "seed"))
+    return parse_u64(value, &item->seed);
+  if (!strcmp(key, "priority"))
+    return parse_u64(value, &n) && (item->priority = (uint32_t)n, 1);
+  if (!strcmp(key, "share"))
+    return parse_u64(value, &n) && (item->share = (uint32_t)n, 1);
+  if (!strcmp(key, "coalesce"))
+    return parse_u64(value, &n) && (item->coalesce = (uint32_t)n, 1);
+  if (!strcmp(key, "interval"))
+    return scenario_parse_time(value, &item->interval_ns);
+  if (!strcmp(key, "storm"))
+    return parse_u64(value, &n) && (item->storm = (uint32_t)n, 1);
+  if (!strcmp(key, "window"))
+    return scenario_parse_time(value, &item->window_ns);
+  if (!strcmp(key, "backoff"))
+    return scenario_parse_time(value, &item->backoff_ns);
+  return 0;
+}
+
+static int parse_item(Scenario *sc, uint32_t kind, char *save, char *error,
+                      uint32_t size, uint32_t lineno) {
+  if (sc->item_count >= SCENARIO_MAX_ITEMS)
+    return fail(error, size, lineno, "more than %u items",
+                SCENARIO_MAX_ITEMS);
+
+  ScenarioItem *item = &sc->items[sc->item_count];
+  memset(item, 0, sizeof(*item));
+  item->kind = kind;
+  item->share = 1000;
+
+  char *name = strtok_r(NULL, " \t", &save);
+  if (!name || strchr(name, '='))
+    return fail(error, size, lineno, "missing item name");
+  snprintf(item->name, sizeof(item->name), "%s", name);
+
+  for (char *tok = strtok_r(NULL, " \t", &save); tok;
+       tok = strtok_r(NULL, " \t", &save)) {
+    char *eq = strchr(tok, '=');
+    if (!eq)
+      return fail(error, size, lineno, "expected key=value, got '%s'", tok);
+    *eq = '\0';
+    if (!parse_item_field(item, tok, eq + 1))
+      return fail(error, size, lineno, "bad value for '%s'", tok);
+  }
+
+  if (kind != SCENARIO_HOG) {
+    if (item->period_ns == 0)
+      return fail(error, size, lineno, "'%s' needs period=", item->name);
+    if (item->jitter_ns >= item->period_ns)
+      return fail(error, size, lineno, "jitter must be below period");
+    if (item->burst_count && (item->burst_gap_ns == 0 || item->jitter_ns))
+      return fail(error, size, lineno, "burst needs gap= and no jitter");
+    if (item->storm && (item->window_ns == 0 || item->backoff_ns == 0))
+      return fail(error, size, lineno, "storm needs window= and backoff=");
+  }
+  if (item->share == 0 || item->share > 1000)
+    return fail(error, size, lineno, "share must be 1..1000");
+  sc->item_count++;
+  return SCENARIO_SUCCESS;
+}
+
+static int parse_cost(Scenario *sc, char *save, char *error, uint32_t size,
+                      uint32_t lineno) {
+  char *which = strtok_r(NULL, " \t", &save);
+  char *value = strtok_r(NULL, " \t", &save);
+  uint64_t *target = NULL;
+  if (!which || !value)
+    return fail(error, size, lineno, "cost needs a name and a time");
+  if (!strcmp(which, "irq"))
+    target = &sc->costs.irq_ns;
+  else if (!strcmp(which, "syscall"))
+    target = &sc->costs.syscall_ns;
+  else if (!strcmp(which, "dispatch"))
+    target = &sc->costs.dispatch_ns;
+  else if (!strcmp(which, "switch"))
+    target = &sc->costs.switch_ns;
+  else if (!strcmp(which, "quantum"))
+    target = &sc->costs.quantum_ns;
+  else
+    return fail(error, size, lineno, "unknown cost '%s'", which);
+  if (!scenario_parse_time(value, target))
+    return fail(error, size, lineno, "bad time '%s'", value);
+  if (target == &sc->costs.quantum_ns && *target == 0)
+    return fail(error, size, lineno, "quantum must be non-zero");
+  return SCENARIO_SUCCESS;
+}
+
+int scenario_load(const char *path, Scenario *sc, char *error,
+                  uint32_t error_size) {
+  if (!path || !sc)
+    return SCENARIO_ERR_INVALID_PARAM;
+
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    if (error && error_size)
+      snprintf(error, error_size, "cannot open %s", path);
+    return SCENARIO_ERR_INVALID_PARAM;
+  }
+
+  memset(sc, 0, sizeof(*sc));
+  sc->seed = 1;
+  sc->duration_ns = 100000000; // 100 ms
+  sc->costs = default_costs;
+
+  char text[SCENARIO_LINE_SIZE];
+  uint32_t lineno = 0;
+  int res = SCENARIO_SUCCESS;
+  while (res == SCENARIO_SUCCESS && fgets(text, sizeof(text), f)) {
+    lineno++;
+    char *hash = strchr(text, '#');
+    if (hash)
+      *hash = '\0';
+    text[strcspn(text, "\r\n")] = '\0';
+
+    char *save;
+    char *word = strtok_r(text, " \t", &save);
+    uint32_t kind;
+    if (!word)
+      continue;
+    if (!strcmp(word, "seed")) {
+      char *value = strtok_r(NULL, " \t", &save);
+      if (!value || !parse_u64(value, &sc->seed))
+        res = fail(error, error_size, lineno, "seed needs a number");
+    } else if (!strcmp(word, "duration")) {
+      char *value = strtok_r(NULL, " \t", &save);
+      if (!value || !scenario_parse_time(value, &sc->duration_ns) ||
+          sc->duration_ns == 0)
+        res = fail(error, error_size, lineno, "duration needs a time");
+    } else if (!strcmp(word, "cost")) {
+      res = parse_cost(sc, save, error, error_size, lineno);
+    } else if (parse_kind(word, &kind)) {
+      res = parse_item(sc, kind, save, error, error_size, lineno);
+    } else {
+      res = fail(error, error_size, lineno, "unknown directive '%s'", word);
+    }
+  }
+  fclose(f);
+  return res;
+}
@@ -0,0 +1,86 @@
+#ifndef SIMPLEOS_SCENARIO_H
+#define SIMPLEOS_SCENARIO_H
+
+#include <stdint.h>
+
+// Status Codes
+#define SCENARIO_SUCCESS 0
+#define SCENARIO_ERR_INVALID_PARAM -1
+#define SCENARIO_ERR_NO_SPACE -2
+#define SCENARIO_ERR_SYNTAX -3
+
+#define SCENARIO_MAX_ITEMS 14 // hal_sim sources left beside the tick
+#define SCENARIO_NAME_SIZE 24
+
+// Workload items
+#define SCENARIO_SENSOR 0  // Bound IRQ line -> event-handler agent
+#define SCENARIO_REQUEST 1 // Timer-driven client -> server -> reply
+#define SCENARIO_NOISE 2   // Unbound IRQ line, optional bottom half
+#define SCENARIO_HOG 3     // CPU-bound thread agent
+
+// One line of the script. Times are simulated nanoseconds.
+typedef struct {
+  uint32_t kind;
+  char name[SCENARIO_NAME_SIZE];
+  uint32_t line;        // IRQ line driving the item (not for hogs)
+  uint32_t burst_count; // Noise bursts, 0 for none
+  uint64_t period_ns;
+  uint64_t jitter_ns;
+  uint64_t burst_gap_ns;
+  uint64_t seed;      // Generator seed, 0 derives one from the run seed
+  uint64_t work_ns;   // Handler, server or bottom-half work per event
+  uint64_t budget_ns; // Latency budget, 0 for none
+  uint32_t priority;  // Hog thread priority
+  uint32_t share;     // Hog agent CPU share, permille
+  // Delivery policy of the item's line, see IrqPolicy; all 0 for none
+  uint32_t coalesce;    // Deliver after this many events
+  uint32_t storm;       // Interrupts per window that mask the line
+  uint64_t interval_ns; // Deliver at most once per interval
+  uint64_t window_ns;   // Storm detection window
+  uint64_t backoff_ns;  // Initial storm mask duration
+} ScenarioItem;
+
+// Modelled costs. Kernel code runs in zero simulated time, so every
+// kernel path the workload crosses is charged one of these.
+typedef struct {
+  uint64_t irq_ns;      // Interrupt entry and top half
+  uint64_t syscall_ns;  // Syscall trap round trip
+  uint64_t dispatch_ns; // Event handler invocation
+  uint64_t switch_ns;   // Thread context switch
+  uint64_t quantum_ns;  // Thread run before the next scheduling point
+} ScenarioCosts;
+
+typedef struct {
+  uint64_t seed;
+  uint64_t duration_ns;
+  ScenarioCosts costs;
+  uint32_t item_count;
+  ScenarioItem items[SCENARIO_MAX_ITEMS];
+} Scenario;
+
+/**
+ * @brief Parses a workload script.
+ *
+ * One directive per line, '#' starts a comment. Times take an ns, us,
+ * ms or s suffix.
+ *
+ *   seed 42
+ *   duration 200ms
+ *   cost irq|syscall|dispatch|switch|quantum <time>
+ *   sensor <name> line=N period=T [jitter=T] [work=T] [budget=T]
+ *   request <name> line=N period=T [jitter=T] [work=T] [budget=T]
+ *   noise <name> line=N period=T [jitter=T] [burst=N gap=T] [work=T]
+ *   hog <name> [priority=N] [share=N]
+ *
+ * Items driven by a line also take seed=N for their generator, and a
+ * delivery policy for it: [coalesce=N] [interval=T] and
+ * [storm=N window=T backoff=T].
+ *
+ * @param error Receives "line N: reason" on failure.
+ */
+int scenario_load(const char *path, Scenario *scenario, char *error,
+                  uint32_t error_size);
+// Parses <number><ns|us|ms|s>; returns 1 on success
+int scenario_parse_time(const char *text, uint64_t *out);
+
+#endif // SIMPLEOS_SCENARIO_H
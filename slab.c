@@ -0,0 +1,166 @@
+#include "slab.h"
+#include "frames.h"
+#include "init_once.h"
+#include "percpu.h"
+#include <string.h>
+
+#define SLAB_SIZE_CLASSES 7 // 32 .. 2048 bytes
+#define SLAB_SMALLEST_CLASS_SHIFT 5
+
+static SlabCache *cache_registry[SLAB_MAX_CACHES];
+static uint32_t cache_count = 0;
+static int registry_lock = 0;
+
+static SlabCache byte_caches[SLAB_SIZE_CLASSES];
+static const char *byte_cache_names[SLAB_SIZE_CLASSES] = {
+    "bytes-32",  "bytes-64",   "bytes-128", "bytes-256",
+    "bytes-512", "bytes-1024", "bytes-2048"};
+static int initialized = 0;
+
+static void spin_lock(int *lock) {
+  while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE))
+    ;
+}
+
+static void spin_unlock(int *lock) { __atomic_clear(lock, __ATOMIC_RELEASE); }
+
+static void ensure_initialized() {
+  if (init_once_begin(&initialized)) {
+    for (uint32_t i = 0; i < SLAB_SIZE_CLASSES; i++)
+      slab_cache_init(&byte_caches[i], byte_cache_names[i],
+                      1u << (SLAB_SMALLEST_CLASS_SHIFT + i));
+    init_once_end(&initialized);
+  }
+}
+
+// Caller holds the cache lock
+static int grow_cache(SlabCache *cache) {
+  uint64_t page;
+  if (frames_alloc_page(percpu_cpu_id(), &page) != FRAMES_SUCCESS)
+    return 0;
+  cache->carve = (uint8_t *)(uintptr_t)page;
+  cache->carve_end =
+      cache->carve + (HAL_PAGE_SIZE / cache->stats.object_size) *
+                         cache->stats.object_size;
+  cache->stats.slabs++;
+  cache->stats.objects_free += HAL_PAGE_SIZE / cache->stats.object_size;
+  return 1;
+}
+
+int slab_cache_init(SlabCache *cache, const char *name, uint32_t object_size) {
+  if (!cache || !name || object_size == 0 ||
+      object_size > SLAB_MAX_OBJECT_SIZE)
+    return SLAB_ERR_INVALID_PARAM;
+
+  memset(cache, 0, sizeof(*cache));
+  strncpy(cache->stats.name, name, SLAB_NAME_LENGTH - 1);
+  cache->stats.object_size = (object_size + SLAB_MIN_OBJECT_SIZE - 1) &
+                             ~(uint32_t)(SLAB_MIN_OBJECT_SIZE - 1);
+
+  spin_lock(&registry_lock);
+  uint32_t i = 0;
+  while (i < cache_count && cache_registry[i] != cache)
+    i++;
+  if (i == cache_count && cache_count < SLAB_MAX_CACHES)
+    cache_registry[cache_count++] = cache;
+  spin_unlock(&registry_lock);
+  return SLAB_SUCCESS;
+}
+
+int slab_alloc(SlabCache *cache, void **object) {
+  if (!cache || !object || cache->stats.object_size == 0)
+    return SLAB_ERR_INVALID_PARAM;
+
+  spin_lock(&cache->lock);
+  void *obj = cache->free_list;
+  if (obj) {
+    cache->free_list = *(void **)obj;
+  } else {
+    if (cache->carve == cache->carve_end && !grow_cache(cache)) {
+      cache->stats.failures++;
+      spin_unlock(&cache->lock);
+      return SLAB_ERR_OUT_OF_MEMORY;
+    }
+    obj = cache->carve;
+    cache->carve += cache->stats.object_size;
+  }
+
+  cache->stats.objects_free--;
+  cache->stats.allocations++;
+  if (++cache->stats.objects_in_use > cache->stats.high_water)
+    cache->stats.high_water = cache->stats.objects_in_use;
+  spin_unlock(&cache->lock);
+
+  *object = obj;
+  return SLAB_SUCCESS;
+}
+
+int slab_free(SlabCache *cache, void *object) {
+  if (!cache || !object)
+    return SLAB_ERR_INVALID_PARAM;
+
+  spin_lock(&cache->lock);
+  if (cache->stats.objects_in_use == 0) {
+    spin_unlock(&cache->lock);
+    return SLAB_ERR_NOT_FOUND;
+  }
+  *(void **)object = cache->free_list;
+  cache->free_list = object;
+  cache->stats.objects_in_use--;
+  cache->stats.objects_free++;
+  cache->stats.frees++;
+  spin_unlock(&cache->lock);
+  return SLAB_SUCCESS;
+}
+
+static SlabCache *byte_cache_for(uint32_t size) {
+  uint32_t index = 0;
+  while ((1u << (SLAB_SMALLEST_CLASS_SHIFT + index)) < size)
+    index++;
+  return &byte_caches[index];
+}
+
+int slab_alloc_bytes(uint32_t size, void **buffer) {
+  ensure_initialized();
+  if (size == 0 || !buffer)
+    return SLAB_ERR_INVALID_PARAM;
+
+  if (size > SLAB_MAX_OBJECT_SIZE) {
+    uint64_t addr;
+    if (frames_alloc_exact(size, &addr) != FRAMES_SUCCESS)
+      return SLAB_ERR_OUT_OF_MEMORY;
+    *buffer = (void *)(uintptr_t)addr;
+    return SLAB_SUCCESS;
+  }
+  return slab_alloc(byte_cache_for(size), buffer);
+}
+
+int slab_free_bytes(void *buffer, uint32_t size) {
+  ensure_initialized();
+  if (size == 0 || !buffer)
+    return SLAB_ERR_INVALID_PARAM;
+
+  if (size > SLAB_MAX_OBJECT_SIZE)
+    return frames_free_exact((uint64_t)(uintptr_t)buffer, size) ==
+                   FRAMES_SUCCESS
+               ? SLAB_SUCCESS
+               : SLAB_ERR_NOT_FOUND;
+  return slab_free(byte_cache_for(size), buffer);
+}
+
+int slab_query_stats(uint32_t index, SlabStats *stats) {
+  ensure_initialized();
+  if (!stats)
+    return SLAB_ERR_INVALID_PARAM;
+
+  spin_lock(&registry_lock);
+  SlabCache *cache = index < cache_count ? cache_registry[index] : NULL;
+  spin_unlock(&registry_lock);
+  if (!cache)
+    return SLAB_ERR_NOT_FOUND;
+
+  spin_lock(&cache->lock);
+  *stats = cache->stats;
+  spin_unlock(&cache->lock);
+  return SLAB_SUCCESS;
+}
@@ -0,0 +1,55 @@
+#ifndef SIMPLEOS_SLAB_H
+#define SIMPLEOS_SLAB_H
+
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define SLAB_SUCCESS 0
+#define SLAB_ERR_INVALID_PARAM -1
+#define SLAB_ERR_OUT_OF_MEMORY -2
+#define SLAB_ERR_NOT_FOUND -5
+
+#define SLAB_MAX_CACHES 32
+#define SLAB_MIN_OBJECT_SIZE 16 // Objects are 16-byte aligned
+#define SLAB_MAX_OBJECT_SIZE (HAL_PAGE_SIZE / 2)
+#define SLAB_NAME_LENGTH 24
+
+typedef struct {
+  char name[SLAB_NAME_LENGTH];
+  uint32_t object_size;    // Rounded up to SLAB_MIN_OBJECT_SIZE
+  uint32_t objects_in_use;
+  uint32_t objects_free;   // Free list plus the uncarved slab tail
+  uint32_t slabs;          // Pages backing the cache
+  uint32_t high_water;     // Peak objects_in_use
+  uint32_t reserved;
+  uint64_t allocations;
+  uint64_t frees;
+  uint64_t failures;
+} SlabStats;
+
+// Typed cache of fixed-size objects, each slab one page from the frame
+// allocator. Alloc pops the free list or carves the current slab, free
+// pushes onto the free list; both are O(1). Pages stay with the cache.
+typedef struct {
+  SlabStats stats;
+  void *free_list;   // Freed objects, linked through their first word
+  uint8_t *carve;    // Next uncarved object in the newest slab
+  uint8_t *carve_end;
+  int lock;
+} SlabCache;
+
+int slab_cache_init(SlabCache *cache, const char *name, uint32_t object_size);
+int slab_alloc(SlabCache *cache, void **object);
+int slab_free(SlabCache *cache, void *object);
+
+// Byte buffers: power-of-two size classes from 32 bytes to
+// SLAB_MAX_OBJECT_SIZE, whole frames above that. size must match on free.
+int slab_alloc_bytes(uint32_t size, void **buffer);
+int slab_free_bytes(void *buffer, uint32_t size);
+
+// Every initialized cache in registration order, for usage reporting
+int slab_query_stats(uint32_t index, SlabStats *stats);
+
+#endif // SIMPLEOS_SLAB_H
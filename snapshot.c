@@ -0,0 +1,302 @@
+#include "snapshot.h"
+#include "agents.h"
+#include "hal.h"
+#include "hal_clock.h"
+#include "init_once.h"
+#include "ipc.h"
+#include "threads.h"
+#include <string.h>
+#if SIMPLEOS_HAL_SIM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+// Images from another build may hold entry points that no longer exist
+#ifndef SIMPLEOS_BUILD_ID
+#define SIMPLEOS_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+#define SNAPSHOT_SLOTS 2
+
+static uint32_t crc_table[256];
+static uint32_t build_id = 0;
+static int initialized = 0;
+
+// Reads crc_table, which ensure_initialized fills before its own call
+static uint32_t crc32_bytes(const void *data, uint64_t length) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t crc = 0xFFFFFFFFu;
+#if defined(__ARM_FEATURE_CRC32)
+  for (; length >= 8; p += 8, length -= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc = __crc32d(crc, word);
+  }
+  for (; length; p++, length--)
+    crc = __crc32b(crc, *p);
+#else
+  for (; length; p++, length--)
+    crc = (crc >> 8) ^ crc_table[(crc ^ *p) & 0xFF];
+#endif
+  return ~crc;
+}
+
+static void ensure_initialized() {
+  if (init_once_begin(&initialized)) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+      crc_table[i] = crc;
+    }
+    build_id = crc32_bytes(SIMPLEOS_BUILD_ID, sizeof(SIMPLEOS_BUILD_ID));
+    init_once_end(&initialized);
+  }
+}
+
+uint32_t snapshot_crc32(const void *data, uint64_t length) {
+  ensure_initialized();
+  return crc32_bytes(data, length);
+}
+
+/**
+ * @brief Makes a written range durable across a warm reset.
+ *
+ * Retained RAM keeps its contents through reset, but dirty cache lines do
+ * not, so the target cleans them to the point of coherency. On the host
+ * the region is a file mapping and is synced to the file.
+ */
+static void persist(const void *addr, uint64_t length) {
+#if SIMPLEOS_HAL_SIM
+  uintptr_t page = (uintptr_t)addr & ~(uintptr_t)(HAL_PAGE_SIZE - 1);
+  // Fails harmlessly when the region is ordinary memory
+  msync((void *)page, length + ((uintptr_t)addr - page), MS_SYNC);
+#elif defined(__aarch64__)
+  for (uintptr_t line = (uintptr_t)addr & ~(uintptr_t)63;
+       line < (uintptr_t)addr + length; line += 64)
+    __asm__ volatile("dc cvac, %0" : : "r"(line) : "memory");
+  __asm__ volatile("dsb sy" : : : "memory");
+#endif
+}
+
+static uint64_t slot_size(uint64_t size) {
+  return (size / SNAPSHOT_SLOTS) & ~(uint64_t)7;
+}
+
+static uintptr_t entry_anchor(void) { return (uintptr_t)&snapshot_save; }
+
+/**
+ * @brief Checks one slot.
+ * @return SNAPSHOT_SUCCESS with *header filled, SNAPSHOT_ERR_NOT_FOUND for
+ *         an empty slot, or the reason the image cannot be used.
+ */
+static int check_slot(const uint8_t *slot, uint64_t room,
+                      SnapshotHeader *header) {
+  memcpy(header, slot, sizeof(*header));
+  if (header->magic != SNAPSHOT_MAGIC)
+    return SNAPSHOT_ERR_NOT_FOUND;
+  if (header->header_crc !=
+      snapshot_crc32(header, offsetof(SnapshotHeader, header_crc)))
+    return SNAPSHOT_ERR_CORRUPT;
+  if (header->version != SNAPSHOT_VERSION || header->build_id != build_id)
+    return SNAPSHOT_ERR_MISMATCH;
+
+  uint64_t records =
+      (uint64_t)header->agent_count * sizeof(AgentDescriptor) +
+      (uint64_t)header->channel_count * sizeof(ChannelDescriptor) +
+      (uint64_t)header->thread_count * sizeof(ThreadDescriptor);
+  if (header->body_size != records ||
+      header->body_size > room - sizeof(SnapshotHeader))
+    return SNAPSHOT_ERR_CORRUPT;
+  if (header->body_crc !=
+      snapshot_crc32(slot + sizeof(SnapshotHeader), header->body_size))
+    return SNAPSHOT_ERR_CORRUPT;
+  return SNAPSHOT_SUCCESS;
+}
+
+/**
+ * @brief Picks the newest valid slot.
+ * @return Slot index, or -1 with *error set to the most telling failure.
+ */
+static int find_newest(const void *region, uint64_t size,
+                       SnapshotHeader *newest, int *error) {
+  uint64_t room = slot_size(size);
+  int found = -1;
+  *error = SNAPSHOT_ERR_NOT_FOUND;
+  for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+    SnapshotHeader header;
+    int result =
+        check_slot((const uint8_t *)region + i * room, room, &header);
+    if (result == SNAPSHOT_SUCCESS) {
+      if (found < 0 || header.sequence > newest->sequence) {
+        *newest = header;
+        found = i;
+      }
+    } else if (result != SNAPSHOT_ERR_NOT_FOUND) {
+      *error = result;
+    }
+  }
+  return found;
+}
+
+int snapshot_save(void *region, uint64_t size, SnapshotHeader *info) {
+  ensure_initialized();
+  uint64_t room = slot_size(size);
+  if (!region || room <= sizeof(SnapshotHeader))
+    return SNAPSHOT_ERR_INVALID_PARAM;
+
+  SnapshotHeader newest;
+  int error;
+  int previous = find_newest(region, size, &newest, &error);
+  int slot = previous == 0 ? 1 : 0;
+  uint8_t *base = (uint8_t *)region + slot * room;
+
+  // The slot stops validating before any record in it changes
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(base, &header, sizeof(header));
+  persist(base, sizeof(header));
+
+  uint8_t *cursor = base + sizeof(SnapshotHeader);
+  uint8_t *end = base + room;
+
+  agent_export_config((AgentDescriptor *)cursor,
+                      (uint32_t)((end - cursor) / sizeof(AgentDescriptor)),
+                      &header.agent_count);
+  if (header.agent_count > (end - cursor) / sizeof(AgentDescriptor))
+    return SNAPSHOT_ERR_NO_SPACE;
+  cursor += header.agent_count * sizeof(AgentDescriptor);
+
+  ipc_export_channels(
+      (ChannelDescriptor *)cursor,
+      (uint32_t)((end - cursor) / sizeof(ChannelDescriptor)),
+      &header.channel_count);
+  if (header.channel_count > (end - cursor) / sizeof(ChannelDescriptor))
+    return SNAPSHOT_ERR_NO_SPACE;
+  cursor += header.channel_count * sizeof(ChannelDescriptor);
+
+  ThreadDescriptor *threads = (ThreadDescriptor *)cursor;
+  thread_export_descriptors(
+      threads, (uint32_t)((end - cursor) / sizeof(ThreadDescriptor)),
+      &header.thread_count);
+  if (header.thread_count > (end - cursor) / sizeof(ThreadDescriptor))
+    return SNAPSHOT_ERR_NO_SPACE;
+  for (uint32_t i = 0; i < header.thread_count; i++)
+    if (threads[i].entry_point)
+      threads[i].entry_point =
+          (void *)((uintptr_t)threads[i].entry_point - entry_anchor());
+  cursor += header.thread_count * sizeof(ThreadDescriptor);
+
+  HalClockParams clock;
+  hal_clock_get_params(&clock);
+
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = SNAPSHOT_VERSION;
+  header.sequence = previous < 0 ? 1 : newest.sequence + 1;
+  header.build_id = build_id;
+  header.body_size = (uint32_t)(cursor - (base + sizeof(SnapshotHeader)));
+  header.body_crc =
+      snapshot_crc32(base + sizeof(SnapshotHeader), header.body_size);
+  header.counter_frequency = clock.frequency;
+  header.header_crc =
+      snapshot_crc32(&header, offsetof(SnapshotHeader, header_crc));
+
+  // Records must be durable before the header that vouches for them
+  persist(base + sizeof(SnapshotHeader), header.body_size);
+  memcpy(base, &header, sizeof(header));
+  persist(base, sizeof(header));
+
+  if (info)
+    *info = header;
+  return SNAPSHOT_SUCCESS;
+}
+
+int snapshot_inspect(const void *region, uint64_t size, SnapshotHeader *info) {
+  ensure_initialized();
+  if (!region || slot_size(size) <= sizeof(SnapshotHeader))
+    return SNAPSHOT_ERR_INVALID_PARAM;
+
+  SnapshotHeader newest;
+  int error;
+  if (find_newest(region, size, &newest, &error) < 0)
+    return error;
+  if (info)
+    *info = newest;
+  return SNAPSHOT_SUCCESS;
+}
+
+int snapshot_restore(const void *region, uint64_t size) {
+  ensure_initialized();
+  if (!region || slot_size(size) <= sizeof(SnapshotHeader))
+    return SNAPSHOT_ERR_INVALID_PARAM;
+
+  SnapshotHeader header;
+  int error;
+  int slot = find_newest(region, size, &header, &error);
+  if (slot < 0)
+    return error;
+  const uint8_t *cursor =
+      (const uint8_t *)region + slot * slot_size(size) + sizeof(header);
+
+  // Quotas first, so the stacks of restored threads are charged under them
+  const AgentDescriptor *agents = (const AgentDescriptor *)cursor;
+  for (uint32_t i = 0; i < header.agent_count; i++) {
+    AgentDescriptor agent = agents[i];
+    if (agent_configure(&agent, NULL) != AGENT_SUCCESS)
+      return SNAPSHOT_ERR_CONFLICT;
+  }
+  cursor += header.agent_count * sizeof(AgentDescriptor);
+
+  // Channels and threads the kernel recreated during boot are kept
+  const ChannelDescriptor *channels = (const ChannelDescriptor *)cursor;
+  for (uint32_t i = 0; i < header.channel_count; i++) {
+    ChannelDescriptor channel = channels[i];
+    int result = ipc_channel_create(&channel, NULL);
+    if (result != IPC_SUCCESS && result != IPC_ERR_PERMISSION_DENIED)
+      return SNAPSHOT_ERR_CONFLICT;
+  }
+  cursor += header.channel_count * sizeof(ChannelDescriptor);
+
+  const ThreadDescriptor *threads = (const ThreadDescriptor *)cursor;
+  for (uint32_t i = 0; i < header.thread_count; i++) {
+    ThreadDescriptor thread = threads[i];
+    if (thread.entry_point)
+      thread.entry_point =
+          (void *)((uintptr_t)thread.entry_point + entry_anchor());
+    int result = create_thread(&thread, NULL);
+    if (result != THREAD_SUCCESS && result != THREAD_ERR_PERMISSION_DENIED)
+      return SNAPSHOT_ERR_CONFLICT;
+  }
+  return SNAPSHOT_SUCCESS;
+}
+
+#if SIMPLEOS_HAL_SIM
+int snapshot_map_file(const char *path, uint64_t size, void **region) {
+  if (!path || !region || size == 0)
+    return SNAPSHOT_ERR_INVALID_PARAM;
+
+  int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+    return SNAPSHOT_ERR_NOT_FOUND;
+  // Grows a new file with zeros; an existing image is kept
+  if (ftruncate(fd, (off_t)size) != 0) {
+    close(fd);
+    return SNAPSHOT_ERR_NO_SPACE;
+  }
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return SNAPSHOT_ERR_NO_SPACE;
+  *region = mapping;
+  return SNAPSHOT_SUCCESS;
+}
+
+void snapshot_unmap_file(void *region, uint64_t size) {
+  if (region)
+    munmap(region, size);
+}
+#endif
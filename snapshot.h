@@ -0,0 +1,57 @@
+#ifndef SIMPLEOS_SNAPSHOT_H
+#define SIMPLEOS_SNAPSHOT_H
+
+#include "hal_sim.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define SNAPSHOT_SUCCESS 0
+#define SNAPSHOT_ERR_INVALID_PARAM -1
+#define SNAPSHOT_ERR_NO_SPACE -2
+#define SNAPSHOT_ERR_CORRUPT -3  // Checksum or size does not add up
+#define SNAPSHOT_ERR_CONFLICT -4 // Restored object could not be created
+#define SNAPSHOT_ERR_NOT_FOUND -5
+#define SNAPSHOT_ERR_MISMATCH -9 // Written by another build or version
+
+#define SNAPSHOT_MAGIC 0x50414E53u // "SNAP"
+#define SNAPSHOT_VERSION 1
+// Two slots, each large enough for full channel, thread and agent tables
+#define SNAPSHOT_REGION_SIZE (128 * 1024)
+
+// Image layout: header, then agent, channel and thread records in the
+// order a restore replays them (AgentDescriptor, ChannelDescriptor,
+// ThreadDescriptor arrays). Thread entry points are stored relative to
+// the kernel image so they survive relocation.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sequence;  // Newer images have higher sequence numbers
+  uint32_t build_id;  // CRC32 of SIMPLEOS_BUILD_ID
+  uint32_t body_size; // Bytes of records after the header
+  uint32_t body_crc;
+  uint32_t agent_count;
+  uint32_t channel_count;
+  uint32_t thread_count;
+  uint64_t counter_frequency; // Calibrated clock, reused on warm boot
+  uint32_t header_crc;        // CRC32 of the fields above
+  uint32_t reserved;
+} SnapshotHeader;
+
+// The region is split into two slots. A save overwrites the older one and
+// writes its header last, so a save torn by power loss leaves the
+// previous image intact.
+int snapshot_save(void *region, uint64_t size, SnapshotHeader *info);
+// Finds the newest valid image; info may be NULL
+int snapshot_inspect(const void *region, uint64_t size, SnapshotHeader *info);
+// Replays the newest valid image into the agent, IPC and thread tables
+int snapshot_restore(const void *region, uint64_t size);
+uint32_t snapshot_crc32(const void *data, uint64_t length);
+
+#if SIMPLEOS_HAL_SIM
+// Host stand-in for a retained memory region: a shared file mapping
+int snapshot_map_file(const char *path, uint64_t size, void **region);
+void snapshot_unmap_file(void *region, uint64_t size);
+#endif
+
+#endif // SIMPLEOS_SNAPSHOT_H
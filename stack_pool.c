@@ -0,0 +1,173 @@
+#include "stack_pool.h"
+#include <string.h>
+
+typedef struct {
+  uint64_t committed_floor; // Lowest mapped stack address (grows down)
+  int in_use;
+} StackSlot;
+
+static StackSlot slot_table[STACK_POOL_MAX_SLOTS];
+// LIFO of free slot indices: the most recently released stack is reused
+// first, while its pages are still committed and cache-warm.
+static uint32_t free_slots[STACK_POOL_MAX_SLOTS];
+static uint32_t free_count = 0;
+static uint32_t slot_count = 0;
+static uint64_t pool_base = 0;
+static HardwareContext pool_hw_context;
+// Guards the free list; threads are created and reaped on every CPU
+static int pool_lock = 0;
+
+static void lock_pool(void) {
+  while (__atomic_test_and_set(&pool_lock, __ATOMIC_ACQUIRE))
+    ;
+}
+
+static void unlock_pool(void) {
+  __atomic_clear(&pool_lock, __ATOMIC_RELEASE);
+}
+
+static uint64_t slot_base(uint32_t index) {
+  return pool_base + (uint64_t)index * STACK_POOL_SLOT_SIZE;
+}
+
+static uint64_t slot_stack_bottom(uint32_t index) {
+  return slot_base(index) + STACK_POOL_GUARD_SIZE;
+}
+
+static uint64_t slot_stack_top(uint32_t index) {
+  return slot_base(index) + STACK_POOL_SLOT_SIZE;
+}
+
+static void unmap_range(uint64_t from, uint64_t to) {
+  HardwareTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  txn.operation_code = HAL_OP_UNMAP_RANGE;
+  txn.input_address = from;
+  txn.length = to - from;
+  hal_unmap_memory_page(&pool_hw_context, &txn);
+}
+
+/**
+ * @brief Maps [from, to) read/write with a single range transaction.
+ *
+ * Kernel memory is identity mapped, so each stack page is backed by the
+ * physical frame at the same address.
+ * @return 0 on success, 1 if the HAL rejected the mapping.
+ */
+static int commit_pages(uint64_t from, uint64_t to) {
+  HardwareTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  txn.operation_code = HAL_OP_MAP_RANGE;
+  txn.input_address = from;
+  txn.output_address = from;
+  txn.length = to - from;
+  txn.input_value = HAL_PAGE_FLAG_READ | HAL_PAGE_FLAG_WRITE;
+  hal_map_memory_page(&pool_hw_context, &txn);
+  return txn.status_code != HAL_STATUS_OK;
+}
+
+int stack_pool_init(HardwareContext *hw_ctx, uint64_t region_base,
+                    uint64_t region_size) {
+  if (!hw_ctx || region_base % HAL_PAGE_SIZE != 0)
+    return STACK_POOL_ERR_INVALID_PARAM;
+
+  uint64_t slots = region_size / STACK_POOL_SLOT_SIZE;
+  if (slots == 0)
+    return STACK_POOL_ERR_INVALID_PARAM;
+  if (slots > STACK_POOL_MAX_SLOTS)
+    slots = STACK_POOL_MAX_SLOTS;
+
+  pool_hw_context = *hw_ctx;
+  pool_base = region_base;
+  slot_count = (uint32_t)slots;
+  free_count = 0;
+  memset(slot_table, 0, sizeof(slot_table));
+
+  // Nothing is committed up front; every page starts unmapped so that the
+  // first touch of a stack page and any touch of a guard page both fault.
+  unmap_range(pool_base, slot_stack_top(slot_count - 1));
+  for (uint32_t i = slot_count; i-- > 0;) {
+    slot_table[i].committed_floor = slot_stack_top(i);
+    free_slots[free_count++] = i;
+  }
+
+  return STACK_POOL_SUCCESS;
+}
+
+int stack_pool_allocate(void **stack_base, uint32_t *stack_size) {
+  if (!stack_base || !stack_size)
+    return STACK_POOL_ERR_INVALID_PARAM;
+  lock_pool();
+  if (free_count == 0) {
+    unlock_pool();
+    return STACK_POOL_ERR_EXHAUSTED;
+  }
+
+  uint32_t index = free_slots[free_count - 1];
+  StackSlot *slot = &slot_table[index];
+
+  // Only the page holding the initial stack pointer is committed eagerly
+  uint64_t top = slot_stack_top(index);
+  if (slot->committed_floor == top) {
+    if (commit_pages(top - HAL_PAGE_SIZE, top)) {
+      unlock_pool();
+      return STACK_POOL_ERR_EXHAUSTED;
+    }
+    slot->committed_floor = top - HAL_PAGE_SIZE;
+  }
+
+  free_count--;
+  slot->in_use = 1;
+  unlock_pool();
+  *stack_base = (void *)(uintptr_t)slot_stack_bottom(index);
+  *stack_size = STACK_POOL_STACK_SIZE;
+  return STACK_POOL_SUCCESS;
+}
+
+int stack_pool_release(void *stack_base) {
+  uint64_t addr = (uint64_t)(uintptr_t)stack_base;
+  if (slot_count == 0 || addr < pool_base + STACK_POOL_GUARD_SIZE)
+    return STACK_POOL_ERR_NOT_FOUND;
+
+  uint64_t index = (addr - pool_base) / STACK_POOL_SLOT_SIZE;
+  if (index >= slot_count || addr != slot_stack_bottom((uint32_t)index))
+    return STACK_POOL_ERR_NOT_FOUND;
+
+  StackSlot *slot = &slot_table[index];
+  lock_pool();
+  if (!slot->in_use) {
+    unlock_pool();
+    return STACK_POOL_ERR_NOT_FOUND;
+  }
+
+  // Committed pages stay mapped and are not scrubbed; the next owner
+  // starts from a fresh stack pointer and never reads stale frames.
+  slot->in_use = 0;
+  free_slots[free_count++] = (uint32_t)index;
+  unlock_pool();
+  return STACK_POOL_SUCCESS;
+}
+
+int stack_pool_handle_fault(uint64_t fault_address) {
+  if (slot_count == 0 || fault_address < pool_base)
+    return STACK_FAULT_NOT_POOL;
+
+  uint64_t index = (fault_address - pool_base) / STACK_POOL_SLOT_SIZE;
+  if (index >= slot_count)
+    return STACK_FAULT_NOT_POOL;
+
+  StackSlot *slot = &slot_table[index];
+  if (!slot->in_use || fault_address < slot_stack_bottom((uint32_t)index))
+    return STACK_FAULT_OVERFLOW;
+
+  uint64_t page = fault_address & ~((uint64_t)HAL_PAGE_SIZE - 1);
+  if (page >= slot->committed_floor)
+    return STACK_FAULT_OVERFLOW; // Already mapped, not a commit fault
+
+  // Commit everything between the faulting page and the current floor so
+  // that a deep call chain costs one fault, not one per page.
+  if (commit_pages(page, slot->committed_floor))
+    return STACK_FAULT_OVERFLOW;
+  slot->committed_floor = page;
+  return STACK_FAULT_COMMITTED;
+}
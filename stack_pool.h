@@ -0,0 +1,33 @@
+#ifndef SIMPLEOS_STACK_POOL_H
+#define SIMPLEOS_STACK_POOL_H
+
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define STACK_POOL_SUCCESS 0
+#define STACK_POOL_ERR_INVALID_PARAM -1
+#define STACK_POOL_ERR_EXHAUSTED -2
+#define STACK_POOL_ERR_NOT_FOUND -5
+
+// Geometry: every slot is one unmapped guard page followed by the stack
+#define STACK_POOL_STACK_SIZE (16 * 1024)
+#define STACK_POOL_GUARD_SIZE HAL_PAGE_SIZE
+#define STACK_POOL_SLOT_SIZE (STACK_POOL_GUARD_SIZE + STACK_POOL_STACK_SIZE)
+#define STACK_POOL_MAX_SLOTS 64
+#define STACK_POOL_REGION_SIZE                                                 \
+  ((uint64_t)STACK_POOL_MAX_SLOTS * STACK_POOL_SLOT_SIZE)
+
+// Results of stack_pool_handle_fault
+#define STACK_FAULT_NOT_POOL 0  // Address outside the pool
+#define STACK_FAULT_COMMITTED 1 // Page committed, retry the access
+#define STACK_FAULT_OVERFLOW 2  // Guard page hit or stack not in use
+
+int stack_pool_init(HardwareContext *hw_ctx, uint64_t region_base,
+                    uint64_t region_size);
+int stack_pool_allocate(void **stack_base, uint32_t *stack_size);
+int stack_pool_release(void *stack_base);
+int stack_pool_handle_fault(uint64_t fault_address);
+
+#endif // SIMPLEOS_STACK_POOL_H
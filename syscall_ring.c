@@ -0,0 +1,235 @@
+#include "syscall_ring.h"
+#include "agents.h"
+#include "percpu.h"
+#include <string.h>
+
+#define SQ_MASK (SYSCALL_RING_SQ_ENTRIES - 1)
+#define CQ_MASK (SYSCALL_RING_CQ_ENTRIES - 1)
+#define POLL_WORDS (SYSCALL_RING_MAX_RINGS / 32)
+
+typedef struct {
+  SyscallRing *ring;
+  SyscallContext owner; // Identity every drained entry executes with
+  uint32_t flags;
+  int is_active;
+  int busy; // Held by the CPU draining or changing the slot
+} RingSlot;
+
+static RingSlot ring_table[SYSCALL_RING_MAX_RINGS];
+static uint32_t poll_mask[POLL_WORDS];
+// Entries may re-enter the scheduler; a CPU never drains two passes at once
+static int draining[HAL_MAX_CPUS];
+
+static uint64_t read_ring_clock() {
+  HardwareTransaction txn;
+  txn.operation_code = HAL_OP_READ_TIME;
+  txn.input_address = 0;
+  txn.input_value = 0;
+  txn.output_address = 0;
+  txn.output_value = 0;
+  txn.status_code = HAL_STATUS_OK;
+  hal_read_monotonic_time(&percpu_this()->hw_context, &txn);
+  return txn.output_value;
+}
+
+// Only one CPU at a time drains, sets up or tears down a slot
+static int claim_ring(RingSlot *slot) {
+  return !__atomic_exchange_n(&slot->busy, 1, __ATOMIC_ACQUIRE);
+}
+
+static void release_ring(RingSlot *slot) {
+  __atomic_store_n(&slot->busy, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Admits the entries that can run on behalf of a ring.
+ *
+ * Anything not listed is refused, so syscalls added later stay off rings
+ * until reviewed. Ring syscalls would recurse, calls that switch, block
+ * or end the calling thread make no sense when the ring is drained by
+ * the scheduler, and IPC_CALL is meant to block for its reply.
+ */
+static int is_ring_safe(uint32_t syscall_number) {
+  switch (syscall_number) {
+  case SYSCALL_IPC_CHANNEL_CREATE:
+  case SYSCALL_IPC_CHANNEL_CLOSE:
+  case SYSCALL_IPC_SEND:
+  case SYSCALL_IPC_RECV:
+  case SYSCALL_THREAD_CREATE:
+  case SYSCALL_THREAD_WAKE:
+  case SYSCALL_THREAD_TRACE_QUERY:
+  case SYSCALL_THREAD_TRACE_SWITCHES:
+  case SYSCALL_EVENT_REGISTER:
+  case SYSCALL_EVENT_UNREGISTER:
+  case SYSCALL_AGENT_CONFIGURE:
+  case SYSCALL_AGENT_QUERY_USAGE:
+  case SYSCALL_TRAP_BIND_IRQ:
+  case SYSCALL_TRAP_UNBIND_IRQ:
+  case SYSCALL_TRAP_QUERY_STATS:
+  case SYSCALL_TRAP_SET_IRQ_POLICY:
+  case SYSCALL_TRAP_QUERY_IRQ_STATS:
+  case SYSCALL_TIME_READ:
+  case SYSCALL_PROFILE_QUERY:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Executes queued submissions of one ring.
+ *
+ * Each submission is copied out of shared memory before it is used, and
+ * the agent-written indices are clamped, so a misbehaving agent can only
+ * corrupt its own completions. Stops early when the CQ is full.
+ * @return Number of submissions executed.
+ */
+static uint32_t drain_ring(RingSlot *slot, uint32_t budget) {
+  SyscallRing *ring = slot->ring;
+  uint32_t head = ring->sq_head;
+  uint32_t tail = __atomic_load_n(&ring->sq_tail, __ATOMIC_ACQUIRE);
+  uint32_t cq_tail = ring->cq_tail;
+  uint32_t cq_head = __atomic_load_n(&ring->cq_head, __ATOMIC_ACQUIRE);
+  uint32_t done = 0;
+
+  if (tail - head > SYSCALL_RING_SQ_ENTRIES)
+    tail = head + SYSCALL_RING_SQ_ENTRIES;
+
+  ring->kernel_flags &= ~SYSCALL_RING_KFLAG_CQ_FULL;
+  while (head != tail && (budget == 0 || done < budget)) {
+    if (cq_tail - cq_head >= SYSCALL_RING_CQ_ENTRIES) {
+      ring->kernel_flags |= SYSCALL_RING_KFLAG_CQ_FULL;
+      break;
+    }
+
+    SyscallRingSubmission sqe = ring->sq[head & SQ_MASK];
+    SyscallContext ctx = slot->owner;
+    ctx.syscall_number = sqe.syscall_number;
+    SyscallTransaction txn;
+    memset(&txn, 0, sizeof(txn));
+    txn.argument_block_address = sqe.argument_block_address;
+    txn.argument_block_size = sqe.argument_block_size;
+
+    int res = is_ring_safe(sqe.syscall_number) ? handle_syscall(&ctx, &txn)
+                                               : SYSCALL_ERR_INVALID_ARGS;
+
+    SyscallRingCompletion *cqe = &ring->cq[cq_tail & CQ_MASK];
+    cqe->user_data = sqe.user_data;
+    cqe->syscall_number = sqe.syscall_number;
+    cqe->status_code = res;
+    head++;
+    cq_tail++;
+    done++;
+    // Publish per entry so the agent can reap while the drain continues
+    __atomic_store_n(&ring->sq_head, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->cq_tail, cq_tail, __ATOMIC_RELEASE);
+    cq_head = __atomic_load_n(&ring->cq_head, __ATOMIC_ACQUIRE);
+  }
+  return done;
+}
+
+int syscall_ring_setup(const SyscallContext *owner, SyscallRing *ring,
+                       uint32_t ring_size, uint32_t flags) {
+  if (!owner || !ring || ring_size < sizeof(SyscallRing))
+    return SYSCALL_RING_ERR_INVALID_PARAM;
+  if (((uintptr_t)ring & 63) || (flags & ~SYSCALL_RING_FLAG_POLL))
+    return SYSCALL_RING_ERR_INVALID_PARAM;
+  if (owner->caller_agent_id >= SYSCALL_RING_MAX_RINGS)
+    return SYSCALL_RING_ERR_INVALID_PARAM;
+
+  RingSlot *slot = &ring_table[owner->caller_agent_id];
+  if (!claim_ring(slot))
+    return SYSCALL_RING_ERR_INVALID_STATE;
+  if (slot->is_active) {
+    release_ring(slot);
+    return SYSCALL_RING_ERR_INVALID_STATE;
+  }
+
+  ring->sq_head = 0;
+  ring->cq_tail = 0;
+  ring->kernel_flags = 0;
+  ring->sq_tail = 0;
+  ring->cq_head = 0;
+
+  slot->ring = ring;
+  slot->owner = *owner;
+  slot->flags = flags;
+  slot->is_active = 1;
+
+  uint32_t id = owner->caller_agent_id;
+  if (flags & SYSCALL_RING_FLAG_POLL)
+    __atomic_fetch_or(&poll_mask[id / 32], 1u << (id % 32),
+                      __ATOMIC_RELEASE);
+  release_ring(slot);
+  return SYSCALL_RING_SUCCESS;
+}
+
+int syscall_ring_teardown(uint32_t agent_id) {
+  if (agent_id >= SYSCALL_RING_MAX_RINGS)
+    return SYSCALL_RING_ERR_INVALID_PARAM;
+  RingSlot *slot = &ring_table[agent_id];
+  if (!claim_ring(slot))
+    return SYSCALL_RING_ERR_INVALID_STATE;
+  if (!slot->is_active) {
+    release_ring(slot);
+    return SYSCALL_RING_ERR_NOT_FOUND;
+  }
+
+  __atomic_fetch_and(&poll_mask[agent_id / 32], ~(1u << (agent_id % 32)),
+                     __ATOMIC_RELEASE);
+  slot->ring = NULL;
+  slot->is_active = 0;
+  release_ring(slot);
+  return SYSCALL_RING_SUCCESS;
+}
+
+int syscall_ring_enter(uint32_t agent_id, uint32_t to_submit,
+                       uint32_t *submitted) {
+  if (agent_id >= SYSCALL_RING_MAX_RINGS || !submitted)
+    return SYSCALL_RING_ERR_INVALID_PARAM;
+  RingSlot *slot = &ring_table[agent_id];
+  uint32_t cpu = percpu_cpu_id();
+  if (draining[cpu] || !claim_ring(slot))
+    return SYSCALL_RING_ERR_INVALID_STATE;
+  if (!slot->is_active) {
+    release_ring(slot);
+    return SYSCALL_RING_ERR_NOT_FOUND;
+  }
+
+  draining[cpu] = 1;
+  *submitted = drain_ring(slot, to_submit);
+  draining[cpu] = 0;
+  release_ring(slot);
+  return SYSCALL_RING_SUCCESS;
+}
+
+uint32_t syscall_ring_poll(void) {
+  uint32_t cpu = percpu_cpu_id();
+  if (draining[cpu])
+    return 0;
+  draining[cpu] = 1;
+
+  uint32_t total = 0;
+  for (uint32_t word = 0; word < POLL_WORDS; word++) {
+    uint32_t bits = __atomic_load_n(&poll_mask[word], __ATOMIC_ACQUIRE);
+    while (bits) {
+      uint32_t id = word * 32 + (uint32_t)__builtin_ctz(bits);
+      bits &= bits - 1;
+      // Rings busy on another CPU are picked up on a later pass
+      RingSlot *slot = &ring_table[id];
+      if (!claim_ring(slot))
+        continue;
+      if (slot->is_active) {
+        // Polled entries run for the ring's owner, not the preempted thread
+        uint64_t start = read_ring_clock();
+        total += drain_ring(slot, SYSCALL_RING_POLL_BUDGET);
+        uint64_t end = read_ring_clock();
+        agent_charge_cpu_time(slot->owner.caller_agent_id, end - start, end);
+      }
+      release_ring(slot);
+    }
+  }
+
+  draining[cpu] = 0;
+  return total;
+}
@@ -0,0 +1,80 @@
+#ifndef SIMPLEOS_SYSCALL_RING_H
+#define SIMPLEOS_SYSCALL_RING_H
+
+#include "syscalls.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define SYSCALL_RING_SUCCESS 0
+#define SYSCALL_RING_ERR_INVALID_PARAM -1
+#define SYSCALL_RING_ERR_INVALID_STATE -4
+#define SYSCALL_RING_ERR_NOT_FOUND -5
+
+// Limits
+#define SYSCALL_RING_MAX_RINGS 64     // One ring per agent, agent_id < this
+#define SYSCALL_RING_SQ_ENTRIES 64    // Power of two
+#define SYSCALL_RING_CQ_ENTRIES 128   // Power of two, >= SQ entries
+#define SYSCALL_RING_POLL_BUDGET 32   // Entries per ring per scheduler pass
+
+// Setup flags
+#define SYSCALL_RING_FLAG_POLL 0x1 // Kernel drains the ring while scheduling
+
+// Kernel flags
+#define SYSCALL_RING_KFLAG_CQ_FULL 0x1 // Drain stopped on a full CQ
+
+// One queued syscall. The argument block follows the block ABI and is
+// read when the entry is executed, not when it is queued.
+typedef struct {
+  uint32_t syscall_number;
+  uint32_t argument_block_size;
+  void *argument_block_address;
+  uint64_t user_data; // Copied to the completion untouched
+} SyscallRingSubmission;
+
+typedef struct {
+  uint64_t user_data;
+  uint32_t syscall_number;
+  int32_t status_code;
+} SyscallRingCompletion;
+
+// Shared between an agent and the kernel. Each index has one writer: the
+// agent produces submissions (sq_tail) and consumes completions (cq_head),
+// the kernel does the opposite. Indices are free-running; the slot is the
+// index modulo the ring size. The two sides live on separate cache lines.
+typedef struct {
+  // Written by the kernel
+  uint32_t sq_head;
+  uint32_t cq_tail;
+  uint32_t kernel_flags;
+  // Written by the agent
+  uint32_t sq_tail __attribute__((aligned(64)));
+  uint32_t cq_head;
+  SyscallRingSubmission sq[SYSCALL_RING_SQ_ENTRIES]
+      __attribute__((aligned(64)));
+  SyscallRingCompletion cq[SYSCALL_RING_CQ_ENTRIES];
+} SyscallRing;
+
+// Argument block of SYSCALL_RING_SETUP
+typedef struct {
+  SyscallRing *ring;
+  uint32_t ring_size; // sizeof(SyscallRing)
+  uint32_t flags;     // SYSCALL_RING_FLAG_*
+} SyscallRingSetupArgs;
+
+// Argument block of SYSCALL_RING_ENTER
+typedef struct {
+  uint32_t to_submit; // Max entries to execute (0 = all queued)
+  uint32_t submitted; // Filled by kernel
+} SyscallRingEnterArgs;
+
+int syscall_ring_setup(const SyscallContext *owner, SyscallRing *ring,
+                       uint32_t ring_size, uint32_t flags);
+int syscall_ring_teardown(uint32_t agent_id);
+int syscall_ring_enter(uint32_t agent_id, uint32_t to_submit,
+                       uint32_t *submitted);
+
+// Scheduler hook: drains rings set up with SYSCALL_RING_FLAG_POLL
+uint32_t syscall_ring_poll(void);
+
+#endif // SIMPLEOS_SYSCALL_RING_H
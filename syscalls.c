@@ -1,90 +1,608 @@
-#include "syscalls.h"
-#include "ipc.h"
-#include "threads.h"
-#include <string.h>
-static int validate_syscall_context(SyscallContext *ctx) {
-  if (!ctx)
-    return 0;
-  return 1;
-}
-static int execute_ipc_syscall(SyscallContext *ctx, SyscallTransaction *txn) {
-
-  typedef struct {
-    ChannelDescriptor cd;
-    MessageEnvelope me;
-  } IpcArgs;
-
-  if (txn->argument_block_size < sizeof(IpcArgs))
-    return SYSCALL_ERR_INVALID_ARGS;
-
-  IpcArgs *args = (IpcArgs *)txn->argument_block_address;
-
-  switch (ctx->syscall_number) {
-  case SYSCALL_IPC_CHANNEL_CREATE:
-    return ipc_channel_create(&args->cd, &args->me);
-  case SYSCALL_IPC_CHANNEL_CLOSE:
-    return ipc_channel_close(&args->cd, &args->me);
-  case SYSCALL_IPC_SEND:
-    return ipc_send(&args->cd, &args->me);
-  case SYSCALL_IPC_RECV: {
-    int res = ipc_recv(&args->cd, &args->me);
-    return res;
-  }
-  case SYSCALL_IPC_CALL:
-    return ipc_call(&args->cd, &args->me);
-  default:
-    return SYSCALL_ERR_UNKNOWN_SYSCALL;
-  }
-}
-
-static int execute_thread_syscall(SyscallContext *ctx,
-                                  SyscallTransaction *txn) {
-  typedef struct {
-    ThreadDescriptor td;
-    ThreadTransaction tt;
-  } ThreadArgs;
-
-  if (txn->argument_block_size < sizeof(ThreadArgs))
-    return SYSCALL_ERR_INVALID_ARGS;
-
-  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
-
-  switch (ctx->syscall_number) {
-  case SYSCALL_THREAD_CREATE:
-    return create_thread(&args->td, &args->tt);
-  case SYSCALL_THREAD_EXIT:
-    return exit_thread(&args->td, &args->tt);
-  case SYSCALL_THREAD_YIELD:
-    return yield_thread(&args->td, &args->tt);
-  case SYSCALL_THREAD_BLOCK:
-    return block_thread(&args->td, &args->tt);
-  case SYSCALL_THREAD_WAKE:
-    return wake_thread(&args->td, &args->tt);
-  case SYSCALL_THREAD_SLEEP:
-    return sleep_thread(&args->td, &args->tt);
-  default:
-    return SYSCALL_ERR_UNKNOWN_SYSCALL;
-  }
-}
-
-int handle_syscall(SyscallContext *ctx, SyscallTransaction *txn) {
-  if (!validate_syscall_context(ctx)) {
-    if (txn)
-      txn->status_code = SYSCALL_ERR_INVALID_CONTEXT;
-    return SYSCALL_ERR_INVALID_CONTEXT;
-  }
-
-  if (!txn)
-    return SYSCALL_ERR_INVALID_ARGS;
-
-  int result = SYSCALL_ERR_UNKNOWN_SYSCALL;
-
-  if (ctx->syscall_number >= 100 && ctx->syscall_number < 200) {
-    result = execute_ipc_syscall(ctx, txn);
-  } else if (ctx->syscall_number >= 200 && ctx->syscall_number < 300) {
-    result = execute_thread_syscall(ctx, txn);
-  }
-
-  txn->status_code = result;
-  return result;
-}
+#include "syscalls.h"
+#include "agents.h"
+#include "events.h"
+#include "hal.h"
+#include "hal_clock.h"
+#include "ipc.h"
+#include "irq_policy.h"
+#include "percpu.h"
+#include "syscall_ring.h"
+#include "threads.h"
+#include "traps.h"
+#include "workqueue.h"
+#include <string.h>
+
+// Argument blocks of the built-in syscalls
+typedef struct {
+  ChannelDescriptor cd;
+  MessageEnvelope me;
+} IpcArgs;
+
+typedef struct {
+  ThreadDescriptor td;
+  ThreadTransaction tt;
+} ThreadArgs;
+
+typedef struct {
+  ThreadDescriptor td;
+  ThreadTraceStats stats;
+} ThreadTraceArgs;
+
+typedef struct {
+  EventHandlerDescriptor ed;
+  EventTransaction et;
+} EventArgs;
+
+typedef struct {
+  AgentDescriptor ad;
+  AgentTransaction at;
+} AgentArgs;
+
+typedef struct {
+  uint32_t irq;        // IRQ line
+  uint32_t channel_id; // Channel receiving TRAP_MSG_TYPE_IRQ messages
+} TrapIrqArgs;
+
+typedef struct {
+  uint32_t cpu_id;
+  TrapStats trap;
+  WorkqueueStats workqueue;
+} TrapStatsArgs;
+
+typedef struct {
+  uint32_t irq;
+  uint32_t reserved;
+  IrqPolicyStats stats;
+} IrqStatsArgs;
+
+static HardwareContext syscall_hw_context; // Only used to read the clock
+
+// Built-in table until the integrator installs the routing table
+static SyscallTableEntry default_syscall_table[SYSCALL_TABLE_SIZE];
+static SyscallTableEntry *syscall_table = NULL;
+
+#if SIMPLEOS_SYSCALL_PROFILE
+// Each CPU only writes its own rows, so recording needs no atomics
+static SyscallProfileCounters
+    profile_table[HAL_MAX_CPUS][SYSCALL_PROFILE_AGENTS + 1]
+                 [SYSCALL_PROFILE_SLOTS] __attribute__((aligned(64)));
+static uint32_t profile_slot_numbers[SYSCALL_PROFILE_SLOTS];
+static uint32_t profile_slots_used = 0;
+// Histogram bucket bounds in counter ticks, so recording never converts
+static uint64_t profile_bucket_limit[SYSCALL_PROFILE_BUCKETS - 1];
+
+#if SYSCALL_PROFILE_AGENTS < AGENT_MAX_AGENTS
+#error "every agent needs its own syscall profile row"
+#endif
+#endif
+
+static void ensure_initialized();
+
+static int validate_syscall_context(SyscallContext *ctx) {
+  if (!ctx)
+    return 0;
+  return 1;
+}
+
+static uint64_t read_syscall_clock() {
+  HardwareTransaction txn;
+  txn.operation_code = HAL_OP_READ_TIME;
+  txn.input_address = 0;
+  txn.input_value = 0;
+  txn.output_address = 0;
+  txn.output_value = 0;
+  txn.status_code = HAL_STATUS_OK;
+  hal_read_monotonic_time(&syscall_hw_context, &txn);
+  return txn.output_value;
+}
+
+#if SIMPLEOS_SYSCALL_PROFILE
+static void init_profile_buckets(void) {
+  for (uint32_t b = 0; b < SYSCALL_PROFILE_BUCKETS - 1; b++)
+    profile_bucket_limit[b] =
+        hal_clock_ns_to_ticks(1ull << (SYSCALL_PROFILE_BUCKET_SHIFT + b));
+}
+
+static uint32_t profile_bucket(uint64_t ticks) {
+  uint32_t bucket = 0;
+  while (bucket < SYSCALL_PROFILE_BUCKETS - 1 &&
+         ticks >= profile_bucket_limit[bucket])
+    bucket++;
+  return bucket;
+}
+
+static void assign_profile_slot(uint32_t syscall_number,
+                                SyscallTableEntry *entry) {
+  if (entry->profile_slot || profile_slots_used >= SYSCALL_PROFILE_SLOTS)
+    return;
+  profile_slot_numbers[profile_slots_used] = syscall_number;
+  entry->profile_slot = ++profile_slots_used;
+}
+
+// Reads the raw counter: going through the HAL clock transaction twice
+// per call cost more than the syscalls being measured
+static uint64_t profile_begin(const SyscallTableEntry *entry) {
+  return entry->profile_slot ? hal_clock_read_counter() : 0;
+}
+
+static void profile_end(const SyscallTableEntry *entry, uint32_t agent_id,
+                        int result, uint64_t start) {
+  if (!entry->profile_slot)
+    return;
+  uint64_t latency = hal_clock_read_counter() - start;
+  // Each CPU records into its own rows; snapshots sum them
+  uint32_t row = agent_id < SYSCALL_PROFILE_AGENTS ? agent_id
+                                                   : SYSCALL_PROFILE_AGENTS;
+  SyscallProfileCounters *c =
+      &profile_table[percpu_cpu_id()][row][entry->profile_slot - 1];
+  c->calls++;
+  if (result < 0)
+    c->errors++;
+  c->latency_total += latency;
+  if (latency > c->latency_max)
+    c->latency_max = latency;
+  c->latency_histogram[profile_bucket(latency)]++;
+}
+#else
+static inline void init_profile_buckets(void) {}
+static inline void assign_profile_slot(uint32_t syscall_number,
+                                       SyscallTableEntry *entry) {}
+static inline uint64_t profile_begin(const SyscallTableEntry *entry) {
+  return 0;
+}
+static inline void profile_end(const SyscallTableEntry *entry,
+                               uint32_t agent_id, int result,
+                               uint64_t start) {}
+#endif
+
+// Owner fields in argument blocks are caller-written; only services may
+// name an agent other than themselves
+static uint32_t owner_for_caller(const SyscallContext *ctx, uint32_t owner) {
+  return ctx->privilege_level >= PRIVILEGE_SERVICE ? owner
+                                                   : ctx->caller_agent_id;
+}
+
+// me.dst_agent_id is the acting agent for ipc: permissions and quota
+// charges are checked against it, so it is always the caller
+static int sys_ipc_channel_create(SyscallContext *ctx,
+                                  SyscallTransaction *txn) {
+  IpcArgs *args = (IpcArgs *)txn->argument_block_address;
+  args->cd.owner_agent_id = owner_for_caller(ctx, args->cd.owner_agent_id);
+  args->me.dst_agent_id = ctx->caller_agent_id;
+  return ipc_channel_create(&args->cd, &args->me);
+}
+
+static int sys_ipc_channel_close(SyscallContext *ctx,
+                                 SyscallTransaction *txn) {
+  IpcArgs *args = (IpcArgs *)txn->argument_block_address;
+  args->me.dst_agent_id = ctx->caller_agent_id;
+  return ipc_channel_close(&args->cd, &args->me);
+}
+
+static int sys_ipc_send(SyscallContext *ctx, SyscallTransaction *txn) {
+  IpcArgs *args = (IpcArgs *)txn->argument_block_address;
+  args->me.dst_agent_id = ctx->caller_agent_id;
+  return ipc_send(&args->cd, &args->me);
+}
+
+static int sys_ipc_recv(SyscallContext *ctx, SyscallTransaction *txn) {
+  IpcArgs *args = (IpcArgs *)txn->argument_block_address;
+  args->me.dst_agent_id = ctx->caller_agent_id;
+  return ipc_recv(&args->cd, &args->me);
+}
+
+static int sys_ipc_call(SyscallContext *ctx, SyscallTransaction *txn) {
+  IpcArgs *args = (IpcArgs *)txn->argument_block_address;
+  args->me.dst_agent_id = ctx->caller_agent_id;
+  return ipc_call(&args->cd, &args->me);
+}
+
+static int sys_thread_create(SyscallContext *ctx, SyscallTransaction *txn) {
+  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
+  // The owner is charged the stack and the CPU time
+  args->td.owner_agent_id = owner_for_caller(ctx, args->td.owner_agent_id);
+  args->tt.requester_agent_id = ctx->caller_agent_id;
+  return create_thread(&args->td, &args->tt);
+}
+
+static int sys_thread_exit(SyscallContext *ctx, SyscallTransaction *txn) {
+  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
+  return exit_thread(&args->td, &args->tt);
+}
+
+static int sys_thread_yield(SyscallContext *ctx, SyscallTransaction *txn) {
+  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
+  return yield_thread(&args->td, &args->tt);
+}
+
+static int sys_thread_block(SyscallContext *ctx, SyscallTransaction *txn) {
+  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
+  return block_thread(&args->td, &args->tt);
+}
+
+static int sys_thread_wake(SyscallContext *ctx, SyscallTransaction *txn) {
+  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
+  return wake_thread(&args->td, &args->tt);
+}
+
+static int sys_thread_sleep(SyscallContext *ctx, SyscallTransaction *txn) {
+  ThreadArgs *args = (ThreadArgs *)txn->argument_block_address;
+  return sleep_thread(&args->td, &args->tt);
+}
+
+static int sys_thread_trace_query(SyscallContext *ctx,
+                                  SyscallTransaction *txn) {
+  ThreadTraceArgs *args = (ThreadTraceArgs *)txn->argument_block_address;
+  return thread_trace_query(&args->td, &args->stats);
+}
+
+static int sys_thread_trace_switches(SyscallContext *ctx,
+                                     SyscallTransaction *txn) {
+  return thread_trace_read_switches(
+      (ThreadSwitchLog *)txn->argument_block_address);
+}
+
+static int sys_event_register(SyscallContext *ctx, SyscallTransaction *txn) {
+  // Handlers execute in kernel context, so only services may bind them
+  EventArgs *args = (EventArgs *)txn->argument_block_address;
+  args->ed.owner_agent_id = ctx->caller_agent_id;
+  args->et.requester_agent_id = ctx->caller_agent_id;
+  return event_handler_register(&args->ed, &args->et);
+}
+
+static int sys_event_unregister(SyscallContext *ctx,
+                                SyscallTransaction *txn) {
+  EventArgs *args = (EventArgs *)txn->argument_block_address;
+  args->et.requester_agent_id = ctx->caller_agent_id;
+  return event_handler_unregister(&args->ed, &args->et);
+}
+
+static int sys_agent_configure(SyscallContext *ctx, SyscallTransaction *txn) {
+  // Service privilege (table entry): agents must not raise their own share
+  AgentArgs *args = (AgentArgs *)txn->argument_block_address;
+  args->at.requester_agent_id = ctx->caller_agent_id;
+  return agent_configure(&args->ad, &args->at);
+}
+
+static int sys_agent_query_usage(SyscallContext *ctx,
+                                 SyscallTransaction *txn) {
+  AgentArgs *args = (AgentArgs *)txn->argument_block_address;
+  args->at.requester_agent_id = ctx->caller_agent_id;
+  if (args->ad.agent_id != ctx->caller_agent_id &&
+      ctx->privilege_level < PRIVILEGE_SERVICE)
+    return SYSCALL_ERR_ACCESS_DENIED;
+  return agent_query_usage(&args->ad, &args->at);
+}
+
+static int sys_trap_bind_irq(SyscallContext *ctx, SyscallTransaction *txn) {
+  // Service privilege (table entry): only drivers may claim lines
+  TrapIrqArgs *args = (TrapIrqArgs *)txn->argument_block_address;
+  return trap_bind_irq_to_channel(args->irq, args->channel_id,
+                                  ctx->caller_agent_id);
+}
+
+static int sys_trap_unbind_irq(SyscallContext *ctx,
+                               SyscallTransaction *txn) {
+  TrapIrqArgs *args = (TrapIrqArgs *)txn->argument_block_address;
+  return trap_unbind_irq(args->irq, ctx->caller_agent_id);
+}
+
+static int sys_trap_query_stats(SyscallContext *ctx,
+                                SyscallTransaction *txn) {
+  TrapStatsArgs *args = (TrapStatsArgs *)txn->argument_block_address;
+  int res = trap_query_stats(args->cpu_id, &args->trap);
+  if (res != TRAP_SUCCESS)
+    return res;
+  return workqueue_query_stats(args->cpu_id, &args->workqueue);
+}
+
+static int sys_trap_set_irq_policy(SyscallContext *ctx,
+                                   SyscallTransaction *txn) {
+  IrqPolicy *policy = (IrqPolicy *)txn->argument_block_address;
+  // A line bound to a channel is tuned only by the agent that bound it
+  uint32_t owner;
+  if (trap_irq_binding_owner(policy->irq, &owner) == TRAP_SUCCESS &&
+      owner != ctx->caller_agent_id)
+    return TRAP_ERR_PERMISSION_DENIED;
+  return irq_policy_configure(policy);
+}
+
+static int sys_trap_query_irq_stats(SyscallContext *ctx,
+                                    SyscallTransaction *txn) {
+  IrqStatsArgs *args = (IrqStatsArgs *)txn->argument_block_address;
+  return irq_policy_query_stats(args->irq, &args->stats);
+}
+
+static int sys_ring_setup(SyscallContext *ctx, SyscallTransaction *txn) {
+  SyscallRingSetupArgs *args =
+      (SyscallRingSetupArgs *)txn->argument_block_address;
+  return syscall_ring_setup(ctx, args->ring, args->ring_size, args->flags);
+}
+
+static int sys_ring_enter(SyscallContext *ctx, SyscallTransaction *txn) {
+  SyscallRingEnterArgs *args =
+      (SyscallRingEnterArgs *)txn->argument_block_address;
+  return syscall_ring_enter(ctx->caller_agent_id, args->to_submit,
+                            &args->submitted);
+}
+
+static int sys_ring_teardown(SyscallContext *ctx, SyscallTransaction *txn) {
+  return syscall_ring_teardown(ctx->caller_agent_id);
+}
+
+static int sys_time_read(SyscallContext *ctx, SyscallTransaction *txn) {
+  *(uint64_t *)txn->argument_block_address = read_syscall_clock();
+  return SYSCALL_SUCCESS;
+}
+
+// Register ABI handlers. args[n] is register x(n + 1) of the caller.
+
+static int fast_thread_yield(SyscallContext *ctx, const uint64_t *args,
+                             uint64_t *value) {
+  ThreadDescriptor td;
+  memset(&td, 0, sizeof(td));
+  td.thread_id = ctx->caller_thread_id;
+  return yield_thread(&td, NULL);
+}
+
+static int fast_thread_wake(SyscallContext *ctx, const uint64_t *args,
+                            uint64_t *value) {
+  // args[0]: thread to notify
+  ThreadDescriptor td;
+  memset(&td, 0, sizeof(td));
+  td.thread_id = (uint32_t)args[0];
+  return wake_thread(&td, NULL);
+}
+
+static int fast_ipc_send(SyscallContext *ctx, const uint64_t *args,
+                         uint64_t *value) {
+  // args[0]: channel, args[1]: msg_type | payload_len << 32,
+  // args[2..5]: payload bytes
+  uint32_t payload_len = (uint32_t)(args[1] >> 32);
+  if (payload_len > SYSCALL_REGISTER_PAYLOAD_MAX)
+    return SYSCALL_ERR_INVALID_ARGS;
+
+  uint64_t payload[SYSCALL_REGISTER_PAYLOAD_MAX / sizeof(uint64_t)];
+  memcpy(payload, &args[2], sizeof(payload));
+
+  ChannelDescriptor cd;
+  memset(&cd, 0, sizeof(cd));
+  cd.channel_id = (uint32_t)args[0];
+  MessageEnvelope me;
+  memset(&me, 0, sizeof(me));
+  me.msg_type = (uint32_t)args[1];
+  me.dst_agent_id = ctx->caller_agent_id; // Sender identity
+  me.flags = IPC_MSG_FLAG_NON_BLOCKING;
+  me.payload_len = payload_len;
+  me.payload = payload;
+  return ipc_send(&cd, &me);
+}
+
+static int fast_time_read(SyscallContext *ctx, const uint64_t *args,
+                          uint64_t *value) {
+  *value = read_syscall_clock();
+  return SYSCALL_SUCCESS;
+}
+
+static int sys_profile_query(SyscallContext *ctx, SyscallTransaction *txn) {
+  SyscallProfileSnapshot *snap =
+      (SyscallProfileSnapshot *)txn->argument_block_address;
+  if (snap->agent_id != ctx->caller_agent_id &&
+      ctx->privilege_level < PRIVILEGE_SERVICE)
+    return SYSCALL_ERR_ACCESS_DENIED;
+  return syscall_profile_snapshot(snap);
+}
+
+static void register_builtin_syscalls() {
+  syscall_register_handler(SYSCALL_IPC_CHANNEL_CREATE, sys_ipc_channel_create,
+                           sizeof(IpcArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_IPC_CHANNEL_CLOSE, sys_ipc_channel_close,
+                           sizeof(IpcArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_IPC_SEND, sys_ipc_send, sizeof(IpcArgs),
+                           PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_IPC_RECV, sys_ipc_recv, sizeof(IpcArgs),
+                           PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_IPC_CALL, sys_ipc_call, sizeof(IpcArgs),
+                           PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_THREAD_CREATE, sys_thread_create,
+                           sizeof(ThreadArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_EXIT, sys_thread_exit,
+                           sizeof(ThreadArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_YIELD, sys_thread_yield,
+                           sizeof(ThreadArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_BLOCK, sys_thread_block,
+                           sizeof(ThreadArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_WAKE, sys_thread_wake,
+                           sizeof(ThreadArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_SLEEP, sys_thread_sleep,
+                           sizeof(ThreadArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_TRACE_QUERY, sys_thread_trace_query,
+                           sizeof(ThreadTraceArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_THREAD_TRACE_SWITCHES,
+                           sys_thread_trace_switches, sizeof(ThreadSwitchLog),
+                           PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_EVENT_REGISTER, sys_event_register,
+                           sizeof(EventArgs), PRIVILEGE_SERVICE);
+  syscall_register_handler(SYSCALL_EVENT_UNREGISTER, sys_event_unregister,
+                           sizeof(EventArgs), PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_AGENT_CONFIGURE, sys_agent_configure,
+                           sizeof(AgentArgs), PRIVILEGE_SERVICE);
+  syscall_register_handler(SYSCALL_AGENT_QUERY_USAGE, sys_agent_query_usage,
+                           sizeof(AgentArgs), PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_TRAP_BIND_IRQ, sys_trap_bind_irq,
+                           sizeof(TrapIrqArgs), PRIVILEGE_SERVICE);
+  syscall_register_handler(SYSCALL_TRAP_UNBIND_IRQ, sys_trap_unbind_irq,
+                           sizeof(TrapIrqArgs), PRIVILEGE_SERVICE);
+  syscall_register_handler(SYSCALL_TRAP_QUERY_STATS, sys_trap_query_stats,
+                           sizeof(TrapStatsArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_TRAP_SET_IRQ_POLICY,
+                           sys_trap_set_irq_policy, sizeof(IrqPolicy),
+                           PRIVILEGE_SERVICE);
+  syscall_register_handler(SYSCALL_TRAP_QUERY_IRQ_STATS,
+                           sys_trap_query_irq_stats, sizeof(IrqStatsArgs),
+                           PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_RING_SETUP, sys_ring_setup,
+                           sizeof(SyscallRingSetupArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_RING_ENTER, sys_ring_enter,
+                           sizeof(SyscallRingEnterArgs), PRIVILEGE_USER);
+  syscall_register_handler(SYSCALL_RING_TEARDOWN, sys_ring_teardown, 0,
+                           PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_TIME_READ, sys_time_read, sizeof(uint64_t),
+                           PRIVILEGE_USER);
+
+  syscall_register_handler(SYSCALL_PROFILE_QUERY, sys_profile_query,
+                           sizeof(SyscallProfileSnapshot), PRIVILEGE_USER);
+
+  syscall_register_fast_handler(SYSCALL_THREAD_YIELD, fast_thread_yield);
+  syscall_register_fast_handler(SYSCALL_THREAD_WAKE, fast_thread_wake);
+  syscall_register_fast_handler(SYSCALL_IPC_SEND, fast_ipc_send);
+  syscall_register_fast_handler(SYSCALL_TIME_READ, fast_time_read);
+}
+
+static void ensure_initialized() {
+  // TODO: This initialization pattern is not thread-safe.
+  // In a multi-threaded environment, use atomic operations or locking.
+  if (!syscall_table) {
+    memset(default_syscall_table, 0, sizeof(default_syscall_table));
+    syscall_table = default_syscall_table;
+    init_profile_buckets();
+    register_builtin_syscalls();
+  }
+}
+
+int syscall_register_handler(uint32_t syscall_number,
+                             SyscallHandlerFn handler,
+                             uint32_t argument_block_size,
+                             uint32_t privilege_level) {
+  ensure_initialized();
+  if (syscall_number >= SYSCALL_TABLE_SIZE)
+    return SYSCALL_ERR_INVALID_ARGS;
+
+  SyscallTableEntry *entry = &syscall_table[syscall_number];
+  entry->handler = handler;
+  entry->argument_block_size = argument_block_size;
+  entry->privilege_level = privilege_level;
+  assign_profile_slot(syscall_number, entry);
+  return SYSCALL_SUCCESS;
+}
+
+int syscall_register_fast_handler(uint32_t syscall_number,
+                                  SyscallFastHandlerFn handler) {
+  ensure_initialized();
+  if (syscall_number >= SYSCALL_TABLE_SIZE)
+    return SYSCALL_ERR_INVALID_ARGS;
+  syscall_table[syscall_number].fast_handler = handler;
+  assign_profile_slot(syscall_number, &syscall_table[syscall_number]);
+  return SYSCALL_SUCCESS;
+}
+
+int syscall_profile_snapshot(SyscallProfileSnapshot *snapshot) {
+  if (!snapshot)
+    return SYSCALL_ERR_INVALID_ARGS;
+#if SIMPLEOS_SYSCALL_PROFILE
+  ensure_initialized();
+  uint32_t row = snapshot->agent_id;
+  snapshot->shared_row = row >= SYSCALL_PROFILE_AGENTS;
+  if (snapshot->shared_row)
+    row = SYSCALL_PROFILE_AGENTS;
+
+  snapshot->entry_count = profile_slots_used;
+  for (uint32_t slot = 0; slot < profile_slots_used; slot++) {
+    SyscallProfileEntry *e = &snapshot->entries[slot];
+    memset(e, 0, sizeof(*e));
+    e->syscall_number = profile_slot_numbers[slot];
+    for (uint32_t cpu = 0; cpu < HAL_MAX_CPUS; cpu++) {
+      const SyscallProfileCounters *c = &profile_table[cpu][row][slot];
+      e->counters.calls += c->calls;
+      e->counters.errors += c->errors;
+      e->counters.latency_total += c->latency_total;
+      if (c->latency_max > e->counters.latency_max)
+        e->counters.latency_max = c->latency_max;
+      for (uint32_t b = 0; b < SYSCALL_PROFILE_BUCKETS; b++)
+        e->counters.latency_histogram[b] += c->latency_histogram[b];
+    }
+    SyscallProfileCounters *sum = &e->counters;
+    sum->latency_total = hal_clock_ticks_to_ns(sum->latency_total);
+    sum->latency_max = hal_clock_ticks_to_ns(sum->latency_max);
+  }
+  return SYSCALL_SUCCESS;
+#else
+  return SYSCALL_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void syscall_install_table(SyscallTableEntry *table) {
+  ensure_initialized();
+  if (!table || table == syscall_table)
+    return;
+  // Carry over the built-ins and anything registered before installation
+  memcpy(table, syscall_table, sizeof(SyscallTableEntry) * SYSCALL_TABLE_SIZE);
+  syscall_table = table;
+}
+
+int handle_syscall(SyscallContext *ctx, SyscallTransaction *txn) {
+  if (!validate_syscall_context(ctx)) {
+    if (txn)
+      txn->status_code = SYSCALL_ERR_INVALID_CONTEXT;
+    return SYSCALL_ERR_INVALID_CONTEXT;
+  }
+
+  if (!txn)
+    return SYSCALL_ERR_INVALID_ARGS;
+
+  ensure_initialized();
+  percpu_this()->stats.syscalls++;
+
+  int result = SYSCALL_ERR_UNKNOWN_SYSCALL;
+
+  if (ctx->syscall_number < SYSCALL_TABLE_SIZE) {
+    SyscallTableEntry *entry = &syscall_table[ctx->syscall_number];
+    if (!entry->handler) {
+      result = SYSCALL_ERR_UNKNOWN_SYSCALL;
+    } else {
+      uint64_t start = profile_begin(entry);
+      if (txn->argument_block_size < entry->argument_block_size ||
+          (entry->argument_block_size && !txn->argument_block_address))
+        result = SYSCALL_ERR_INVALID_ARGS;
+      else if (ctx->privilege_level < entry->privilege_level)
+        result = SYSCALL_ERR_ACCESS_DENIED;
+      else
+        result = entry->handler(ctx, txn);
+      profile_end(entry, ctx->caller_agent_id, result, start);
+    }
+  }
+
+  txn->status_code = result;
+  return result;
+}
+
+int handle_fast_syscall(SyscallContext *ctx, const uint64_t *args,
+                        uint64_t *value) {
+  if (!validate_syscall_context(ctx))
+    return SYSCALL_ERR_INVALID_CONTEXT;
+  if (!args || !value)
+    return SYSCALL_ERR_INVALID_ARGS;
+
+  ensure_initialized();
+  percpu_this()->stats.syscalls++;
+  *value = 0;
+
+  if (ctx->syscall_number >= SYSCALL_TABLE_SIZE)
+    return SYSCALL_ERR_UNKNOWN_SYSCALL;
+  SyscallTableEntry *entry = &syscall_table[ctx->syscall_number];
+  if (!entry->fast_handler)
+    return SYSCALL_ERR_UNKNOWN_SYSCALL;
+
+  uint64_t start = profile_begin(entry);
+  int result = ctx->privilege_level < entry->privilege_level
+                   ? SYSCALL_ERR_ACCESS_DENIED
+                   : entry->fast_handler(ctx, args, value);
+  profile_end(entry, ctx->caller_agent_id, result, start);
+  return result;
+}
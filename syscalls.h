@@ -1,43 +1,137 @@
-#ifndef SYSCALLS_H
-#define SYSCALLS_H
-
-#include <stddef.h>
-#include <stdint.h>
-#define SYSCALL_SUCCESS 0
-#define SYSCALL_ERR_INVALID_CONTEXT -1
-#define SYSCALL_ERR_UNKNOWN_SYSCALL -2
-#define SYSCALL_ERR_ACCESS_DENIED -3
-#define SYSCALL_ERR_INVALID_ARGS -4
-#define SYSCALL_ERR_EXECUTION_FAILED -5
-#define SYSCALL_IPC_CHANNEL_CREATE 101
-#define SYSCALL_IPC_CHANNEL_CLOSE 102
-#define SYSCALL_IPC_SEND 103
-#define SYSCALL_IPC_RECV 104
-#define SYSCALL_IPC_CALL 105
-#define SYSCALL_THREAD_CREATE 201
-#define SYSCALL_THREAD_EXIT 202
-#define SYSCALL_THREAD_YIELD 203
-#define SYSCALL_THREAD_BLOCK 204
-#define SYSCALL_THREAD_WAKE 205
-#define SYSCALL_THREAD_SLEEP 206
-#define PRIVILEGE_USER 0
-#define PRIVILEGE_SERVICE 1
-#define PRIVILEGE_KERNEL 2
-typedef struct {
-  uint32_t syscall_number;   // Requested syscall
-  uint32_t caller_agent_id;  // Who called
-  uint32_t caller_thread_id; // Which thread
-  uint32_t abi_version;      // ABI version
-  uint32_t privilege_level;  // user/kernel/service
-} SyscallContext;
-typedef struct {
-  void *argument_block_address;   // Pointer to args
-  uint32_t argument_block_size;   // Size of args
-  void *return_block_address;     // Pointer to result buffer
-  uint32_t return_block_max_size; // Max result size
-  int32_t status_code;            // Status filled by kernel
-} SyscallTransaction;
-
-int handle_syscall(SyscallContext *ctx, SyscallTransaction *txn);
-
-#endif 
+#ifndef SYSCALLS_H
+#define SYSCALLS_H
+
+#include "hal_sim.h"
+#include <stddef.h>
+#include <stdint.h>
+#define SYSCALL_SUCCESS 0
+#define SYSCALL_ERR_INVALID_CONTEXT -1
+#define SYSCALL_ERR_UNKNOWN_SYSCALL -2
+#define SYSCALL_ERR_ACCESS_DENIED -3
+#define SYSCALL_ERR_INVALID_ARGS -4
+#define SYSCALL_ERR_EXECUTION_FAILED -5
+#define SYSCALL_ERR_NOT_SUPPORTED -6
+#define SYSCALL_IPC_CHANNEL_CREATE 101
+#define SYSCALL_IPC_CHANNEL_CLOSE 102
+#define SYSCALL_IPC_SEND 103
+#define SYSCALL_IPC_RECV 104
+#define SYSCALL_IPC_CALL 105
+#define SYSCALL_THREAD_CREATE 201
+#define SYSCALL_THREAD_EXIT 202
+#define SYSCALL_THREAD_YIELD 203
+#define SYSCALL_THREAD_BLOCK 204
+#define SYSCALL_THREAD_WAKE 205
+#define SYSCALL_THREAD_SLEEP 206
+#define SYSCALL_THREAD_TRACE_QUERY 207
+#define SYSCALL_THREAD_TRACE_SWITCHES 208
+#define SYSCALL_EVENT_REGISTER 301
+#define SYSCALL_EVENT_UNREGISTER 302
+#define SYSCALL_AGENT_CONFIGURE 401
+#define SYSCALL_AGENT_QUERY_USAGE 402
+#define SYSCALL_TRAP_BIND_IRQ 501
+#define SYSCALL_TRAP_UNBIND_IRQ 502
+#define SYSCALL_TRAP_QUERY_STATS 503
+#define SYSCALL_TRAP_SET_IRQ_POLICY 504
+#define SYSCALL_TRAP_QUERY_IRQ_STATS 505
+#define SYSCALL_RING_SETUP 601
+#define SYSCALL_RING_ENTER 602
+#define SYSCALL_RING_TEARDOWN 603
+#define SYSCALL_TIME_READ 701
+#define SYSCALL_PROFILE_QUERY 801
+#define PRIVILEGE_USER 0
+#define PRIVILEGE_SERVICE 1
+#define PRIVILEGE_KERNEL 2
+
+// ABI versions. The trap entry takes the version from the upper 32 bits
+// of x0 and the syscall number from the lower 32 bits.
+//  - Block ABI (1, also 0): x1/x2 hold the argument block address and
+//    size; the status is returned in x0.
+//  - Register ABI (2): up to six arguments in x1..x6, no argument block;
+//    the status is returned in x0 and a value in x1. Only syscalls with a
+//    fast handler accept it.
+#define SYSCALL_ABI_BLOCK 1
+#define SYSCALL_ABI_REGISTER 2
+#define SYSCALL_REGISTER_ARGS 6
+#define SYSCALL_REGISTER_PAYLOAD_MAX 32 // Send-small payload in x3..x6
+typedef struct {
+  uint32_t syscall_number;   // Requested syscall
+  uint32_t caller_agent_id;  // Who called
+  uint32_t caller_thread_id; // Which thread
+  uint32_t abi_version;      // ABI version
+  uint32_t privilege_level;  // user/kernel/service
+} SyscallContext;
+typedef struct {
+  void *argument_block_address;   // Pointer to args
+  uint32_t argument_block_size;   // Size of args
+  void *return_block_address;     // Pointer to result buffer
+  uint32_t return_block_max_size; // Max result size
+  int32_t status_code;            // Status filled by kernel
+} SyscallTransaction;
+
+// Syscall numbers index the dispatch table directly
+#define SYSCALL_TABLE_SIZE 1024
+
+// Per-agent syscall profiling, set SIMPLEOS_SYSCALL_PROFILE to override.
+// Host builds have it on; target builds leave it out, as its counters
+// take about 0.5 MB of BSS. The first SYSCALL_PROFILE_SLOTS registered
+// syscalls are profiled. Every agent id has its own row; callers outside
+// the agent table (the kernel's own ids) share one overflow row.
+#ifndef SIMPLEOS_SYSCALL_PROFILE
+#define SIMPLEOS_SYSCALL_PROFILE SIMPLEOS_HAL_SIM
+#endif
+#define SYSCALL_PROFILE_SLOTS 32
+#define SYSCALL_PROFILE_AGENTS 64 // AGENT_MAX_AGENTS
+#define SYSCALL_PROFILE_BUCKETS 8
+#define SYSCALL_PROFILE_BUCKET_SHIFT 6 // Bucket 0 holds latencies below 2^6
+
+// One cache line per CPU, agent and syscall. Latencies are measured around
+// validation and handler in counter ticks; snapshots report nanoseconds.
+typedef struct {
+  uint64_t calls;
+  uint64_t errors; // Calls that returned a negative status
+  uint64_t latency_total;
+  uint64_t latency_max;
+  uint32_t latency_histogram[SYSCALL_PROFILE_BUCKETS]; // log2 buckets
+} SyscallProfileCounters;
+
+typedef struct {
+  uint32_t syscall_number;
+  uint32_t reserved;
+  SyscallProfileCounters counters; // Summed over all CPUs
+} SyscallProfileEntry;
+
+// Argument block of SYSCALL_PROFILE_QUERY
+typedef struct {
+  uint32_t agent_id;    // Agent to report on
+  uint32_t shared_row;  // Filled by kernel: 1 if the overflow row was read
+  uint32_t entry_count; // Filled by kernel
+  uint32_t reserved;
+  SyscallProfileEntry entries[SYSCALL_PROFILE_SLOTS];
+} SyscallProfileSnapshot;
+
+typedef int (*SyscallHandlerFn)(SyscallContext *ctx, SyscallTransaction *txn);
+typedef int (*SyscallFastHandlerFn)(SyscallContext *ctx, const uint64_t *args,
+                                    uint64_t *value);
+
+typedef struct {
+  SyscallHandlerFn handler;          // Block ABI, NULL if unassigned
+  SyscallFastHandlerFn fast_handler; // Register ABI, NULL if unsupported
+  uint32_t argument_block_size;      // Minimum argument block size
+  uint32_t privilege_level;          // Minimum caller privilege
+  uint32_t profile_slot;             // Profiling slot + 1, 0 if unprofiled
+  uint32_t reserved;
+} SyscallTableEntry;
+
+int handle_syscall(SyscallContext *ctx, SyscallTransaction *txn);
+int handle_fast_syscall(SyscallContext *ctx, const uint64_t *args,
+                        uint64_t *value);
+int syscall_register_handler(uint32_t syscall_number,
+                             SyscallHandlerFn handler,
+                             uint32_t argument_block_size,
+                             uint32_t privilege_level);
+int syscall_register_fast_handler(uint32_t syscall_number,
+                                  SyscallFastHandlerFn handler);
+void syscall_install_table(SyscallTableEntry *table);
+int syscall_profile_snapshot(SyscallProfileSnapshot *snapshot);
+
+#endif 
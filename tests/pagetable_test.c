@@ -0,0 +1,224 @@
+#include "pagetable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Host test of the translation table engine: every map, unmap and split
+// sequence checks both the returned status and how many table pages the
+// pool has handed out.
+
+#define TEST_POOL_PAGES 64
+#define TEST_VIRT 0x40000000ULL  // 1 GB: a fresh level-1 slot
+#define TEST_PHYS 0x80000000ULL
+#define TEST_FLAGS_RW (HAL_PAGE_FLAG_READ | HAL_PAGE_FLAG_WRITE)
+
+static int failures;
+
+#define CHECK(cond)                                                         \
+  do {                                                                      \
+    if (!(cond)) {                                                          \
+      fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__,  \
+              __func__, #cond);                                             \
+      failures++;                                                           \
+    }                                                                       \
+  } while (0)
+
+static PageTable pt;
+static void *pool;
+
+// Fresh table over a pool of the given size; only the root is in use
+static void setup(uint32_t pages) {
+  memset(pool, 0xA5, TEST_POOL_PAGES * HAL_PAGE_SIZE);
+  CHECK(pagetable_init(&pt, pool, (uint64_t)pages * HAL_PAGE_SIZE) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.root != NULL);
+  CHECK(pt.tables_used == 1);
+}
+
+static int maps_to(uint64_t virt, uint64_t expect_phys, uint32_t expect_flags) {
+  uint64_t phys = 0;
+  uint32_t flags = 0;
+  return pagetable_lookup(&pt, virt, &phys, &flags) == PAGETABLE_SUCCESS &&
+         phys == expect_phys && flags == expect_flags;
+}
+
+static int unmapped(uint64_t virt) {
+  return pagetable_lookup(&pt, virt, NULL, NULL) == PAGETABLE_ERR_NOT_MAPPED;
+}
+
+static void test_invalid_params(void) {
+  setup(TEST_POOL_PAGES);
+  CHECK(pagetable_map_page(&pt, TEST_VIRT + 1, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_ERR_INVALID_PARAM);
+  CHECK(pagetable_map_block(&pt, TEST_VIRT + HAL_PAGE_SIZE, TEST_PHYS,
+                            TEST_FLAGS_RW) == PAGETABLE_ERR_INVALID_PARAM);
+  CHECK(pagetable_map_page(&pt, 1ULL << PAGETABLE_VA_BITS, TEST_PHYS,
+                           TEST_FLAGS_RW) == PAGETABLE_ERR_INVALID_PARAM);
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, 3 * HAL_PAGE_SIZE) ==
+        PAGETABLE_ERR_INVALID_PARAM);
+  CHECK(pt.tables_used == 1);
+}
+
+static void test_page_map_unmap(void) {
+  setup(TEST_POOL_PAGES);
+  CHECK(pagetable_map_page(&pt, TEST_VIRT, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4); // Root, levels 1-3
+  CHECK(maps_to(TEST_VIRT + 0x123, TEST_PHYS + 0x123, TEST_FLAGS_RW));
+  CHECK(unmapped(TEST_VIRT + HAL_PAGE_SIZE));
+
+  CHECK(pagetable_map_page(&pt, TEST_VIRT, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_ERR_ALREADY_MAPPED);
+  CHECK(pt.tables_used == 4);
+
+  // A neighbour shares all three tables
+  CHECK(pagetable_map_page(&pt, TEST_VIRT + HAL_PAGE_SIZE,
+                           TEST_PHYS + 0x10000, HAL_PAGE_FLAG_READ) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4);
+  CHECK(maps_to(TEST_VIRT + HAL_PAGE_SIZE, TEST_PHYS + 0x10000,
+                HAL_PAGE_FLAG_READ));
+
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_PAGE_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4);
+  CHECK(unmapped(TEST_VIRT));
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_PAGE_SIZE) ==
+        PAGETABLE_ERR_NOT_MAPPED);
+
+  // The last page out prunes the whole path back to the root
+  CHECK(pagetable_unmap(&pt, TEST_VIRT + HAL_PAGE_SIZE, HAL_PAGE_SIZE) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 1);
+  CHECK(unmapped(TEST_VIRT + HAL_PAGE_SIZE));
+}
+
+static void test_block_lookup_offsets(void) {
+  setup(TEST_POOL_PAGES);
+  uint32_t flags = TEST_FLAGS_RW | HAL_PAGE_FLAG_USER;
+  CHECK(pagetable_map_block(&pt, TEST_VIRT, TEST_PHYS, flags) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 3); // Root, levels 1-2
+
+  CHECK(maps_to(TEST_VIRT, TEST_PHYS, flags));
+  CHECK(maps_to(TEST_VIRT + 0x1234, TEST_PHYS + 0x1234, flags));
+  CHECK(maps_to(TEST_VIRT + 0x12345, TEST_PHYS + 0x12345, flags));
+  CHECK(maps_to(TEST_VIRT + HAL_BLOCK_SIZE - 1,
+                TEST_PHYS + HAL_BLOCK_SIZE - 1, flags));
+  CHECK(unmapped(TEST_VIRT + HAL_BLOCK_SIZE));
+
+  // Pages cannot be mapped inside the block, nor the block twice
+  CHECK(pagetable_map_page(&pt, TEST_VIRT + HAL_PAGE_SIZE, TEST_PHYS,
+                           TEST_FLAGS_RW) == PAGETABLE_ERR_ALREADY_MAPPED);
+  CHECK(pagetable_map_block(&pt, TEST_VIRT, TEST_PHYS, flags) ==
+        PAGETABLE_ERR_ALREADY_MAPPED);
+  CHECK(pt.tables_used == 3);
+
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_BLOCK_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 1);
+  CHECK(unmapped(TEST_VIRT + 0x12345));
+}
+
+static void test_split_block(void) {
+  setup(TEST_POOL_PAGES);
+  uint32_t flags = HAL_PAGE_FLAG_READ | HAL_PAGE_FLAG_EXEC;
+  CHECK(pagetable_map_block(&pt, TEST_VIRT, TEST_PHYS, flags) ==
+        PAGETABLE_SUCCESS);
+
+  // Unmapping one page turns the block into 511 equivalent pages
+  uint64_t hole = TEST_VIRT + 5 * HAL_PAGE_SIZE;
+  CHECK(pagetable_unmap(&pt, hole, HAL_PAGE_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4);
+  CHECK(unmapped(hole));
+  CHECK(maps_to(TEST_VIRT, TEST_PHYS, flags));
+  CHECK(maps_to(hole - HAL_PAGE_SIZE + 0x10,
+                TEST_PHYS + 4 * HAL_PAGE_SIZE + 0x10, flags));
+  CHECK(maps_to(hole + HAL_PAGE_SIZE, TEST_PHYS + 6 * HAL_PAGE_SIZE, flags));
+  CHECK(maps_to(TEST_VIRT + HAL_BLOCK_SIZE - HAL_PAGE_SIZE,
+                TEST_PHYS + HAL_BLOCK_SIZE - HAL_PAGE_SIZE, flags));
+
+  // The hole can be refilled as an ordinary page
+  CHECK(pagetable_map_page(&pt, hole, TEST_PHYS + HAL_BLOCK_SIZE,
+                           TEST_FLAGS_RW) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4);
+  CHECK(maps_to(hole, TEST_PHYS + HAL_BLOCK_SIZE, TEST_FLAGS_RW));
+
+  // Emptying the split range page by page prunes every table
+  for (uint32_t i = 0; i < PAGETABLE_ENTRIES; i++)
+    CHECK(pagetable_unmap(&pt, TEST_VIRT + (uint64_t)i * HAL_PAGE_SIZE,
+                          HAL_PAGE_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 1);
+  CHECK(unmapped(TEST_VIRT));
+}
+
+static void test_block_unmap_with_leaf_table(void) {
+  setup(TEST_POOL_PAGES);
+  // Pages in two 2 MB ranges under one level-2 table
+  uint64_t other = TEST_VIRT + HAL_BLOCK_SIZE;
+  for (uint32_t i = 0; i < 3; i++)
+    CHECK(pagetable_map_page(&pt, TEST_VIRT + (uint64_t)i * HAL_PAGE_SIZE,
+                             TEST_PHYS + (uint64_t)i * HAL_PAGE_SIZE,
+                             TEST_FLAGS_RW) == PAGETABLE_SUCCESS);
+  CHECK(pagetable_map_page(&pt, other, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 5); // Root, level 1, level 2, two leaf tables
+
+  // A block-sized unmap drops the leaf table with all its pages
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_BLOCK_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4);
+  for (uint32_t i = 0; i < 3; i++)
+    CHECK(unmapped(TEST_VIRT + (uint64_t)i * HAL_PAGE_SIZE));
+  CHECK(maps_to(other, TEST_PHYS, TEST_FLAGS_RW));
+
+  // The freed range takes a block again
+  CHECK(pagetable_map_block(&pt, TEST_VIRT, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 4);
+
+  CHECK(pagetable_unmap(&pt, other, HAL_BLOCK_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_BLOCK_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 1);
+}
+
+static void test_out_of_memory(void) {
+  // Root plus two tables: enough for a block, one short for a page
+  setup(3);
+  CHECK(pagetable_map_page(&pt, TEST_VIRT, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_ERR_OUT_OF_MEMORY);
+  CHECK(pt.tables_used == 1); // walk_create's partial path rolled back
+  CHECK(unmapped(TEST_VIRT));
+
+  // The rolled-back tables are usable again
+  CHECK(pagetable_map_block(&pt, TEST_VIRT, TEST_PHYS, TEST_FLAGS_RW) ==
+        PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 3);
+
+  // Splitting needs a leaf table the pool no longer has; the block stays
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_PAGE_SIZE) ==
+        PAGETABLE_ERR_OUT_OF_MEMORY);
+  CHECK(pt.tables_used == 3);
+  CHECK(maps_to(TEST_VIRT + 0x42, TEST_PHYS + 0x42, TEST_FLAGS_RW));
+
+  CHECK(pagetable_unmap(&pt, TEST_VIRT, HAL_BLOCK_SIZE) == PAGETABLE_SUCCESS);
+  CHECK(pt.tables_used == 1);
+}
+
+int main(void) {
+  pool = aligned_alloc(HAL_PAGE_SIZE, TEST_POOL_PAGES * HAL_PAGE_SIZE);
+  if (!pool)
+    return 1;
+
+  test_invalid_params();
+  test_page_map_unmap();
+  test_block_lookup_offsets();
+  test_split_block();
+  test_block_unmap_with_leaf_table();
+  test_out_of_memory();
+
+  free(pool);
+  if (failures) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("pagetable: all checks passed\n");
+  return 0;
+}
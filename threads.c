@@ -1,181 +1,492 @@
-#include "threads.h"
-#include <string.h>
-
-#define MAX_THREADS 256
-static ThreadDescriptor thread_table[MAX_THREADS];
-static int initialized = 0;
-static void ensure_initialized();
-static ThreadDescriptor *lookup_thread(uint32_t id);
-static void set_thread_state(ThreadDescriptor *t, uint32_t state);
-static void enqueue_ready_thread(ThreadDescriptor *t);
-static void dequeue_ready_thread(ThreadDescriptor *t);
-static void save_thread_context(ThreadDescriptor *t);
-static void restore_thread_context(ThreadDescriptor *t);
-static void select_next_ready_thread();
-
-static void ensure_initialized() {
-  // TODO: This initialization pattern is not thread-safe.
-  // In a multi-threaded environment, use atomic operations or locking.
-  if (!initialized) {
-    memset(thread_table, 0, sizeof(thread_table));
-    initialized = 1;
-  }
-}
-
-static ThreadDescriptor *lookup_thread(uint32_t id) {
-  if (id >= MAX_THREADS)
-    return NULL;
-  ThreadDescriptor *t = &thread_table[id];
-  if (t->state == THREAD_STATE_NEW && t->entry_point == NULL)
-    return NULL;
-  return t;
-}
-
-static void set_thread_state(ThreadDescriptor *t, uint32_t state) {
-  if (t)
-    t->state = state;
-}
-
-static void enqueue_ready_thread(ThreadDescriptor *t) {
-  // Add to ready queue
-}
-static void dequeue_ready_thread(ThreadDescriptor *t) {
-  // Remove from ready queue
-}
-static void save_thread_context(ThreadDescriptor *t) {
-  // Save CPU registers
-}
-static void restore_thread_context(ThreadDescriptor *t) {
-  // Restore CPU registers
-}
-static void select_next_ready_thread() {
-  // Scheduler logic
-}
-
-int create_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
-  ensure_initialized();
-  if (!ctx)
-    return THREAD_ERR_INVALID_PARAM;
-  if (ctx->thread_id >= MAX_THREADS)
-    return THREAD_ERR_INVALID_PARAM;
-
-  ThreadDescriptor *thread = &thread_table[ctx->thread_id];
-
-  // Check if slot is already in use by an active thread
-  if (thread->state != THREAD_STATE_NEW && thread->state != THREAD_STATE_DEAD) {
-    return THREAD_ERR_PERMISSION_DENIED; // Slot already occupied
-  }
-
-  *thread = *ctx;
-
-  set_thread_state(thread, THREAD_STATE_READY);
-  enqueue_ready_thread(thread);
-
-  if (txn)
-    txn->result_code = THREAD_SUCCESS;
-  return THREAD_SUCCESS;
-}
-
-int exit_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
-  ensure_initialized();
-  if (!ctx)
-    return THREAD_ERR_INVALID_PARAM;
-
-  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
-  if (!thread)
-    return THREAD_ERR_NOT_FOUND;
-
-  set_thread_state(thread, THREAD_STATE_DEAD);
-
-  select_next_ready_thread();
-
-  if (txn)
-    txn->result_code = THREAD_SUCCESS;
-  return THREAD_SUCCESS;
-}
-
-int yield_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
-  ensure_initialized();
-  if (!ctx)
-    return THREAD_ERR_INVALID_PARAM;
-
-  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
-  if (!thread)
-    return THREAD_ERR_NOT_FOUND;
-
-  // TODO: Context switch should be atomic (disable interrupts).
-  // Without atomicity, re-entrancy issues may occur.
-  if (thread->state == THREAD_STATE_RUNNING) {
-    set_thread_state(thread, THREAD_STATE_READY);
-    enqueue_ready_thread(thread);
-
-    save_thread_context(thread);
-    select_next_ready_thread();
-  } else if (thread->state != THREAD_STATE_READY) {
-    // Cannot yield from blocked/dead state
-    return THREAD_ERR_INVALID_STATE;
-  }
-
-  if (txn)
-    txn->result_code = THREAD_SUCCESS;
-  return THREAD_SUCCESS;
-}
-
-int block_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
-  ensure_initialized();
-  if (!ctx || !txn)
-    return THREAD_ERR_INVALID_PARAM;
-
-  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
-  if (!thread)
-    return THREAD_ERR_NOT_FOUND;
-
-  // Validate state transition: can only block from RUNNING or READY
-  if (thread->state != THREAD_STATE_RUNNING &&
-      thread->state != THREAD_STATE_READY) {
-    return THREAD_ERR_INVALID_STATE;
-  }
-
-  // TODO: Context switch should be atomic (disable interrupts).
-  dequeue_ready_thread(thread);
-  set_thread_state(thread, THREAD_STATE_BLOCKED);
-
-  save_thread_context(thread);
-  select_next_ready_thread();
-
-  txn->result_code = THREAD_SUCCESS;
-  return THREAD_SUCCESS;
-}
-
-int wake_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
-  ensure_initialized();
-  if (!ctx)
-    return THREAD_ERR_INVALID_PARAM;
-
-  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
-  if (!thread)
-    return THREAD_ERR_NOT_FOUND;
-
-  // Validate state transition: can only wake from BLOCKED
-  if (thread->state != THREAD_STATE_BLOCKED) {
-    // Thread is not blocked, nothing to wake
-    if (txn)
-      txn->result_code = THREAD_ERR_INVALID_STATE;
-    return THREAD_ERR_INVALID_STATE;
-  }
-
-  set_thread_state(thread, THREAD_STATE_READY);
-  enqueue_ready_thread(thread);
-
-  if (txn)
-    txn->result_code = THREAD_SUCCESS;
-  return THREAD_SUCCESS;
-}
-
-int sleep_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
-  ensure_initialized();
-  if (!ctx || !txn)
-    return THREAD_ERR_INVALID_PARAM;
-
-  return block_thread(ctx, txn);
-}
+#include "threads.h"
+#include "agents.h"
+#include "events.h"
+#include "hal.h"
+#include "percpu.h"
+#include "stack_pool.h"
+#include "syscall_ring.h"
+#include <string.h>
+
+#define MAX_THREADS 256
+#define NO_THREAD PERCPU_NO_THREAD
+
+// Scheduler bookkeeping kept beside the descriptors, indexed by thread_id
+typedef struct {
+  uint32_t ready_prev;
+  uint32_t ready_next;
+  uint64_t run_start;   // When the thread was last switched in
+  uint64_t ready_since; // When the thread last became ready
+  uint32_t home_cpu;    // Run queue the thread is placed on
+  int in_ready_queue;
+} ThreadSchedState;
+
+#if SIMPLEOS_SCHED_TRACE
+typedef struct {
+  ThreadSwitchEvent events[THREAD_TRACE_RING_SIZE];
+  uint64_t total_switches;
+} SwitchRing;
+
+static ThreadTraceStats trace_table[MAX_THREADS];
+static SwitchRing switch_rings[HAL_MAX_CPUS];
+#endif
+
+static ThreadDescriptor thread_table[MAX_THREADS];
+static ThreadSchedState sched_table[MAX_THREADS];
+static int initialized = 0;
+static void ensure_initialized();
+static ThreadDescriptor *lookup_thread(uint32_t id);
+static void set_thread_state(ThreadDescriptor *t, uint32_t state);
+static void enqueue_ready_thread(ThreadDescriptor *t);
+static void dequeue_ready_thread(ThreadDescriptor *t);
+static void save_thread_context(ThreadDescriptor *t);
+static void restore_thread_context(ThreadDescriptor *t);
+static void select_next_ready_thread();
+
+static void ensure_initialized() {
+  // TODO: This initialization pattern is not thread-safe.
+  // In a multi-threaded environment, use atomic operations or locking.
+  if (!initialized) {
+    memset(thread_table, 0, sizeof(thread_table));
+    memset(sched_table, 0, sizeof(sched_table));
+#if SIMPLEOS_SCHED_TRACE
+    memset(trace_table, 0, sizeof(trace_table));
+    memset(switch_rings, 0, sizeof(switch_rings));
+#endif
+    initialized = 1;
+  }
+}
+
+static ThreadDescriptor *lookup_thread(uint32_t id) {
+  if (id >= MAX_THREADS)
+    return NULL;
+  ThreadDescriptor *t = &thread_table[id];
+  if (t->state == THREAD_STATE_NEW && t->entry_point == NULL)
+    return NULL;
+  return t;
+}
+
+static void set_thread_state(ThreadDescriptor *t, uint32_t state) {
+  if (t)
+    t->state = state;
+}
+
+static uint32_t thread_index(ThreadDescriptor *t) {
+  return (uint32_t)(t - thread_table);
+}
+
+static uint64_t read_scheduler_clock() {
+  HardwareTransaction txn;
+  txn.operation_code = HAL_OP_READ_TIME;
+  txn.input_address = 0;
+  txn.input_value = 0;
+  txn.output_address = 0;
+  txn.output_value = 0;
+  txn.status_code = HAL_STATUS_OK;
+  hal_read_monotonic_time(&percpu_this()->hw_context, &txn);
+  return txn.output_value;
+}
+
+#if SIMPLEOS_SCHED_TRACE
+static uint32_t trace_bucket(uint64_t value) {
+  value >>= THREAD_TRACE_BUCKET_SHIFT;
+  if (value == 0)
+    return 0;
+  uint32_t bucket = 64 - (uint32_t)__builtin_clzll(value);
+  return bucket < THREAD_TRACE_BUCKETS ? bucket : THREAD_TRACE_BUCKETS - 1;
+}
+
+static void trace_thread_ready(uint32_t id) {
+  sched_table[id].ready_since = read_scheduler_clock();
+}
+
+static void trace_thread_switched_out(uint32_t id, uint64_t run_length) {
+  ThreadTraceStats *stats = &trace_table[id];
+  stats->run_length[trace_bucket(run_length)]++;
+  if (run_length > stats->max_run_length)
+    stats->max_run_length = run_length;
+}
+
+/**
+ * @brief Records a switch into the per-CPU ring and the incoming thread's
+ * wake-to-run latency histogram.
+ * @param prev Outgoing thread id, or NO_THREAD if the CPU was idle.
+ * @param prev_state State the outgoing thread was left in.
+ * @param next Incoming thread id.
+ * @param now Current monotonic time.
+ */
+static void trace_thread_switched_in(uint32_t prev, uint32_t prev_state,
+                                     uint32_t next, uint64_t now) {
+  ThreadTraceStats *stats = &trace_table[next];
+  uint64_t latency = now - sched_table[next].ready_since;
+  stats->thread_id = next;
+  stats->switch_count++;
+  stats->wake_latency[trace_bucket(latency)]++;
+  if (latency > stats->max_wake_latency)
+    stats->max_wake_latency = latency;
+
+  SwitchRing *ring = &switch_rings[percpu_cpu_id()];
+  ThreadSwitchEvent *ev =
+      &ring->events[ring->total_switches % THREAD_TRACE_RING_SIZE];
+  ev->timestamp = now;
+  ev->prev_thread_id = prev;
+  ev->next_thread_id = next;
+  ev->prev_state = prev_state;
+  ev->wake_latency = latency > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)latency;
+  ring->total_switches++;
+}
+#else
+static inline void trace_thread_ready(uint32_t id) {}
+static inline void trace_thread_switched_out(uint32_t id, uint64_t len) {}
+static inline void trace_thread_switched_in(uint32_t prev, uint32_t prev_state,
+                                            uint32_t next, uint64_t now) {}
+#endif
+
+static void enqueue_ready_thread(ThreadDescriptor *t) {
+  uint32_t id = thread_index(t);
+  ThreadSchedState *s = &sched_table[id];
+  PerCpu *cpu = percpu_get(s->home_cpu);
+  percpu_lock_run_queue(cpu);
+  if (s->in_ready_queue) {
+    percpu_unlock_run_queue(cpu);
+    return;
+  }
+
+  s->ready_prev = cpu->ready_tail;
+  s->ready_next = NO_THREAD;
+  if (cpu->ready_tail != NO_THREAD)
+    sched_table[cpu->ready_tail].ready_next = id;
+  else
+    cpu->ready_head = id;
+  cpu->ready_tail = id;
+  cpu->ready_count++;
+  s->in_ready_queue = 1;
+  percpu_unlock_run_queue(cpu);
+  trace_thread_ready(id);
+}
+static void dequeue_ready_thread(ThreadDescriptor *t) {
+  uint32_t id = thread_index(t);
+  ThreadSchedState *s = &sched_table[id];
+  PerCpu *cpu = percpu_get(s->home_cpu);
+  percpu_lock_run_queue(cpu);
+  if (!s->in_ready_queue) {
+    percpu_unlock_run_queue(cpu);
+    return;
+  }
+
+  if (s->ready_prev != NO_THREAD)
+    sched_table[s->ready_prev].ready_next = s->ready_next;
+  else
+    cpu->ready_head = s->ready_next;
+  if (s->ready_next != NO_THREAD)
+    sched_table[s->ready_next].ready_prev = s->ready_prev;
+  else
+    cpu->ready_tail = s->ready_prev;
+  cpu->ready_count--;
+  s->in_ready_queue = 0;
+  percpu_unlock_run_queue(cpu);
+}
+static void save_thread_context(ThreadDescriptor *t) {
+  // Save CPU registers
+}
+static void restore_thread_context(ThreadDescriptor *t) {
+  // Restore CPU registers
+}
+
+/**
+ * @brief Charges the outgoing thread's run time to its owning agent.
+ * @param now Current monotonic time.
+ */
+static void account_outgoing_thread(PerCpu *cpu, uint64_t now) {
+  uint32_t current_thread = cpu->current_thread;
+  if (current_thread == NO_THREAD)
+    return;
+  ThreadDescriptor *prev = &thread_table[current_thread];
+  uint64_t run_length = now - sched_table[current_thread].run_start;
+  agent_charge_cpu_time(prev->owner_agent_id, run_length, now);
+  trace_thread_switched_out(current_thread, run_length);
+  if (prev->state == THREAD_STATE_RUNNING) {
+    // Preempted without yielding: it stays runnable
+    set_thread_state(prev, THREAD_STATE_READY);
+    enqueue_ready_thread(prev);
+  }
+  cpu->current_thread = NO_THREAD;
+}
+
+static void select_next_ready_thread() {
+  PerCpu *cpu = percpu_this();
+
+  // The outgoing thread is charged up to here; what runs below is billed
+  // to the agents it runs for
+  uint64_t now = read_scheduler_clock();
+  uint32_t prev = cpu->current_thread;
+  uint32_t prev_state = prev != NO_THREAD ? thread_table[prev].state
+                                          : THREAD_STATE_NEW;
+  account_outgoing_thread(cpu, now);
+
+  // Run-to-completion event handlers go first, on the shared stack, then
+  // submissions of agents whose rings are in poll mode. Both walk global
+  // handler and ring tables, so only the boot CPU serves them.
+  if (percpu_cpu_id() == 0) {
+    percpu_clear_resched();
+    EventTransaction ev_txn;
+    memset(&ev_txn, 0, sizeof(ev_txn));
+    ev_txn.cpu_id = 0;
+    event_dispatch_pending(&ev_txn);
+    syscall_ring_poll();
+    now = read_scheduler_clock();
+  }
+
+  // Highest priority wins, FIFO among equals. Threads of agents that
+  // used up their CPU share stay queued until the agent's next window.
+  // Only this CPU's queue is scanned; the lock keeps remote wakeups out.
+  uint32_t best = NO_THREAD;
+  percpu_lock_run_queue(cpu);
+  for (uint32_t id = cpu->ready_head; id != NO_THREAD;
+       id = sched_table[id].ready_next) {
+    ThreadDescriptor *t = &thread_table[id];
+    if (best != NO_THREAD && t->priority <= thread_table[best].priority)
+      continue;
+    if (agent_is_throttled(t->owner_agent_id, now))
+      continue;
+    best = id;
+  }
+  percpu_unlock_run_queue(cpu);
+
+  if (best == NO_THREAD) {
+    cpu->stats.idle_entries++;
+    return; // Idle until the next event
+  }
+
+  ThreadDescriptor *next = &thread_table[best];
+  dequeue_ready_thread(next);
+  set_thread_state(next, THREAD_STATE_RUNNING);
+  sched_table[best].run_start = now;
+  trace_thread_switched_in(prev, prev_state, best, now);
+  cpu->current_thread = best;
+  cpu->stats.context_switches++;
+  restore_thread_context(next);
+}
+
+int create_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
+  ensure_initialized();
+  if (!ctx)
+    return THREAD_ERR_INVALID_PARAM;
+  if (ctx->thread_id >= MAX_THREADS)
+    return THREAD_ERR_INVALID_PARAM;
+  // An owner outside the agent table would escape CPU and memory metering
+  if (ctx->owner_agent_id >= AGENT_MAX_AGENTS)
+    return THREAD_ERR_INVALID_PARAM;
+  if (ctx->thread_id >= THREAD_RESERVED_ID_BASE &&
+      (ctx->owner_agent_id != 0 || (txn && txn->requester_agent_id != 0)))
+    return THREAD_ERR_PERMISSION_DENIED;
+
+  ThreadDescriptor *thread = &thread_table[ctx->thread_id];
+
+  // Check if slot is already in use by an active thread
+  if (thread->state != THREAD_STATE_NEW && thread->state != THREAD_STATE_DEAD) {
+    return THREAD_ERR_PERMISSION_DENIED; // Slot already occupied
+  }
+
+  // No caller-supplied stack: take a guarded, lazily committed one,
+  // charged in full to the owner since every page may be committed
+  if (!ctx->stack_base) {
+    if (agent_charge_memory(ctx->owner_agent_id, STACK_POOL_STACK_SIZE) !=
+        AGENT_SUCCESS)
+      return THREAD_ERR_OUT_OF_MEMORY;
+    if (stack_pool_allocate(&ctx->stack_base, &ctx->stack_size) !=
+        STACK_POOL_SUCCESS) {
+      agent_release_memory(ctx->owner_agent_id, STACK_POOL_STACK_SIZE);
+      return THREAD_ERR_OUT_OF_MEMORY;
+    }
+  }
+
+  *thread = *ctx;
+  // Threads stay on the CPU that created them
+  sched_table[ctx->thread_id].home_cpu = percpu_cpu_id();
+
+  set_thread_state(thread, THREAD_STATE_READY);
+  enqueue_ready_thread(thread);
+
+  if (txn)
+    txn->result_code = THREAD_SUCCESS;
+  return THREAD_SUCCESS;
+}
+
+int exit_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
+  ensure_initialized();
+  if (!ctx)
+    return THREAD_ERR_INVALID_PARAM;
+
+  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
+  if (!thread)
+    return THREAD_ERR_NOT_FOUND;
+
+  dequeue_ready_thread(thread);
+  set_thread_state(thread, THREAD_STATE_DEAD);
+
+  // Pool stacks go back for reuse; caller-supplied stacks are not ours
+  if (stack_pool_release(thread->stack_base) == STACK_POOL_SUCCESS) {
+    agent_release_memory(thread->owner_agent_id, STACK_POOL_STACK_SIZE);
+    thread->stack_base = NULL;
+  }
+
+  select_next_ready_thread();
+
+  if (txn)
+    txn->result_code = THREAD_SUCCESS;
+  return THREAD_SUCCESS;
+}
+
+int yield_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
+  ensure_initialized();
+  if (!ctx)
+    return THREAD_ERR_INVALID_PARAM;
+
+  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
+  if (!thread)
+    return THREAD_ERR_NOT_FOUND;
+
+  // TODO: Context switch should be atomic (disable interrupts).
+  // Without atomicity, re-entrancy issues may occur.
+  if (thread->state == THREAD_STATE_RUNNING) {
+    set_thread_state(thread, THREAD_STATE_READY);
+    enqueue_ready_thread(thread);
+
+    save_thread_context(thread);
+    select_next_ready_thread();
+  } else if (thread->state != THREAD_STATE_READY) {
+    // Cannot yield from blocked/dead state
+    return THREAD_ERR_INVALID_STATE;
+  }
+
+  if (txn)
+    txn->result_code = THREAD_SUCCESS;
+  return THREAD_SUCCESS;
+}
+
+int block_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
+  ensure_initialized();
+  if (!ctx || !txn)
+    return THREAD_ERR_INVALID_PARAM;
+
+  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
+  if (!thread)
+    return THREAD_ERR_NOT_FOUND;
+
+  // Validate state transition: can only block from RUNNING or READY
+  if (thread->state != THREAD_STATE_RUNNING &&
+      thread->state != THREAD_STATE_READY) {
+    return THREAD_ERR_INVALID_STATE;
+  }
+
+  // TODO: Context switch should be atomic (disable interrupts).
+  dequeue_ready_thread(thread);
+  set_thread_state(thread, THREAD_STATE_BLOCKED);
+
+  save_thread_context(thread);
+  select_next_ready_thread();
+
+  txn->result_code = THREAD_SUCCESS;
+  return THREAD_SUCCESS;
+}
+
+int wake_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
+  ensure_initialized();
+  if (!ctx)
+    return THREAD_ERR_INVALID_PARAM;
+
+  ThreadDescriptor *thread = lookup_thread(ctx->thread_id);
+  if (!thread)
+    return THREAD_ERR_NOT_FOUND;
+
+  // Validate state transition: can only wake from BLOCKED
+  if (thread->state != THREAD_STATE_BLOCKED) {
+    // Thread is not blocked, nothing to wake
+    if (txn)
+      txn->result_code = THREAD_ERR_INVALID_STATE;
+    return THREAD_ERR_INVALID_STATE;
+  }
+
+  set_thread_state(thread, THREAD_STATE_READY);
+  enqueue_ready_thread(thread);
+
+  if (txn)
+    txn->result_code = THREAD_SUCCESS;
+  return THREAD_SUCCESS;
+}
+
+int sleep_thread(ThreadDescriptor *ctx, ThreadTransaction *txn) {
+  ensure_initialized();
+  if (!ctx || !txn)
+    return THREAD_ERR_INVALID_PARAM;
+
+  return block_thread(ctx, txn);
+}
+
+uint32_t thread_current_id(void) { return percpu_this()->current_thread; }
+
+void thread_schedule(void) {
+  ensure_initialized();
+  select_next_ready_thread();
+}
+
+int thread_trace_query(ThreadDescriptor *ctx, ThreadTraceStats *stats) {
+  ensure_initialized();
+  if (!ctx || !stats)
+    return THREAD_ERR_INVALID_PARAM;
+#if SIMPLEOS_SCHED_TRACE
+  if (!lookup_thread(ctx->thread_id))
+    return THREAD_ERR_NOT_FOUND;
+
+  *stats = trace_table[ctx->thread_id];
+  stats->thread_id = ctx->thread_id;
+  return THREAD_SUCCESS;
+#else
+  return THREAD_ERR_NOT_SUPPORTED;
+#endif
+}
+
+int thread_trace_read_switches(ThreadSwitchLog *log) {
+  ensure_initialized();
+  if (!log || log->cpu_id >= HAL_MAX_CPUS)
+    return THREAD_ERR_INVALID_PARAM;
+#if SIMPLEOS_SCHED_TRACE
+  SwitchRing *ring = &switch_rings[log->cpu_id];
+  uint64_t total = ring->total_switches;
+  uint32_t count = total < THREAD_TRACE_RING_SIZE ? (uint32_t)total
+                                                  : THREAD_TRACE_RING_SIZE;
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t seq = total - count + i;
+    log->events[i] = ring->events[seq % THREAD_TRACE_RING_SIZE];
+  }
+  log->event_count = count;
+  log->total_switches = total;
+  return THREAD_SUCCESS;
+#else
+  return THREAD_ERR_NOT_SUPPORTED;
+#endif
+}
+
+int thread_export_descriptors(ThreadDescriptor *out, uint32_t max_count,
+                              uint32_t *count) {
+  ensure_initialized();
+  if (!count || (!out && max_count))
+    return THREAD_ERR_INVALID_PARAM;
+
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < MAX_THREADS; i++) {
+    uint32_t state = thread_table[i].state;
+    if (state == THREAD_STATE_NEW || state == THREAD_STATE_DEAD)
+      continue;
+    if (n < max_count) {
+      out[n] = thread_table[i];
+      // Register state is not captured; the thread restarts at its entry
+      out[n].state = THREAD_STATE_NEW;
+      out[n].stack_base = NULL;
+      out[n].stack_size = 0;
+    }
+    n++;
+  }
+  *count = n;
+  return THREAD_SUCCESS;
+}
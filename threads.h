@@ -1,60 +1,112 @@
-#ifndef THREADS_H
-#define THREADS_H
-
-#include <stddef.h>
-#include <stdint.h>
-
-
-// Status Codes
-#define THREAD_SUCCESS 0
-#define THREAD_ERR_INVALID_PARAM -1
-#define THREAD_ERR_OUT_OF_MEMORY -2
-#define THREAD_ERR_PERMISSION_DENIED -3
-#define THREAD_ERR_INVALID_STATE -4
-#define THREAD_ERR_NOT_FOUND -5
-
-// Thread States
-#define THREAD_STATE_NEW 0
-#define THREAD_STATE_READY 1
-#define THREAD_STATE_RUNNING 2
-#define THREAD_STATE_BLOCKED 3
-#define THREAD_STATE_DEAD 4
-
-// Thread Actions (for Transaction)
-#define THREAD_ACTION_CREATE 1
-#define THREAD_ACTION_EXIT 2
-#define THREAD_ACTION_YIELD 3
-#define THREAD_ACTION_BLOCK 4
-#define THREAD_ACTION_WAKE 5
-#define THREAD_ACTION_SLEEP 6
-
-// Thread Descriptor (Contextual Data)
-typedef struct {
-  uint32_t thread_id;      // Unique identifier
-  uint32_t owner_agent_id; // Owner agent
-  void *entry_point;       // Function address
-  void *stack_base;        // Stack base address
-  uint32_t stack_size;     // Stack size
-  uint32_t priority;       // Priority
-  uint32_t state;          // Current state
-} ThreadDescriptor;
-
-// Thread Transaction (Transactional Data)
-typedef struct {
-  uint32_t action;              // Operation requested
-  uint32_t requester_agent_id;  // Requesting agent
-  uint32_t requester_thread_id; // Requesting thread
-  uint32_t reason_code;         // Reason (e.g. IPC_WAIT)
-  uint32_t timeout_ms;          // Timeout for block/sleep
-  int32_t result_code;          // Result filled by kernel
-} ThreadTransaction;
-
-// Exposed Thread Methods
-int create_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
-int exit_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
-int yield_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
-int block_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
-int wake_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
-int sleep_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
-
-#endif // THREADS_H
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Status Codes
+#define THREAD_SUCCESS 0
+#define THREAD_ERR_INVALID_PARAM -1
+#define THREAD_ERR_OUT_OF_MEMORY -2
+#define THREAD_ERR_PERMISSION_DENIED -3
+#define THREAD_ERR_INVALID_STATE -4
+#define THREAD_ERR_NOT_FOUND -5
+#define THREAD_ERR_NOT_SUPPORTED -6
+
+// Thread ids from here to the end of the table belong to kernel threads
+// (one bottom-half thread per CPU) and are refused to other owners
+#define THREAD_RESERVED_ID_BASE 252
+
+// Scheduler tracing; build with -DSIMPLEOS_SCHED_TRACE=0 to compile it out
+#ifndef SIMPLEOS_SCHED_TRACE
+#define SIMPLEOS_SCHED_TRACE 1
+#endif
+#define THREAD_TRACE_BUCKETS 16
+#define THREAD_TRACE_BUCKET_SHIFT 10 // Bucket 0 holds values below 2^10
+#define THREAD_TRACE_RING_SIZE 64
+
+// Thread States
+#define THREAD_STATE_NEW 0
+#define THREAD_STATE_READY 1
+#define THREAD_STATE_RUNNING 2
+#define THREAD_STATE_BLOCKED 3
+#define THREAD_STATE_DEAD 4
+
+// Thread Actions (for Transaction)
+#define THREAD_ACTION_CREATE 1
+#define THREAD_ACTION_EXIT 2
+#define THREAD_ACTION_YIELD 3
+#define THREAD_ACTION_BLOCK 4
+#define THREAD_ACTION_WAKE 5
+#define THREAD_ACTION_SLEEP 6
+
+// Thread Descriptor (Contextual Data)
+typedef struct {
+  uint32_t thread_id;      // Unique identifier
+  uint32_t owner_agent_id; // Owner agent
+  void *entry_point;       // Function address
+  void *stack_base;        // Stack base address
+  uint32_t stack_size;     // Stack size
+  uint32_t priority;       // Priority
+  uint32_t state;          // Current state
+} ThreadDescriptor;
+
+// Thread Transaction (Transactional Data)
+typedef struct {
+  uint32_t action;              // Operation requested
+  uint32_t requester_agent_id;  // Requesting agent
+  uint32_t requester_thread_id; // Requesting thread
+  uint32_t reason_code;         // Reason (e.g. IPC_WAIT)
+  uint32_t timeout_ms;          // Timeout for block/sleep
+  int32_t result_code;          // Result filled by kernel
+} ThreadTransaction;
+
+// Per-thread scheduling histograms. Bucket 0 counts values below
+// 2^THREAD_TRACE_BUCKET_SHIFT; bucket i counts values in
+// [2^(SHIFT+i-1), 2^(SHIFT+i)); the last bucket is open-ended.
+// Times are nanoseconds of hal_read_monotonic_time.
+typedef struct {
+  uint32_t thread_id;
+  uint32_t switch_count; // Times the thread was switched in
+  uint64_t max_wake_latency;
+  uint64_t max_run_length;
+  uint32_t wake_latency[THREAD_TRACE_BUCKETS]; // Ready -> running
+  uint32_t run_length[THREAD_TRACE_BUCKETS];   // Running -> switched out
+} ThreadTraceStats;
+
+// One context switch as recorded in the per-CPU switch ring
+typedef struct {
+  uint64_t timestamp;
+  uint32_t prev_thread_id; // 0xFFFFFFFF when the CPU was idle
+  uint32_t next_thread_id;
+  uint32_t prev_state;     // State the outgoing thread was left in
+  uint32_t wake_latency;   // Of the incoming thread, saturated
+} ThreadSwitchEvent;
+
+// Snapshot of the most recent switches on one CPU, oldest first
+typedef struct {
+  uint32_t cpu_id;
+  uint32_t event_count; // Valid entries in events
+  uint64_t total_switches;
+  ThreadSwitchEvent events[THREAD_TRACE_RING_SIZE];
+} ThreadSwitchLog;
+
+// Exposed Thread Methods
+int create_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
+int exit_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
+int yield_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
+int block_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
+int wake_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
+int sleep_thread(ThreadDescriptor *ctx, ThreadTransaction *txn);
+uint32_t thread_current_id(void);
+// Runs the scheduler on the calling CPU; the idle loop of secondary CPUs
+void thread_schedule(void);
+int thread_trace_query(ThreadDescriptor *ctx, ThreadTraceStats *stats);
+int thread_trace_read_switches(ThreadSwitchLog *log);
+// Copies out descriptors of live threads, with pool stacks cleared so a
+// restore allocates fresh ones. *count may exceed max_count.
+int thread_export_descriptors(ThreadDescriptor *out, uint32_t max_count,
+                              uint32_t *count);
+
+#endif // THREADS_H
@@ -0,0 +1,76 @@
+#include "timepage.h"
+#include <string.h>
+
+typedef union {
+  TimePage page;
+  uint8_t bytes[HAL_PAGE_SIZE];
+} TimePageStorage;
+
+static TimePageStorage storage __attribute__((aligned(HAL_PAGE_SIZE)));
+static uint64_t clock_counter_base; // HAL clock counter at time zero
+static int initialized = 0;
+
+// Seqlock writer: readers retry while sequence is odd or has moved
+static void publish(uint64_t counter, uint64_t ns, uint64_t mult,
+                    uint32_t shift) {
+  TimePage *page = &storage.page;
+  uint32_t seq = page->sequence + 1;
+  __atomic_store_n(&page->sequence, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  page->mult = mult;
+  page->shift = shift;
+  page->counter_base = counter;
+  page->ns_base = ns;
+  __atomic_store_n(&page->sequence, seq + 1, __ATOMIC_RELEASE);
+}
+
+int timepage_init(HardwareContext *hw_ctx) {
+  if (!hw_ctx)
+    return TIMEPAGE_ERR_INVALID_PARAM;
+
+  HalClockParams params;
+  hal_clock_get_params(&params);
+  if (params.frequency == 0)
+    return TIMEPAGE_ERR_UNSUPPORTED;
+
+  // Start from the HAL clock so both time sources agree
+  memset(&storage, 0, sizeof(storage));
+  storage.page.counter_frequency = params.frequency;
+  clock_counter_base = params.counter_base;
+  uint64_t counter = hal_clock_read_counter();
+  publish(counter, hal_clock_ticks_to_ns(counter - clock_counter_base),
+          params.mult, params.shift);
+
+  // Same physical page in every agent, read-only, never executable
+  HardwareTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  txn.operation_code = HAL_OP_MAP_PAGE;
+  txn.output_address = TIMEPAGE_USER_ADDRESS;
+  txn.input_address = (uint64_t)(uintptr_t)&storage;
+  txn.input_value = HAL_PAGE_FLAG_READ | HAL_PAGE_FLAG_USER;
+  hal_map_memory_page(hw_ctx, &txn);
+  if (txn.status_code != HAL_STATUS_OK)
+    return TIMEPAGE_ERR_UNSUPPORTED;
+
+  initialized = 1;
+  return TIMEPAGE_SUCCESS;
+}
+
+void timepage_update(void) {
+  if (!initialized)
+    return;
+  // Rebase so readers' deltas stay small and the product cannot overflow.
+  // The base comes from the HAL clock, so rounding never accumulates.
+  TimePage *page = &storage.page;
+  uint64_t counter = hal_clock_read_counter();
+  publish(counter, hal_clock_ticks_to_ns(counter - clock_counter_base),
+          page->mult, page->shift);
+}
+
+const TimePage *timepage_user_page(void) {
+#ifdef __aarch64__
+  return (const TimePage *)TIMEPAGE_USER_ADDRESS;
+#else
+  return &storage.page;
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef SIMPLEOS_TIMEPAGE_H
+#define SIMPLEOS_TIMEPAGE_H
+
+#include "hal.h"
+#include "hal_clock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define TIMEPAGE_SUCCESS 0
+#define TIMEPAGE_ERR_INVALID_PARAM -1
+#define TIMEPAGE_ERR_UNSUPPORTED -2
+
+// Fixed user address of the read-only time page in every agent
+#define TIMEPAGE_USER_ADDRESS 0x0000007FFFFF0000ULL
+
+// Published by the kernel, read by agents without a syscall. The fields
+// are only consistent while sequence is even and unchanged across the
+// read; see timepage_read_ns. The kernel rebases the page on every tick,
+// well within HAL_CLOCK_MAX_DELTA_S, so the 64-bit product cannot
+// overflow. Results match hal_read_monotonic_time.
+typedef struct {
+  uint32_t sequence; // Odd while the kernel is updating the page
+  uint32_t shift;
+  uint64_t mult;              // ns = ((counter - counter_base) * mult) >> shift
+  uint64_t counter_base;      // Counter value at ns_base
+  uint64_t ns_base;           // Monotonic nanoseconds at counter_base
+  uint64_t counter_frequency; // Counter ticks per second
+} TimePage;
+
+/**
+ * @brief Computes monotonic nanoseconds from a mapped time page.
+ *
+ * Runs entirely in the caller: retries while the kernel is mid-update.
+ */
+static inline uint64_t timepage_read_ns(const TimePage *page) {
+  uint32_t seq;
+  uint64_t ns;
+  do {
+    seq = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+    uint64_t delta = hal_clock_read_counter() - page->counter_base;
+    ns = page->ns_base + ((delta * page->mult) >> page->shift);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) ||
+           seq != __atomic_load_n(&page->sequence, __ATOMIC_RELAXED));
+  return ns;
+}
+
+int timepage_init(HardwareContext *hw_ctx);
+void timepage_update(void);
+// Address agents read the page at (the kernel copy on host builds)
+const TimePage *timepage_user_page(void);
+
+#endif // SIMPLEOS_TIMEPAGE_H
@@ -1,138 +1,408 @@
-#include "traps.h"
-#include "hal_internal.h"
-#include "syscalls.h"
-#include <stdio.h>
-#include <stdlib.h>
-
-static TrapFrame *allocate_trap_frame() {
-  return (TrapFrame *)malloc(sizeof(TrapFrame));
-}
-
-/**
- * @brief Releases memory associated with a trap frame.
- *
- * Safely frees the TrapFrame and sets the transaction's frame address to NULL.
- * Should be called when trap handling fails or completes.
- * @param txn Pointer to the TrapTransaction containing the frame address.
- */
-static void release_trap_frame(TrapTransaction *txn) {
-  if (!txn)
-    return;
-  TrapFrame *frame = (TrapFrame *)txn->trap_frame_address;
-  if (frame) {
-    free(frame);
-    txn->trap_frame_address = NULL;
-  }
-}
-
-static void save_registers(TrapFrame *frame) {}
-
-static void restore_registers(TrapFrame *frame) {}
-
-int capture_trap_state(TrapContext *ctx, TrapTransaction *txn) {
-  if (!txn)
-    return TRAP_ERR_INVALID_PARAM;
-
-  TrapFrame *frame = allocate_trap_frame();
-  if (!frame)
-    return TRAP_ERR_INVALID_PARAM;
-
-  save_registers(frame);
-  txn->trap_frame_address = frame;
-
-  return TRAP_SUCCESS;
-}
-
-int dispatch_trap(TrapContext *ctx, TrapTransaction *txn) {
-  if (!ctx || !txn)
-    return TRAP_ERR_INVALID_PARAM;
-
-  int res = TRAP_SUCCESS;
-
-  switch (ctx->trap_type) {
-  case TRAP_TYPE_SYSCALL:
-    res = handle_syscall_trap(ctx, txn);
-    break;
-  case TRAP_TYPE_INTERRUPT:
-    res = handle_interrupt_trap(ctx, txn);
-    break;
-  case TRAP_TYPE_FAULT:
-    res = handle_fault_trap(ctx, txn);
-    break;
-  default:
-    txn->dispatch_status = TRAP_DISPATCH_UNHANDLED;
-    txn->return_action = TRAP_RETURN_PANIC;
-    // Release frame on unhandled trap before panic
-    release_trap_frame(txn);
-    res = TRAP_ERR_INVALID_PARAM;
-  }
-
-  return res;
-}
-
-int handle_fault_trap(TrapContext *ctx, TrapTransaction *txn) {
-  txn->dispatch_status = TRAP_DISPATCH_THREAD_KILLED;
-  txn->return_action = TRAP_RETURN_SCHEDULE_NEXT;
-
-  return TRAP_SUCCESS;
-}
-
-int handle_interrupt_trap(TrapContext *ctx, TrapTransaction *txn) {
-  txn->dispatch_status = TRAP_DISPATCH_OK;
-  txn->return_action = TRAP_RETURN_TO_CALLER;
-
-  return TRAP_SUCCESS;
-}
-
-int handle_syscall_trap(TrapContext *ctx, TrapTransaction *txn) {
-  TrapFrame *frame = (TrapFrame *)txn->trap_frame_address;
-  if (!frame)
-    return TRAP_ERR_INVALID_PARAM;
-
-  SyscallContext sys_ctx;
-  sys_ctx.syscall_number = frame->x[0];
-  sys_ctx.caller_agent_id = ctx->current_agent_id;
-  sys_ctx.caller_thread_id = ctx->current_thread_id;
-  sys_ctx.privilege_level = ctx->privilege_level;
-  sys_ctx.abi_version = 1;
-
-  SyscallTransaction sys_txn;
-  sys_txn.argument_block_address = (void *)(uintptr_t)frame->x[1];
-  sys_txn.argument_block_size = frame->x[2];
-
-  int res = handle_syscall(&sys_ctx, &sys_txn);
-
-  frame->x[0] = sys_txn.status_code;
-
-  txn->dispatch_status = TRAP_DISPATCH_OK;
-  txn->return_action = TRAP_RETURN_TO_CALLER;
-
-  if (res != SYSCALL_SUCCESS) {
-  }
-
-  return TRAP_SUCCESS;
-}
-
-int restore_trap_state_and_return(TrapContext *ctx, TrapTransaction *txn) {
-  if (!txn)
-    return TRAP_ERR_INVALID_PARAM;
-
-  TrapFrame *frame = (TrapFrame *)txn->trap_frame_address;
-
-  if (txn->return_action == TRAP_RETURN_PANIC) {
-    // Release frame before entering panic loop to avoid leak
-    release_trap_frame(txn);
-    while (1)
-      ;
-  } else if (txn->return_action == TRAP_RETURN_SCHEDULE_NEXT) {
-    release_trap_frame(txn);
-    return TRAP_SUCCESS;
-  }
-
-  if (frame) {
-    restore_registers(frame);
-    release_trap_frame(txn);
-  }
-
-  return TRAP_SUCCESS;
-}
+#include "traps.h"
+#include "hal_internal.h"
+#include "ipc.h"
+#include "irq_policy.h"
+#include "percpu.h"
+#include "stack_pool.h"
+#include "syscalls.h"
+#include "timepage.h"
+#include "workqueue.h"
+#include <stdio.h>
+#include <string.h>
+
+// Trap frames come from a preallocated per-CPU stack, so trap entry and
+// exit never touch the heap. Nested traps (an IRQ taken while a syscall
+// is being handled) push a new frame; frames are released in LIFO order.
+typedef struct {
+  TrapFrame frames[TRAP_FRAME_STACK_DEPTH];
+  uint32_t depth;
+  uint64_t entry_time; // Entry of the outermost trap
+  TrapStats stats;
+} __attribute__((aligned(64))) TrapFrameStack;
+
+static TrapFrameStack frame_stacks[HAL_MAX_CPUS];
+static HardwareContext trap_hw_context;
+
+static uint64_t read_trap_clock() {
+  HardwareTransaction txn;
+  txn.operation_code = HAL_OP_READ_TIME;
+  txn.input_address = 0;
+  txn.input_value = 0;
+  txn.output_address = 0;
+  txn.output_value = 0;
+  txn.status_code = HAL_STATUS_OK;
+  hal_read_monotonic_time(&trap_hw_context, &txn);
+  return txn.output_value;
+}
+
+// IRQ lines bound by driver agents: the interrupt is forwarded as a
+// TRAP_MSG_TYPE_IRQ message on the agent's channel.
+typedef struct {
+  uint32_t channel_id;
+  uint32_t agent_id;
+  int is_bound;
+} IrqChannelBinding;
+
+// Built-in vectors serve until the integrator installs the routing table
+static TrapHandlerFn default_vector_table[TRAP_VECTOR_COUNT];
+static TrapHandlerFn *vector_table = NULL;
+static IrqChannelBinding irq_bindings[TRAP_MAX_IRQS];
+
+static int handle_unhandled_trap(TrapContext *ctx, TrapTransaction *txn);
+
+static void ensure_initialized() {
+  if (vector_table)
+    return;
+  for (uint32_t v = 0; v < TRAP_VECTOR_COUNT; v++)
+    default_vector_table[v] = handle_unhandled_trap;
+  default_vector_table[TRAP_TYPE_SYSCALL] = handle_syscall_trap;
+  default_vector_table[TRAP_TYPE_FAULT] = handle_fault_trap;
+  for (uint32_t v = TRAP_VECTOR_IRQ_BASE; v < TRAP_VECTOR_COUNT; v++)
+    default_vector_table[v] = handle_interrupt_trap;
+  memset(irq_bindings, 0, sizeof(irq_bindings));
+  vector_table = default_vector_table;
+}
+
+static TrapFrame *allocate_trap_frame(uint32_t cpu_id) {
+  TrapFrameStack *stack = &frame_stacks[cpu_id];
+  if (stack->depth >= TRAP_FRAME_STACK_DEPTH)
+    return NULL;
+  if (stack->depth == 0)
+    stack->entry_time = read_trap_clock();
+  stack->stats.trap_count++;
+  return &stack->frames[stack->depth++];
+}
+
+/**
+ * @brief Returns a trap frame to its per-CPU frame stack.
+ *
+ * The owning CPU is derived from the frame address. Only the innermost
+ * frame can be released; for any other frame the stack and the
+ * transaction are left untouched and TRAP_ERR_OUT_OF_ORDER is returned,
+ * so the caller still holds the frame and can release it in order.
+ * Should be called when trap handling fails or completes.
+ * @param txn Pointer to the TrapTransaction containing the frame address.
+ */
+static int release_trap_frame(TrapTransaction *txn) {
+  if (!txn)
+    return TRAP_ERR_INVALID_PARAM;
+  TrapFrame *frame = (TrapFrame *)txn->trap_frame_address;
+  if (!frame)
+    return TRAP_SUCCESS;
+
+  uintptr_t offset = (uintptr_t)frame - (uintptr_t)frame_stacks;
+  if ((uintptr_t)frame < (uintptr_t)frame_stacks ||
+      offset >= sizeof(frame_stacks))
+    return TRAP_ERR_INVALID_PARAM;
+
+  TrapFrameStack *stack = &frame_stacks[offset / sizeof(TrapFrameStack)];
+  if (stack->depth == 0 || frame != &stack->frames[stack->depth - 1])
+    return TRAP_ERR_OUT_OF_ORDER;
+
+  stack->depth--;
+  if (stack->depth == 0) {
+    uint64_t off = read_trap_clock() - stack->entry_time;
+    stack->stats.irq_off_last = off;
+    if (off > stack->stats.irq_off_max)
+      stack->stats.irq_off_max = off;
+  }
+  txn->trap_frame_address = NULL;
+  return TRAP_SUCCESS;
+}
+
+static void save_registers(TrapFrame *frame) {}
+
+static void restore_registers(TrapFrame *frame) {}
+
+int capture_trap_state(TrapContext *ctx, TrapTransaction *txn) {
+  if (!txn)
+    return TRAP_ERR_INVALID_PARAM;
+
+  // The trapping CPU is whichever one runs this; handlers read it back
+  uint32_t cpu_id = percpu_cpu_id();
+  if (ctx)
+    ctx->cpu_id = cpu_id;
+  percpu_this()->stats.traps++;
+
+  TrapFrame *frame = allocate_trap_frame(cpu_id);
+  if (!frame)
+    return TRAP_ERR_NESTING_TOO_DEEP;
+
+  save_registers(frame);
+  txn->trap_frame_address = frame;
+
+  return TRAP_SUCCESS;
+}
+
+int dispatch_trap(TrapContext *ctx, TrapTransaction *txn) {
+  if (!ctx || !txn)
+    return TRAP_ERR_INVALID_PARAM;
+
+  ensure_initialized();
+
+  uint32_t vector = ctx->trap_type == TRAP_TYPE_INTERRUPT
+                        ? TRAP_VECTOR_IRQ_BASE + ctx->trap_number
+                        : ctx->trap_type;
+  if (vector >= TRAP_VECTOR_COUNT)
+    return handle_unhandled_trap(ctx, txn);
+
+  int status = vector_table[vector](ctx, txn);
+
+  // An interrupt that left work for this CPU's scheduler (an event
+  // handler made pending) preempts the interrupted thread
+  if (status == TRAP_SUCCESS && ctx->trap_type == TRAP_TYPE_INTERRUPT &&
+      txn->return_action == TRAP_RETURN_TO_CALLER && percpu_resched_pending())
+    txn->return_action = TRAP_RETURN_SCHEDULE_NEXT;
+  return status;
+}
+
+static int handle_unhandled_trap(TrapContext *ctx, TrapTransaction *txn) {
+  txn->dispatch_status = TRAP_DISPATCH_UNHANDLED;
+  txn->return_action = TRAP_RETURN_PANIC;
+  // Release frame on unhandled trap before panic
+  release_trap_frame(txn);
+  return TRAP_ERR_INVALID_PARAM;
+}
+
+static void acknowledge_irq(uint32_t irq) {
+  HardwareTransaction hal_txn;
+  hal_txn.operation_code = HAL_OP_ACK_IRQ;
+  hal_txn.input_address = 0;
+  hal_txn.input_value = irq;
+  hal_txn.output_address = 0;
+  hal_txn.status_code = HAL_STATUS_OK;
+  hal_acknowledge_interrupt(&trap_hw_context, &hal_txn);
+}
+
+/**
+ * @brief Posts a TRAP_MSG_TYPE_IRQ message (corr_id = IRQ line) carrying
+ * the number of interrupts merged into it.
+ *
+ * Channels too small for the count get the message without payload. A
+ * full channel drops the notification.
+ */
+static void post_irq_message(uint32_t irq, uint32_t events) {
+  IrqChannelBinding *binding = &irq_bindings[irq];
+
+  ChannelDescriptor cd;
+  memset(&cd, 0, sizeof(cd));
+  cd.channel_id = binding->channel_id;
+
+  MessageEnvelope me;
+  memset(&me, 0, sizeof(me));
+  me.msg_type = TRAP_MSG_TYPE_IRQ;
+  me.dst_agent_id = binding->agent_id; // Kernel posts on the agent's behalf
+  me.corr_id = irq;
+  me.flags = IPC_MSG_FLAG_NON_BLOCKING;
+  me.payload = &events;
+  me.payload_len = sizeof(events);
+  if (ipc_send(&cd, &me) == IPC_ERR_PAYLOAD_TOO_LARGE) {
+    me.payload = NULL;
+    me.payload_len = 0;
+    ipc_send(&cd, &me);
+  }
+}
+
+// Interrupts the policy held back go where the line's own would have
+static void deliver_irq_events(uint32_t cpu_id, uint32_t irq,
+                               uint32_t events) {
+  if (irq < TRAP_MAX_IRQS && irq_bindings[irq].is_bound)
+    post_irq_message(irq, events);
+  else
+    workqueue_defer_irq(cpu_id, irq, events);
+}
+
+/**
+ * @brief Vector handler for IRQ lines bound to a driver agent's channel.
+ *
+ * Runs the line's delivery policy like any other interrupt, so bound
+ * lines are coalesced and storm-masked too, then acknowledges the line.
+ */
+static int forward_irq_to_channel(TrapContext *ctx, TrapTransaction *txn) {
+  uint32_t events = irq_policy_on_interrupt(&trap_hw_context,
+                                            ctx->trap_number,
+                                            read_trap_clock());
+  if (events)
+    post_irq_message(ctx->trap_number, events);
+
+  acknowledge_irq(ctx->trap_number);
+
+  txn->dispatch_status = TRAP_DISPATCH_OK;
+  txn->return_action = TRAP_RETURN_TO_CALLER;
+  return TRAP_SUCCESS;
+}
+
+void trap_install_vector_table(TrapHandlerFn *table,
+                               HardwareContext *hw_ctx) {
+  ensure_initialized();
+  if (hw_ctx)
+    trap_hw_context = *hw_ctx;
+  if (!table || table == vector_table)
+    return;
+  // Carry over the defaults and anything registered before installation
+  memcpy(table, vector_table, sizeof(TrapHandlerFn) * TRAP_VECTOR_COUNT);
+  vector_table = table;
+}
+
+int trap_register_handler(uint32_t vector, TrapHandlerFn handler) {
+  ensure_initialized();
+  if (vector >= TRAP_VECTOR_COUNT)
+    return TRAP_ERR_INVALID_PARAM;
+  vector_table[vector] = handler ? handler : handle_unhandled_trap;
+  return TRAP_SUCCESS;
+}
+
+int trap_register_irq_handler(uint32_t irq, TrapHandlerFn handler) {
+  if (irq >= TRAP_MAX_IRQS)
+    return TRAP_ERR_INVALID_PARAM;
+  return trap_register_handler(TRAP_VECTOR_IRQ_BASE + irq,
+                               handler ? handler : handle_interrupt_trap);
+}
+
+int trap_bind_irq_to_channel(uint32_t irq, uint32_t channel_id,
+                             uint32_t agent_id) {
+  ensure_initialized();
+  if (irq >= TRAP_MAX_IRQS)
+    return TRAP_ERR_INVALID_PARAM;
+  if (vector_table[TRAP_VECTOR_IRQ_BASE + irq] != handle_interrupt_trap)
+    return TRAP_ERR_PERMISSION_DENIED; // Line already claimed
+  // Interrupts are delivered in the binder's name: the channel must exist
+  // and belong to it
+  int res = ipc_channel_check_owner(channel_id, agent_id);
+  if (res == IPC_ERR_CHANNEL_NOT_FOUND)
+    return TRAP_ERR_INVALID_PARAM;
+  if (res != IPC_SUCCESS)
+    return TRAP_ERR_PERMISSION_DENIED;
+
+  irq_bindings[irq].channel_id = channel_id;
+  irq_bindings[irq].agent_id = agent_id;
+  irq_bindings[irq].is_bound = 1;
+  vector_table[TRAP_VECTOR_IRQ_BASE + irq] = forward_irq_to_channel;
+  return TRAP_SUCCESS;
+}
+
+int trap_unbind_irq(uint32_t irq, uint32_t agent_id) {
+  ensure_initialized();
+  if (irq >= TRAP_MAX_IRQS || !irq_bindings[irq].is_bound)
+    return TRAP_ERR_INVALID_PARAM;
+  if (irq_bindings[irq].agent_id != agent_id)
+    return TRAP_ERR_PERMISSION_DENIED;
+
+  irq_bindings[irq].is_bound = 0;
+  vector_table[TRAP_VECTOR_IRQ_BASE + irq] = handle_interrupt_trap;
+  return TRAP_SUCCESS;
+}
+
+int trap_irq_binding_owner(uint32_t irq, uint32_t *agent_id) {
+  if (irq >= TRAP_MAX_IRQS || !agent_id || !irq_bindings[irq].is_bound)
+    return TRAP_ERR_INVALID_PARAM;
+  *agent_id = irq_bindings[irq].agent_id;
+  return TRAP_SUCCESS;
+}
+
+int handle_fault_trap(TrapContext *ctx, TrapTransaction *txn) {
+  // First touch of a lazily committed stack page: map it and retry
+  if (stack_pool_handle_fault(ctx->fault_address) == STACK_FAULT_COMMITTED) {
+    txn->dispatch_status = TRAP_DISPATCH_OK;
+    txn->return_action = TRAP_RETURN_TO_CALLER;
+    return TRAP_SUCCESS;
+  }
+
+  // Guard page hits (stack overflow) and all other faults kill the thread
+  txn->dispatch_status = TRAP_DISPATCH_THREAD_KILLED;
+  txn->return_action = TRAP_RETURN_SCHEDULE_NEXT;
+
+  return TRAP_SUCCESS;
+}
+
+int handle_interrupt_trap(TrapContext *ctx, TrapTransaction *txn) {
+  // Top half: acknowledge first so the line cannot wedge the interrupt
+  // controller, then leave any real work to the bottom-half thread.
+  acknowledge_irq(ctx->trap_number);
+
+  // Coalescing may hold the interrupt back; the work item then carries
+  // every interrupt merged since the previous delivery.
+  uint64_t now = read_trap_clock();
+  uint32_t events = irq_policy_on_interrupt(&trap_hw_context,
+                                            ctx->trap_number, now);
+  if (events)
+    workqueue_defer_irq(ctx->cpu_id, ctx->trap_number, events);
+  if (ctx->trap_number == HAL_TIMER_IRQ) {
+    irq_policy_tick(&trap_hw_context, ctx->cpu_id, now, deliver_irq_events);
+    timepage_update();
+  }
+
+  txn->dispatch_status = TRAP_DISPATCH_OK;
+  txn->return_action = TRAP_RETURN_TO_CALLER;
+
+  return TRAP_SUCCESS;
+}
+
+int handle_syscall_trap(TrapContext *ctx, TrapTransaction *txn) {
+  TrapFrame *frame = (TrapFrame *)txn->trap_frame_address;
+  if (!frame)
+    return TRAP_ERR_INVALID_PARAM;
+
+  SyscallContext sys_ctx;
+  sys_ctx.syscall_number = (uint32_t)frame->x[0];
+  sys_ctx.caller_agent_id = ctx->current_agent_id;
+  sys_ctx.caller_thread_id = ctx->current_thread_id;
+  sys_ctx.privilege_level = ctx->privilege_level;
+  sys_ctx.abi_version = (uint32_t)(frame->x[0] >> 32);
+
+  txn->dispatch_status = TRAP_DISPATCH_OK;
+  txn->return_action = TRAP_RETURN_TO_CALLER;
+
+  if (sys_ctx.abi_version == SYSCALL_ABI_REGISTER) {
+    // Arguments stay in the saved registers; nothing is read from memory
+    uint64_t value;
+    int res = handle_fast_syscall(&sys_ctx, &frame->x[1], &value);
+    frame->x[0] = (uint64_t)(int64_t)res;
+    frame->x[1] = value;
+    return TRAP_SUCCESS;
+  }
+  if (sys_ctx.abi_version > SYSCALL_ABI_BLOCK) {
+    frame->x[0] = (uint64_t)(int64_t)SYSCALL_ERR_INVALID_CONTEXT;
+    return TRAP_SUCCESS;
+  }
+
+  sys_ctx.abi_version = SYSCALL_ABI_BLOCK;
+  SyscallTransaction sys_txn;
+  sys_txn.argument_block_address = (void *)(uintptr_t)frame->x[1];
+  sys_txn.argument_block_size = frame->x[2];
+
+  handle_syscall(&sys_ctx, &sys_txn);
+
+  frame->x[0] = sys_txn.status_code;
+  return TRAP_SUCCESS;
+}
+
+int restore_trap_state_and_return(TrapContext *ctx, TrapTransaction *txn) {
+  if (!txn)
+    return TRAP_ERR_INVALID_PARAM;
+
+  TrapFrame *frame = (TrapFrame *)txn->trap_frame_address;
+
+  if (txn->return_action == TRAP_RETURN_PANIC) {
+    // Release frame before entering panic loop to avoid leak
+    release_trap_frame(txn);
+    while (1)
+      ;
+  } else if (txn->return_action == TRAP_RETURN_SCHEDULE_NEXT) {
+    return release_trap_frame(txn);
+  }
+
+  if (frame) {
+    restore_registers(frame);
+    return release_trap_frame(txn);
+  }
+
+  return TRAP_SUCCESS;
+}
+
+int trap_query_stats(uint32_t cpu_id, TrapStats *stats) {
+  if (cpu_id >= HAL_MAX_CPUS || !stats)
+    return TRAP_ERR_INVALID_PARAM;
+  *stats = frame_stacks[cpu_id].stats;
+  return TRAP_SUCCESS;
+}
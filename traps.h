@@ -1,38 +1,71 @@
-#ifndef TRAPS_H
-#define TRAPS_H
-#include <stddef.h>
-#include <stdint.h>
-#define TRAP_SUCCESS 0
-#define TRAP_ERR_INVALID_PARAM -1
-#define TRAP_ERR_NOT_SUPPORTED -2
-#define TRAP_TYPE_SYSCALL 1
-#define TRAP_TYPE_INTERRUPT 2
-#define TRAP_TYPE_FAULT 3
-#define TRAP_DISPATCH_OK 0
-#define TRAP_DISPATCH_UNHANDLED 1
-#define TRAP_DISPATCH_THREAD_KILLED 2
-#define TRAP_RETURN_TO_CALLER 0
-#define TRAP_RETURN_SCHEDULE_NEXT 1
-#define TRAP_RETURN_PANIC 2
-typedef struct {
-  uint32_t trap_type;
-  uint32_t trap_number;
-  uint32_t cpu_id;
-  uint32_t privilege_level;
-  uint32_t current_thread_id;
-  uint32_t current_agent_id;
-} TrapContext;
-typedef struct {
-  void *trap_frame_address;
-  uint32_t error_code;
-  int32_t dispatch_status;
-  uint32_t return_action;
-} TrapTransaction;
-int capture_trap_state(TrapContext *ctx, TrapTransaction *txn);
-int dispatch_trap(TrapContext *ctx, TrapTransaction *txn);
-int handle_fault_trap(TrapContext *ctx, TrapTransaction *txn);
-int handle_interrupt_trap(TrapContext *ctx, TrapTransaction *txn);
-int handle_syscall_trap(TrapContext *ctx, TrapTransaction *txn);
-int restore_trap_state_and_return(TrapContext *ctx, TrapTransaction *txn);
-
-#endif
+#ifndef TRAPS_H
+#define TRAPS_H
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+#define TRAP_SUCCESS 0
+#define TRAP_ERR_INVALID_PARAM -1
+#define TRAP_ERR_NOT_SUPPORTED -2
+#define TRAP_ERR_NESTING_TOO_DEEP -3
+#define TRAP_ERR_PERMISSION_DENIED -4
+#define TRAP_ERR_OUT_OF_ORDER -5 // Frame released before a nested one
+#define TRAP_FRAME_STACK_DEPTH 8 // Max nested traps per CPU
+// Vector layout: 0..31 are indexed by trap_type, 32..255 by IRQ line
+#define TRAP_VECTOR_COUNT 256
+#define TRAP_VECTOR_IRQ_BASE 32
+#define TRAP_MAX_IRQS (TRAP_VECTOR_COUNT - TRAP_VECTOR_IRQ_BASE)
+#define TRAP_MSG_TYPE_IRQ 0x100 // msg_type of IRQ notifications
+// Payload of an IRQ notification: the interrupts it stands for (uint32_t)
+#define TRAP_TYPE_SYSCALL 1
+#define TRAP_TYPE_INTERRUPT 2
+#define TRAP_TYPE_FAULT 3
+#define TRAP_DISPATCH_OK 0
+#define TRAP_DISPATCH_UNHANDLED 1
+#define TRAP_DISPATCH_THREAD_KILLED 2
+#define TRAP_RETURN_TO_CALLER 0
+#define TRAP_RETURN_SCHEDULE_NEXT 1
+#define TRAP_RETURN_PANIC 2
+typedef struct {
+  uint32_t trap_type;
+  uint32_t trap_number;
+  uint32_t cpu_id;
+  uint32_t privilege_level;
+  uint32_t current_thread_id;
+  uint32_t current_agent_id;
+  uint64_t fault_address; // Faulting address (FAR) for TRAP_TYPE_FAULT
+} TrapContext;
+typedef struct {
+  void *trap_frame_address;
+  uint32_t error_code;
+  int32_t dispatch_status;
+  uint32_t return_action;
+} TrapTransaction;
+
+// Per-CPU trap statistics. Traps run with interrupts masked, so the time
+// from outermost trap entry to its return is interrupt-disabled time.
+typedef struct {
+  uint64_t trap_count;
+  uint64_t irq_off_last; // Last outermost trap duration
+  uint64_t irq_off_max;  // Longest outermost trap duration
+} TrapStats;
+
+typedef int (*TrapHandlerFn)(TrapContext *ctx, TrapTransaction *txn);
+int capture_trap_state(TrapContext *ctx, TrapTransaction *txn);
+int dispatch_trap(TrapContext *ctx, TrapTransaction *txn);
+int handle_fault_trap(TrapContext *ctx, TrapTransaction *txn);
+int handle_interrupt_trap(TrapContext *ctx, TrapTransaction *txn);
+int handle_syscall_trap(TrapContext *ctx, TrapTransaction *txn);
+int restore_trap_state_and_return(TrapContext *ctx, TrapTransaction *txn);
+
+void trap_install_vector_table(TrapHandlerFn *table,
+                               HardwareContext *hw_ctx);
+int trap_register_handler(uint32_t vector, TrapHandlerFn handler);
+int trap_register_irq_handler(uint32_t irq, TrapHandlerFn handler);
+int trap_bind_irq_to_channel(uint32_t irq, uint32_t channel_id,
+                             uint32_t agent_id);
+int trap_unbind_irq(uint32_t irq, uint32_t agent_id);
+// Returns TRAP_SUCCESS and the binding agent when the line is bound
+int trap_irq_binding_owner(uint32_t irq, uint32_t *agent_id);
+int trap_query_stats(uint32_t cpu_id, TrapStats *stats);
+
+#endif
@@ -0,0 +1,158 @@
+#include "workqueue.h"
+#include "hal.h"
+#include "hal_internal.h"
+#include "threads.h"
+#include <string.h>
+
+typedef struct {
+  uint32_t irq;
+  uint32_t event_count;
+} WorkItem;
+
+// Single-producer/single-consumer ring. The producer is the top half on
+// the owning CPU, the consumer is that CPU's bottom-half thread, so no
+// lock is needed: each index has exactly one writer.
+typedef struct {
+  WorkItem items[WORKQUEUE_DEPTH];
+  uint32_t head; // Next item to run; written by the bottom-half thread
+  uint32_t tail; // Next free slot; written by the top half
+  WorkqueueStats stats;
+} __attribute__((aligned(64))) WorkQueue;
+
+typedef struct {
+  IrqBottomHalfFn fn;
+  void *arg;
+} BottomHalf;
+
+static WorkQueue queues[HAL_MAX_CPUS];
+static BottomHalf bottom_halves[WORKQUEUE_MAX_IRQS];
+
+int workqueue_register_bottom_half(uint32_t irq, IrqBottomHalfFn fn,
+                                   void *arg) {
+  if (irq >= WORKQUEUE_MAX_IRQS || !fn)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+  bottom_halves[irq].arg = arg;
+  __atomic_store_n(&bottom_halves[irq].fn, fn, __ATOMIC_RELEASE);
+  return WORKQUEUE_SUCCESS;
+}
+
+int workqueue_unregister_bottom_half(uint32_t irq) {
+  if (irq >= WORKQUEUE_MAX_IRQS)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+  __atomic_store_n(&bottom_halves[irq].fn, NULL, __ATOMIC_RELEASE);
+  return WORKQUEUE_SUCCESS;
+}
+
+static void wake_bottom_half_thread(WorkQueue *q) {
+  if (!q->stats.thread_id)
+    return;
+  ThreadDescriptor td;
+  memset(&td, 0, sizeof(td));
+  td.thread_id = q->stats.thread_id;
+  // Fails harmlessly when the thread is already runnable
+  wake_thread(&td, NULL);
+}
+
+int workqueue_defer_irq(uint32_t cpu_id, uint32_t irq, uint32_t event_count) {
+  if (cpu_id >= HAL_MAX_CPUS || irq >= WORKQUEUE_MAX_IRQS)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+  if (!__atomic_load_n(&bottom_halves[irq].fn, __ATOMIC_ACQUIRE))
+    return WORKQUEUE_ERR_NOT_FOUND;
+
+  WorkQueue *q = &queues[cpu_id];
+  uint32_t tail = q->tail;
+  uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+  if (tail - head >= WORKQUEUE_DEPTH) {
+    q->stats.dropped += event_count;
+    return WORKQUEUE_ERR_QUEUE_FULL;
+  }
+
+  WorkItem *item = &q->items[tail % WORKQUEUE_DEPTH];
+  item->irq = irq;
+  item->event_count = event_count;
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+  q->stats.queued++;
+  if (tail + 1 - head > q->stats.max_depth)
+    q->stats.max_depth = tail + 1 - head;
+
+  wake_bottom_half_thread(q);
+  return WORKQUEUE_SUCCESS;
+}
+
+int workqueue_run_bottom_halves(uint32_t cpu_id) {
+  if (cpu_id >= HAL_MAX_CPUS)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+
+  WorkQueue *q = &queues[cpu_id];
+  int ran = 0;
+  uint32_t head = q->head;
+  while (head != __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) {
+    WorkItem item = q->items[head % WORKQUEUE_DEPTH];
+    __atomic_store_n(&q->head, ++head, __ATOMIC_RELEASE);
+
+    IrqBottomHalfFn fn =
+        __atomic_load_n(&bottom_halves[item.irq].fn, __ATOMIC_ACQUIRE);
+    if (fn)
+      fn(item.irq, item.event_count, bottom_halves[item.irq].arg);
+    q->stats.completed++;
+    ran++;
+  }
+  return ran;
+}
+
+/**
+ * @brief Body of the per-CPU bottom-half thread.
+ *
+ * Thread WORKQUEUE_THREAD_ID_BASE + n serves CPU n: it drains the queue,
+ * then blocks until a top half wakes it again.
+ */
+static void workqueue_thread_main(void) {
+  uint32_t thread_id = thread_current_id();
+  uint32_t cpu_id = thread_id - WORKQUEUE_THREAD_ID_BASE;
+  WorkQueue *q = &queues[cpu_id];
+
+  ThreadDescriptor self;
+  memset(&self, 0, sizeof(self));
+  self.thread_id = thread_id;
+  ThreadTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+
+  for (;;) {
+    workqueue_run_bottom_halves(cpu_id);
+    // Top halves run on this CPU, so with interrupts masked no work can be
+    // queued between the emptiness check and the block
+    hal_internal_set_irq_enabled(false);
+    if (__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == q->head)
+      block_thread(&self, &txn);
+    hal_internal_set_irq_enabled(true);
+  }
+}
+
+int workqueue_start(uint32_t cpu_id, uint32_t priority) {
+  if (cpu_id >= HAL_MAX_CPUS)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+
+  ThreadDescriptor td;
+  memset(&td, 0, sizeof(td));
+  td.thread_id = WORKQUEUE_THREAD_ID_BASE + cpu_id;
+  td.owner_agent_id = 0; // Kernel
+  td.entry_point = (void *)workqueue_thread_main;
+  td.priority = priority;
+
+  ThreadTransaction txn;
+  memset(&txn, 0, sizeof(txn));
+  txn.action = THREAD_ACTION_CREATE;
+  if (create_thread(&td, &txn) != THREAD_SUCCESS)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+
+  queues[cpu_id].stats.thread_id = td.thread_id;
+  return WORKQUEUE_SUCCESS;
+}
+
+int workqueue_query_stats(uint32_t cpu_id, WorkqueueStats *stats) {
+  if (cpu_id >= HAL_MAX_CPUS || !stats)
+    return WORKQUEUE_ERR_INVALID_PARAM;
+  *stats = queues[cpu_id].stats;
+  return WORKQUEUE_SUCCESS;
+}
@@ -0,0 +1,42 @@
+#ifndef SIMPLEOS_WORKQUEUE_H
+#define SIMPLEOS_WORKQUEUE_H
+
+#include "threads.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Status Codes
+#define WORKQUEUE_SUCCESS 0
+#define WORKQUEUE_ERR_INVALID_PARAM -1
+#define WORKQUEUE_ERR_QUEUE_FULL -4
+#define WORKQUEUE_ERR_NOT_FOUND -5
+
+#define WORKQUEUE_DEPTH 64 // Work items per CPU, power of two
+#define WORKQUEUE_MAX_IRQS 224
+#define WORKQUEUE_DEFAULT_PRIORITY 200
+// Bottom-half thread of CPU n: base + n
+#define WORKQUEUE_THREAD_ID_BASE THREAD_RESERVED_ID_BASE
+
+// Bottom half of an IRQ. Runs in the per-CPU bottom-half thread with
+// interrupts enabled. event_count is the number of interrupts folded into
+// this work item.
+typedef void (*IrqBottomHalfFn)(uint32_t irq, uint32_t event_count,
+                                void *arg);
+
+typedef struct {
+  uint64_t queued;    // Work items queued by top halves
+  uint64_t completed; // Work items run by the bottom-half thread
+  uint64_t dropped;   // Interrupts lost to a full queue
+  uint32_t max_depth; // Deepest the queue has been
+  uint32_t thread_id; // Bottom-half thread of this CPU
+} WorkqueueStats;
+
+int workqueue_register_bottom_half(uint32_t irq, IrqBottomHalfFn fn,
+                                   void *arg);
+int workqueue_unregister_bottom_half(uint32_t irq);
+int workqueue_defer_irq(uint32_t cpu_id, uint32_t irq, uint32_t event_count);
+int workqueue_run_bottom_halves(uint32_t cpu_id);
+int workqueue_start(uint32_t cpu_id, uint32_t priority);
+int workqueue_query_stats(uint32_t cpu_id, WorkqueueStats *stats);
+
+#endif // SIMPLEOS_WORKQUEUE_H